@@ -40,6 +40,9 @@ void BuilderGame::ResetModified() {
 
 void BuilderGame::AddModified(std::string mod) {
   _modified.push_back(mod);
+  // Every edit ends here: new users must no longer be cloned from old state
+  std::unique_lock ul(_mutex);
+  ResetUserPrototype();
 }
 
 void BuilderGame::UpdateBackupInfos() {
@@ -148,10 +151,11 @@ void BuilderGame::CreateListenerInPlace(const std::string& listener_id, const nl
     throw std::invalid_argument("Game::CreateListenerInPlace: context " + ctx_id + " not found!");
   }
   // Create listener from json
-  auto new_listener = parser::CreateListenerFromJson(json_listener, ctx_id, _contexts);
+  auto new_listener = parser::CreateListenerFromJson(json_listener, ctx_id, _contexts, 
+      BindHandler(&BuilderGame::h_add_to_eventqueue));
   // If contains exec (direct execution), set exec function
   if (json_listener.contains("exec")) {
-    new_listener->set_fn(std::bind(&BuilderGame::h_exec, this, std::placeholders::_1, std::placeholders::_2));
+    new_listener->set_fn(BindHandler(&BuilderGame::h_exec));
   }
   _contexts.at(ctx_id)->AddListener(new_listener);
   if (listener_id != new_listener->id()) {
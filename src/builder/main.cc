@@ -12,6 +12,7 @@ using namespace std::chrono_literals;
 int main() {
   util::SetUpLogger(builder::LoggerPath(), builder::LOGGER, spdlog::level::debug);
   util::LoggerContext scope(builder::LOGGER);
+  spdlog::set_default_logger(spdlog::get(builder::LOGGER)); // used by threads without logger-context
 
   nlohmann::json builder_config;
   if (auto json = util::LoadJsonFromDisc(builder::CONFIG)) {
@@ -811,11 +811,11 @@ void Builder::DeleteGame(const httplib::Request& req, httplib::Response& resp) {
 void Builder::SaveSettings(const httplib::Request& req, httplib::Response& resp) {
   std::string game_id = req.path_params.at("game_id");
   try {
-    nlohmann::json settings_json = {
-      {"initial_events", req.form.get_field("initial_events")},
-      {"initial_contexts", req.form.get_fields("initial_contexts")}
-    };
     std::unique_lock ul(_mtx_games);
+    // (keeps settings not edited here, f.e. the event budget)
+    nlohmann::json settings_json = _games.at(game_id)->settings().ToJson();
+    settings_json["initial_events"] = req.form.get_field("initial_events");
+    settings_json["initial_contexts"] = req.form.get_fields("initial_contexts");
     _games.at(game_id)->set_settings(txtad::Settings(settings_json));
     _games.at(game_id)->AddModified("Updated settings");
     if (const auto game_desc = _http::GetField(req, "game_desc")) {
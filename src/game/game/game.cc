@@ -16,82 +16,86 @@
 #include <stdexcept>
 #include <string>
 
-Game::MsgFn Game::_global_cout= nullptr;
+thread_local Game::MsgFn Game::_global_cout= nullptr;
 
-Game::Game(std::string path, std::string name) : _cout(_global_cout), _path(path), _name(name), 
+Game::Game(std::string path, std::string name, MsgFn cout) : _cout((cout) ? cout : _global_cout), _path(path), 
+    _name(name), 
     _cur_user(nullptr), _running(false), 
-    _parser(std::bind(&Game::t_substitue_fn, this, std::placeholders::_1)),
+    _parser([this](const std::string& substitute) -> std::string {
+      if (auto user = cur_user())
+        return t_substitue_fn(*user, substitute);
+      util::Logger()->error("Game::_parser: {}. No current user", substitute);
+      return txtad::NO_REPLACEMENT;
+    }),
     _settings(*util::LoadJsonFromDisc(_path + "/" + txtad::GAME_SETTINGS)),
     _builder_settings(util::LoadJsonFromDisc(_path + "/" 
           + txtad::BUILDER_EXTENSION).value_or(nlohmann::json::object())) {
-  util::SetUpLogger(txtad::LoggerPath(), _name, util::Logger()->level());
+  auto prev_logger = spdlog::get(_name);  // logger of running game with same name (reload)
+  _logger = util::SetUpLogger(txtad::LoggerPath(), _name, util::Logger()->level());
   util::LoggerContext scope(_name);
   util::Logger()->info(fmt::format("Game::Game. Creating game: {}", name));
   
-  // Create basc handlers
-  LForwarder::set_overwite_fn(std::bind(&Game::h_add_to_eventqueue, this, std::placeholders::_1, 
-        std::placeholders::_2));
-
   // Setup mechanics-context
   _mechanics_ctx = std::make_shared<Context>("ctx_mechanic", 0, false);
 
+  // Built-in commands (dispatched by keyword, authors' listeners on higher priority contexts
+  // still intercept them)
+  auto commands = std::make_shared<LCommandDispatcher>("H_COMMANDS");
+
   // Context commands 
-  _mechanics_ctx->AddListener(std::make_shared<LHandler>("H_CTX01", "#ctx remove (.*)", 
-        std::bind(&Game::h_remove_ctx, this, std::placeholders::_1, std::placeholders::_2)));
-  _mechanics_ctx->AddListener(std::make_shared<LHandler>("H_CTX02", "#ctx add (.*)", 
-        std::bind(&Game::h_add_ctx, this, std::placeholders::_1, std::placeholders::_2)));
-  _mechanics_ctx->AddListener(std::make_shared<LHandler>("H_CTX03", "#ctx replace (.*)", 
-        std::bind(&Game::h_replace_ctx, this, std::placeholders::_1, std::placeholders::_2)));
-  _mechanics_ctx->AddListener(std::make_shared<LHandler>("H_CTX04", "#ctx name (.*)", 
-        std::bind(&Game::h_set_ctx_name, this, std::placeholders::_1, std::placeholders::_2)));
+  commands->AddCommand("#ctx remove", BindHandler(&Game::h_remove_ctx));
+  commands->AddCommand("#ctx add", BindHandler(&Game::h_add_ctx));
+  commands->AddCommand("#ctx replace", BindHandler(&Game::h_replace_ctx));
+  commands->AddCommand("#ctx name", BindHandler(&Game::h_set_ctx_name));
   
   // Attribute commands
-  _mechanics_ctx->AddListener(std::make_shared<LHandler>("H_ATTS01", "#sa (.*)", 
-        std::bind(&Game::h_set_attribute, this, std::placeholders::_1, std::placeholders::_2)));
+  commands->AddCommand("#sa", BindHandler(&Game::h_set_attribute));
 
   // List commands
-  _mechanics_ctx->AddListener(std::make_shared<LHandler>("H_LST01", "#lst atts (.*)", 
-        std::bind(&Game::h_list_attributes, this, std::placeholders::_1, std::placeholders::_2)));
-  _mechanics_ctx->AddListener(std::make_shared<LHandler>("H_LST02", "#lst* atts (.*)", 
-        std::bind(&Game::h_list_all_attributes, this, std::placeholders::_1, std::placeholders::_2)));
-  _mechanics_ctx->AddListener(std::make_shared<LHandler>("H_LST03", "#lst ctxs (.*)", 
-        std::bind(&Game::h_list_linked_contexts, this, std::placeholders::_1, std::placeholders::_2)));
-  _mechanics_ctx->AddListener(std::make_shared<LHandler>("H_LST04", "#lst* ctxs (.*)", 
-        std::bind(&Game::h_list_contexts, this, std::placeholders::_1, std::placeholders::_2)));
+  commands->AddCommand("#lst atts", BindHandler(&Game::h_list_attributes));
+  commands->AddCommand("#lst* atts", BindHandler(&Game::h_list_all_attributes));
+  commands->AddCommand("#lst ctxs", BindHandler(&Game::h_list_linked_contexts));
+  commands->AddCommand("#lst* ctxs", BindHandler(&Game::h_list_contexts));
 
   // Print commands
-  _mechanics_ctx->AddListener(std::make_shared<LHandler>("H_PRINT01", "#> (.*)", 
-        std::bind(&Game::h_print, this, std::placeholders::_1, std::placeholders::_2)));
-  _mechanics_ctx->AddListener(std::make_shared<LHandler>("H_PRINT011", "#>> (.*)", 
-        std::bind(&Game::h_print_with_prompt, this, std::placeholders::_1, std::placeholders::_2)));
-   _mechanics_ctx->AddListener(std::make_shared<LHandler>("H_PRINT02", "#-> (.*)", 
-         std::bind(&Game::h_print_to, this, std::placeholders::_1, std::placeholders::_2)));
+  commands->AddCommand("#>", BindHandler(&Game::h_print));
+  commands->AddCommand("#>>", BindHandler(&Game::h_print_with_prompt));
+  commands->AddCommand("#->", BindHandler(&Game::h_print_to));
 
   // Reset commands
-  _mechanics_ctx->AddListener(std::make_shared<LHandler>("H_RESET01", "#reset game", 
-        std::bind(&Game::h_reset_game, this, std::placeholders::_1, std::placeholders::_2)));
-  _mechanics_ctx->AddListener(std::make_shared<LHandler>("H_RESET02", "#reset user", 
-        std::bind(&Game::h_reset_user, this, std::placeholders::_1, std::placeholders::_2)));
+  commands->AddCommand("#reset game", BindHandler(&Game::h_reset_game), false);
+  commands->AddCommand("#reset user", BindHandler(&Game::h_reset_user), false);
+  commands->AddCommand("#reload game", BindHandler(&Game::h_reload_game), false);
 
   // Others
-  _mechanics_ctx->AddListener(std::make_shared<LHandler>("H01", "#remove_user (.*)", 
-        std::bind(&Game::h_remove_user, this, std::placeholders::_1, std::placeholders::_2)));
+  commands->AddCommand("#remove_user", BindHandler(&Game::h_remove_user));
+
+  _mechanics_ctx->AddListener(commands);
 
   try {
-    for (auto it : parser::LoadGameFiles(_path, _contexts, _texts)) {
-      it->set_fn(std::bind(&Game::h_exec, this, std::placeholders::_1, std::placeholders::_2));
+    for (auto it : parser::LoadGameFiles(_path, _contexts, _texts, 
+          BindHandler(&Game::h_add_to_eventqueue))) {
+      it->set_fn(BindHandler(&Game::h_exec));
     }
   } catch (std::exception& e) {
     util::Logger()->error(fmt::format("Game::Game. Game {} failed to initialize: \"{}\".", _name, e.what()));
     spdlog::drop(_name);
+    if (prev_logger)
+      spdlog::register_logger(prev_logger);
     throw std::runtime_error("Game::Game: " + std::string(e.what()));
   }
+  _executor = std::make_unique<GameExecutor>(_name, [this](const std::string& user_id, const std::string& event) {
+    HandleEvent(user_id, event);
+  }, txtad::GameThreads());
   util::Logger()->info(fmt::format("Game::Game. Created game with desc: {}", _builder_settings._description));
 }
 
 Game::~Game() {
+  _executor.reset();
   util::Logger()->info(fmt::format("Game::~::game. Game {} deleted, logger dropped.", _name));
-  spdlog::drop(_name);
+  // Only drop own logger (a reloaded game with the same name might have replaced it)
+  if (_logger && spdlog::get(_name) == _logger)
+    spdlog::drop(_name);
 }
 
 // getter 
@@ -101,9 +105,20 @@ const std::map<std::string, std::shared_ptr<Context>>& Game::contexts() const {
 const std::map<std::string, std::shared_ptr<Text>>& Game::texts() const { return _texts; }
 const txtad::Settings& Game::settings() const { return _settings; }
 const builder::Settings& Game::builder_settings() const { return _builder_settings; }
-const std::shared_ptr<User>& Game::cur_user() { return _cur_user; }
+std::shared_ptr<User> Game::cur_user() const { 
+  std::lock_guard lock(_cur_user_mutex);
+  return _cur_user; 
+}
 bool Game::running() const { return _running; }
 const ExpressionParser& Game::parser() const { return _parser; }
+GameExecutor::Stats Game::executor_stats() const { 
+  return (_executor) ? _executor->stats() : GameExecutor::Stats{0, 0, 0, 0, 0}; 
+}
+size_t Game::aborted_chains() const { return _aborted_chains; }
+Game::UserStats Game::user_stats() const {
+  std::lock_guard lock(_user_pool_mutex);
+  return {_users_cloned.load(), _users_initialized.load(), _user_pool.size()};
+}
 
 // setter
 void Game::set_global_msg_fn(Game::MsgFn fn) { _global_cout = fn; }
@@ -112,45 +127,72 @@ void Game::set_msg_fn(MsgFn fn) {
   _cout = fn; 
 }
 void Game::set_running(bool status) { _running = status; }
+void Game::set_cur_user(std::shared_ptr<User> user) {
+  std::lock_guard lock(_cur_user_mutex);
+  _cur_user = user;
+}
 
 // methods 
 void Game::HandleEvent(const std::string& user_id, const std::string& event) {
   util::LoggerContext scope(_name);
 
   util::Logger()->info("Game::HandleEvent: Handling inp: {}", event);
-  std::unique_lock ul(_mutex);
 
-  // Inform all users about new connection
-  if (event == txtad::NEW_CONNECTION) {
-    for (const auto& it : _users) {
-      it.second->HandleEvent(event + " " + user_id, _parser);
+  // Existing user: only lock the user itself, so that other users are handled in parallel.
+  bool handled = false;
+  if (event != txtad::NEW_CONNECTION) {
+    std::shared_lock sl(_mutex);
+    if (auto user = util::get_ptr(_users, user_id)) {
+      std::lock_guard user_lock(user->mutex());
+      set_cur_user(user);
+      HandleUserEvent(*user, event, true);
+      handled = true;
     }
   }
 
-  // If user did not exist yet, create new user
-  if (_users.count(user_id) == 0) {
-    util::Logger()->debug("Game::HandleEvent: Creating new user: {}", user_id);
-    // Create new user
-    _cur_user = CreateNewUser(user_id);
-    _cur_user->HandleEvent(_settings.initial_events(), _parser);
-  } 
-  // Otherwise, handle incomming event
-  else {
-    if (auto cur_user = _users.at(user_id)) {
-      _cur_user = cur_user;
-      _cur_user->HandleEvent(event, _parser, true);
-    } else {
-      util::Logger()->error("Game::HandleEvent. Invalid Game state. Existing user no longer valid! id: {}", 
-        user_id);
+  // New connection or new user: handled exclusively
+  if (!handled) {
+    std::unique_lock ul(_mutex);
+    // Inform all users about new connection
+    if (event == txtad::NEW_CONNECTION) {
+      for (const auto& it : _users) {
+        HandleUserEvent(*it.second, event + " " + user_id);
+      }
+    }
+
+    // If user did not exist yet, create new user
+    if (_users.count(user_id) == 0) {
+      util::Logger()->debug("Game::HandleEvent: Creating new user: {}", user_id);
+      CreateInitializedUser(user_id);
+    } 
+    // Otherwise, handle incomming event
+    else {
+      if (auto cur_user = _users.at(user_id)) {
+        set_cur_user(cur_user);
+        HandleUserEvent(*cur_user, event, true);
+      } else {
+        util::Logger()->error("Game::HandleEvent. Invalid Game state. Existing user no longer valid! id: {}", 
+          user_id);
+      }
     }
   }
+  RunDeferred();
   util::Logger()->info("Game::HandleEvent: Handling inp: {}. Done", event);
 }
 
+void Game::Post(const std::string& user_id, const std::string& event, GameExecutor::DoneFn done) {
+  if (_executor) 
+    _executor->Post(user_id, event, done);
+  else
+    util::Logger()->error("Game::Post: game {} has no executor. Dropped event {}", _name, event);
+}
+
 std::shared_ptr<User> Game::CreateNewUser(std::string user_id) {
-  auto new_user = std::make_shared<User>(_name, user_id, [&_cout = _cout, user_id](const std::string& msg) {
-    _cout(user_id, msg);
-  }, _contexts, _texts, _settings.initial_ctx_ids());
+  auto new_user = std::make_shared<User>(_name, user_id, UserMsgFn(user_id), _contexts, _texts, 
+      _settings.initial_ctx_ids());
+  new_user->set_event_budget(_settings.event_budget());
+  new_user->set_parser(ExpressionParser(std::bind(&Game::t_substitue_fn, this, std::ref(*new_user), 
+          std::placeholders::_1), true));
   // Link base Context
   util::Logger()->debug("Link base Context.");
   new_user->LinkContextToStack(_mechanics_ctx);
@@ -160,21 +202,156 @@ std::shared_ptr<User> Game::CreateNewUser(std::string user_id) {
   return new_user;
 }
 
+std::shared_ptr<User> Game::CreateInitializedUser(const std::string& user_id) {
+  // (Re-)build prototype if game-wide state changed since (a prototype not
+  // reusable for structural reasons, f.e. random or shared changes, is kept
+  // until the game is reloaded)
+  bool fresh_prototype = false;
+  if (!_user_prototype || (_user_prototype->reusable() && _user_prototype_version != DefinitionVersion())) {
+    ResetUserPrototype();
+    BuildUserPrototype();
+    fresh_prototype = true;
+  }
+  if (!_user_prototype->reusable()) {
+    auto new_user = CreateNewUser(user_id);
+    set_cur_user(new_user);
+    HandleUserEvent(*new_user, _settings.initial_events());
+    _users_initialized++;
+    return new_user;
+  }
+
+  std::shared_ptr<User> new_user;
+  {
+    std::lock_guard lock(_user_pool_mutex);
+    if (!_user_pool.empty()) {
+      new_user = _user_pool.back();
+      _user_pool.pop_back();
+    }
+  }
+  if (new_user)
+    new_user->set_id(user_id, UserMsgFn(user_id));
+  else 
+    new_user = CloneUser(*_user_prototype, user_id);
+  _users[user_id] = new_user;
+  set_cur_user(new_user);
+  for (const auto& msg : _user_prototype_msgs) {
+    _cout(user_id, msg);
+  }
+  _users_cloned++;
+  // Only pre-build users, if prototype is not outdated by every new user anyway
+  if (!fresh_prototype && _executor)
+    _executor->PostTask([this]() { FillUserPool(); });
+  return new_user;
+}
+
+bool Game::HotReload() {
+  util::LoggerContext scope(_name);
+  util::Logger()->info("Game::HotReload: loading new definition of {}", _name);
+  // Load without lock: events are still handled meanwhile
+  auto definition = LoadDefinition();
+  if (!definition)
+    return false;
+  std::unique_lock ul(_mutex);
+  MigrateToDefinition(std::move(*definition));
+  util::Logger()->info("Game::HotReload: {} reloaded, migrated {} users", _name, _users.size());
+  return true;
+}
+
 std::string Game::CheckLogic(const std::string& logic) {
+  std::shared_lock sl(_mutex);
   return _parser.Evaluate(logic);
 }
 
-// handlers
+Listener::Fn Game::BindHandler(Handler handler) {
+  return [this, handler](User* user, std::string event, std::string args) {
+    if (!user) {
+      util::Logger()->error("Game::BindHandler: {}, {}. No acting user given", event, args);
+      return;
+    }
+    (this->*handler)(*user, event, args);
+  };
+}
 
-void Game::h_add_ctx(const std::string& event, const std::string& ctx_id) {
-  util::Logger()->info("Adding context: {}", ctx_id);
-  if (!_cur_user) {
-    util::Logger()->error("Game::h_add_ctx: {}, {}. _cur_user is NULL", event, ctx_id);
+void Game::Defer(std::function<void()> fn) {
+  if (_building_user_prototype) {
+    _user_prototype->NotReusable("defers exclusive action");
     return;
   }
-  const auto& ctxs = _cur_user->GetContext(ctx_id, _parser);
+  std::lock_guard lock(_deferred_mutex);
+  _deferred.push_back(fn);
+}
+
+void Game::RunDeferred() {
+  for (;;) {
+    std::vector<std::function<void()>> deferred;
+    {
+      std::lock_guard lock(_deferred_mutex);
+      deferred.swap(_deferred);
+    }
+    if (deferred.empty()) 
+      return;
+    std::unique_lock ul(_mutex);
+    for (const auto& fn : deferred) {
+      fn();
+    }
+  }
+}
+
+std::optional<Game::Definition> Game::LoadDefinition() {
+  try {
+    Definition definition{txtad::Settings(*util::LoadJsonFromDisc(_path + "/" + txtad::GAME_SETTINGS)), 
+      builder::Settings(util::LoadJsonFromDisc(_path + "/" + txtad::BUILDER_EXTENSION)
+          .value_or(nlohmann::json::object())), {}, {}};
+    for (auto it : parser::LoadGameFiles(_path, definition._contexts, definition._texts, 
+          BindHandler(&Game::h_add_to_eventqueue))) {
+      it->set_fn(BindHandler(&Game::h_exec));
+    }
+    return definition;
+  } catch (std::exception& e) {
+    util::Logger()->error("Game::LoadDefinition. Loading game {} failed: \"{}\".", _name, e.what());
+  }
+  return std::nullopt;
+}
+
+void Game::MigrateToDefinition(Definition definition) {
+  // Game-wide state: shared contexts and texts
+  for (const auto& [key, ctx] : definition._contexts) {
+    auto old_ctx = util::get_ptr(_contexts, key);
+    if (ctx->shared() && old_ctx && old_ctx->shared())
+      ctx->MigrateState(*old_ctx);
+  }
+  for (const auto& [key, txt] : definition._texts) {
+    auto old_txt = util::get_ptr(_texts, key);
+    if (txt->shared() && old_txt && old_txt->shared())
+      txt->MigrateState(*old_txt);
+  }
+  ResetUserPrototype();
+  _settings = std::move(definition._settings);
+  _builder_settings = std::move(definition._builder_settings);
+  auto old_contexts = std::exchange(_contexts, std::move(definition._contexts));
+  _texts = std::move(definition._texts);
+  {
+    std::unique_lock ul(_substitute_paths_mutex);
+    _substitute_paths.clear();  // (texts may have changed)
+  }
+
+  // Users: recreate on new definition and take over their state
+  auto old_users = std::exchange(_users, {});
+  for (const auto& [user_id, old_user] : old_users) {
+    auto new_user = CreateNewUser(user_id);
+    new_user->MigrateState(*old_user, old_contexts);
+  }
+  if (auto last_user = cur_user())
+    set_cur_user(util::get_ptr(_users, last_user->id()));
+}
+
+// handlers
+
+void Game::h_add_ctx(User& user, const std::string& event, const std::string& ctx_id) {
+  util::Logger()->info("Adding context: {}", ctx_id);
+  const auto& ctxs = user.GetContext(ctx_id, user.parser());
   for (const auto& ctx : ctxs) {
-    _cur_user->LinkContextToStack(ctx);
+    user.LinkContextToStack(ctx);
   }
   // #TODO: Add option for ID replacement here !
   if (ctxs.size() == 0) {
@@ -182,81 +359,71 @@ void Game::h_add_ctx(const std::string& event, const std::string& ctx_id) {
   }
 }
 
-void Game::h_remove_ctx(const std::string& event, const std::string& ctx_id) {
+void Game::h_remove_ctx(User& user, const std::string& event, const std::string& ctx_id) {
   util::Logger()->info("Removing context: {}", ctx_id);
-  if (!_cur_user) {
-    util::Logger()->error("Game::h_remove_ctx: {}, {}. _cur_user is NULL", event, ctx_id);
-    return;
-  }
-  _cur_user->RemoveContext(ctx_id);
+  user.RemoveContext(ctx_id);
 }
 
-void Game::h_replace_ctx(const std::string& event, const std::string& args) {
+void Game::h_replace_ctx(User& user, const std::string& event, const std::string& args) {
   if (const auto& parsed = pattern::replace_ctx(args)) {
-    h_remove_ctx("", parsed->original_ctx);
-    h_add_ctx("", parsed->new_ctx);
+    h_remove_ctx(user, "", parsed->original_ctx);
+    h_add_ctx(user, "", parsed->new_ctx);
   }
 }
 
-void Game::h_set_ctx_name(const std::string& event, const std::string& args) {
+void Game::h_set_ctx_name(User& user, const std::string& event, const std::string& args) {
   util::Logger()->info("Game::h_set_ctx_name. args: {}", args);
-  if (!_cur_user) {
-    util::Logger()->error("Game::h_set_ctx_name: {}, {}. _cur_user is NULL", event, args);
-    return;
-  }
   if (const auto& parsed = pattern::set_ctx_name(args)) {
-    for (auto ctx : _cur_user->GetContext(parsed->ctx_id, _parser)) {
-      ctx->set_name(parsed->value);
+    for (auto ctx : user.GetContext(parsed->ctx_id, user.parser())) {
+      user.MutableContext(ctx)->set_name(parsed->value);
     }
   }
 }
 
-void Game::h_set_attribute(const std::string& event, const std::string& args) {
+void Game::h_set_attribute(User& user, const std::string& event, const std::string& args) {
   util::Logger()->info("Game::h_set_attribute: {}", args);
-  if (!_cur_user) {
-    util::Logger()->error("Game::h_set_attribute: {}, {}. _cur_user is NULL", event, args);
-    return;
-  }
   try {
     if (const auto parsed = pattern::set_attribute(args)) {
       // Find context: 
-      auto ctxs = _cur_user->GetContext(parsed->ctx_id, _parser);
+      auto ctxs = user.GetContext(parsed->ctx_id, user.parser());
       if (ctxs.empty()) {
         util::Logger()->warn("Game::h_set_attribute: ctx {} not found", parsed->ctx_id);
       }
       for (auto ctx : ctxs) {
         util::Logger()->debug("Game::h_set_attribute: ctx {}", ctx->id());
-        std::string attribute = "";
-        if (auto attr = ctx->GetAttribute(parsed->attribute_id)) {
-          attribute = *attr;
-        } else if (parsed->opt == "=") {
-          ctx->AddAttribute(parsed->attribute_id, "");
+        ctx = user.MutableContext(ctx);
+        if (!ctx->HasAttribute(parsed->attribute_id)) {
           util::Logger()->warn("Game::h_set_attribute: attribute {} not found in ctx {}. New attribute created", 
               parsed->attribute_id, ctx->id());
-        } else {
-          util::Logger()->warn("Game::h_set_attribute: attribute {} not found in ctx {}. New attribute created", 
-              parsed->attribute_id, ctx->id());
-          continue;
-        }
-        std::string res = "";
-        if (parsed->opt == "=") {
-          res = _parser.Evaluate(parsed->expression);
+          if (parsed->opt != "=")
+            continue;
+          ctx->AddAttribute(parsed->attribute_id, "");
         }
-        else if (parsed->opt == "++")
-          res = std::to_string(std::stoi(attribute) + 1);
-        else if (parsed->opt == "--")
-          res = std::to_string(std::stoi(attribute) - 1);
-        else if (parsed->opt == "+=")
-          res = std::to_string(std::stoi(attribute) + std::stoi(_parser.Evaluate(parsed->expression)));
-        else if (parsed->opt == "-=")
-          res = std::to_string(std::stoi(attribute) - std::stoi(_parser.Evaluate(parsed->expression)));
-        else if (parsed->opt == "*=")
-          res = std::to_string(std::stoi(attribute) * std::stoi(_parser.Evaluate(parsed->expression)));
-        else if (parsed->opt == "/=")
-          res = std::to_string(std::stoi(attribute) / std::stoi(_parser.Evaluate(parsed->expression)));
-        util::Logger()->debug("Game::h_set_attribute: setting {} to {}", parsed->attribute_id, res);
-        if (!ctx->SetAttribute(parsed->attribute_id, res))
-          util::Logger()->warn("Game::h_set_attribute: Failed setting attribute: {} to {}", parsed->attribute_id, res);
+        // Evaluate expression first, then update (shared contexts) atomically
+        std::string value = "";
+        if (parsed->opt != "++" && parsed->opt != "--")
+          value = user.parser().Evaluate(parsed->expression);
+        auto update = [&opt = parsed->opt, &value](const std::string& attribute) -> std::string {
+          if (opt == "=")
+            return value;
+          else if (opt == "++")
+            return std::to_string(std::stoi(attribute) + 1);
+          else if (opt == "--")
+            return std::to_string(std::stoi(attribute) - 1);
+          else if (opt == "+=")
+            return std::to_string(std::stoi(attribute) + std::stoi(value));
+          else if (opt == "-=")
+            return std::to_string(std::stoi(attribute) - std::stoi(value));
+          else if (opt == "*=")
+            return std::to_string(std::stoi(attribute) * std::stoi(value));
+          else if (opt == "/=")
+            return std::to_string(std::stoi(attribute) / std::stoi(value));
+          return "";
+        };
+        util::Logger()->debug("Game::h_set_attribute: setting {} ({} {})", parsed->attribute_id, parsed->opt, value);
+        if (!ctx->UpdateAttribute(parsed->attribute_id, update))
+          util::Logger()->warn("Game::h_set_attribute: Failed setting attribute: {} ({} {})", parsed->attribute_id, 
+              parsed->opt, value);
       } 
     } else {
       util::Logger()->debug("Game::h_set_attribute: Parsing failed: {}", args);
@@ -266,65 +433,51 @@ void Game::h_set_attribute(const std::string& event, const std::string& args) {
   }
 }
 
-void Game::h_add_to_eventqueue(const std::string& event, const std::string& args) {
-  if (_cur_user) {
-    std::string copy_args = args;
-    int pos = copy_args.find("${"); 
-    while (pos != std::string::npos) {
-      int closing = util::ClosingBracket(copy_args, pos+2, '{', '}');
-      if (closing != -1) {
-        std::string subsitute = copy_args.substr(pos+2, closing-pos-2);
-        util::Logger()->debug("Handler::AddToEventQueue: FOUND SUBSTITUE: {}", subsitute);
-        copy_args.replace(pos, closing-pos+1, t_substitue_fn(subsitute));
-      } else {
-        util::Logger()->warn("Handler::AddToEventQueue: sending to user via subsitute: closing bracket not found.");
-      }
-      pos = copy_args.find("${",pos+2); 
+void Game::h_add_to_eventqueue(User& user, const std::string& event, const std::string& args) {
+  std::string copy_args = args;
+  int pos = copy_args.find("${"); 
+  while (pos != std::string::npos) {
+    int closing = util::ClosingBracket(copy_args, pos+2, '{', '}');
+    if (closing != -1) {
+      std::string subsitute = copy_args.substr(pos+2, closing-pos-2);
+      util::Logger()->debug("Handler::AddToEventQueue: FOUND SUBSTITUE: {}", subsitute);
+      copy_args.replace(pos, closing-pos+1, t_substitue_fn(user, subsitute));
+    } else {
+      util::Logger()->warn("Handler::AddToEventQueue: sending to user via subsitute: closing bracket not found.");
     }
-    _cur_user->AddToEventQueue(copy_args);
+    pos = copy_args.find("${",pos+2); 
   }
-  else 
-    util::Logger()->error("Game::h_add_to_eventqueue. Invalid Game state. Current user no longer valid!");
+  user.AddToEventQueue(copy_args);
 }
 
-void Game::h_exec(const std::string& event, const std::string& args) {
-  if (!_cur_user) {
-    util::Logger()->error("Game::h_exec: {}, {}. _cur_user is NULL", event, args);
-    return;
-  }
-  const std::string event_queue = _cur_user->event_queue(); // Store event-queue
-  _cur_user->HandleEvent(args, _parser);
-  _cur_user->AddToEventQueue(event_queue); // And re-add here, since "HandleEvent" resets queue.
+void Game::h_exec(User& user, const std::string& event, const std::string& args) {
+  user.HandleEvent(args);  // (continues pending events afterwards)
 }
 
-void Game::h_print(const std::string& event, const std::string& args) {
+void Game::h_print(User& user, const std::string& event, const std::string& args) {
   util::Logger()->info("Handler::h_print: {} {}", event, args);
-  if (!_cur_user) {
-    util::Logger()->error("Game::h_print: {}, {}. _cur_user is NULL", event, args);
-    return;
-  }
-  std::string txt = GetText(event, args);
-  _cout(_cur_user->id(), txt);
+  std::string txt = GetText(user, event, args);
+  _cout(user.id(), txt);
   util::Logger()->debug("Handler::h_print: {} {} done", event, args);
 }
 
-void Game::h_print_with_prompt(const std::string& event, const std::string& args) {
+void Game::h_print_with_prompt(User& user, const std::string& event, const std::string& args) {
   util::Logger()->info("Handler::h_print_with_prompt: {} {}", event, args);
-  if (!_cur_user) {
-    util::Logger()->error("Game::h_print_with_prompt: {}, {}. _cur_user is NULL", event, args);
-    return;
-  }
-  std::string txt = GetText(event, args);
-  _cout(_cur_user->id(), txt + txtad::WEB_CMD_ADD_PROMPT);
+  std::string txt = GetText(user, event, args);
+  _cout(user.id(), txt + txtad::WEB_CMD_ADD_PROMPT);
   util::Logger()->debug("Handler::h_print_with_prompt: {} {} done", event, args);
 }
 
 
-void Game::h_print_to(const std::string& event, const std::string& args) {
+void Game::h_print_to(User& user, const std::string& event, const std::string& args) {
   util::Logger()->info("Handler::h_print_to: {}, {}", event, args);
+  if (user.prototype()) {
+    user.NotReusable("prints to other users");
+    return;
+  }
   std::string args_copy = args;
   if (args.front() == '*') {
-    std::string txt = GetText(event, args.substr(2)); // (skip leading whitespace 
+    std::string txt = GetText(user, event, args.substr(2)); // (skip leading whitespace 
     util::Logger()->info("Handler::h_print_to: sending to all users: {}", txt);
     for (const auto& it : _users) {
       _cout(it.first, txt);
@@ -335,83 +488,70 @@ void Game::h_print_to(const std::string& event, const std::string& args) {
     if (closing != -1) {
       std::string subsitute = args.substr(1, closing-1);
       // use `substr(len+3) for acknowledging whitespace and brackets 
-      std::string res = t_substitue_fn(subsitute);
+      std::string res = t_substitue_fn(user, subsitute);
       if (res.find(";") != std::string::npos) {
-        for (const auto& user : util::Split(res, ";")) {
-          _cout(user, GetText(event, args_copy.substr(subsitute.length()+3)));
+        for (const auto& to_user : util::Split(res, ";")) {
+          _cout(to_user, GetText(user, event, args_copy.substr(subsitute.length()+3)));
         }
       } else {
-        _cout(res, GetText(event, args_copy.substr(subsitute.length()+3)));
+        _cout(res, GetText(user, event, args_copy.substr(subsitute.length()+3)));
       }
     } else {
       util::Logger()->warn("Handler::h_print_to: sending to user via subsitute: closing bracket not found.");
     }
   } else if (auto user_id = util::GetUserId(args_copy)) {
     util::Logger()->info("Handler::h_print_to: sending to user via ID");
-    _cout(*user_id, GetText(event.substr(1), args_copy));
+    _cout(*user_id, GetText(user, event.substr(1), args_copy));
   } else {
     util::Logger()->warn("Handler::h_print_to. User-id or all-qualifier not found in {}", args);
   }
 }
 
-void Game::h_list_attributes(const std::string& event, const std::string& ctx_id) {
+void Game::h_list_attributes(User& user, const std::string& event, const std::string& ctx_id) {
   util::Logger()->info("Handler::h_list_attributes: {} {}", event, ctx_id);
-  if (!_cur_user) {
-    util::Logger()->error("Game::h_list_attributes: {}, {}. _cur_user is NULL", event, ctx_id);
-    return;
-  }
-
-  for (const auto& ctx : _cur_user->GetContext(ctx_id, _parser)) {
-    _cout(_cur_user->id(), "Attributes:");
+  for (const auto& ctx : user.GetContext(ctx_id, user.parser())) {
+    _cout(user.id(), "Attributes:");
     for (const auto& [key, value] : ctx->attributes()) {
       if (key.front() != '_') 
-        _cout(_cur_user->id(), "- " + key + ": " + value);
+        _cout(user.id(), "- " + key + ": " + value);
     }
   }
 }
 
-void Game::h_list_all_attributes(const std::string& event, const std::string& ctx_id) {
+void Game::h_list_all_attributes(User& user, const std::string& event, const std::string& ctx_id) {
   util::Logger()->info("Handler::h_list_all_attributes: {} {}", event, ctx_id);
-  if (!_cur_user) {
-    util::Logger()->error("Game::h_list_all_attributes: {}, {}. _cur_user is NULL", event, ctx_id);
-    return;
-  }
-  for (const auto& ctx : _cur_user->GetContext(ctx_id, _parser)) {
-    _cout(_cur_user->id(), "Attributes:");
+  for (const auto& ctx : user.GetContext(ctx_id, user.parser())) {
+    _cout(user.id(), "Attributes:");
     std::vector<std::string> hidden;
     for (const auto& [key, value] : ctx->attributes()) {
       std::string str = "- " + key + ": " + value;
       if (key.front() == '_') 
         hidden.push_back(str);
       else
-        _cout(_cur_user->id(), str);
+        _cout(user.id(), str);
     }
     for (const auto& it : hidden) {
-      _cout(_cur_user->id(), it);
+      _cout(user.id(), it);
     }
   }
 }
 
-void Game::h_list_linked_contexts(const std::string& event, const std::string& args) {
+void Game::h_list_linked_contexts(User& user, const std::string& event, const std::string& args) {
   util::Logger()->info("Handler::h_list_linked_contexts: {} {}", event, args);
-  if (!_cur_user) {
-    util::Logger()->error("Game::h_list_all_attributes: {}, {}. _cur_user is NULL", event, args);
-    return;
-  }
   if (auto member_access = pattern::member_access(args)) {
     if (member_access->member_type == pattern::CtxMemberAccess::VARIABLE) {
-      for (auto ctx : _cur_user->GetContext(member_access->ctx_id, _parser)) {
+      for (auto ctx : user.GetContext(member_access->ctx_id, user.parser())) {
         if (auto nested_member_access = pattern::member_access(member_access->key)) {
           for (const auto& it : ctx->LinkedContexts(nested_member_access->ctx_id.substr(1))) {
             if (auto linked_ctx = it.lock()) {
               std::string str = "";
               if (nested_member_access->member_type == pattern::CtxMemberAccess::VARIABLE)
-                User::AddVariableToText(linked_ctx, nested_member_access->key, str, _cur_user->event_queue(), _parser);
+                user.AddVariableToText(linked_ctx, nested_member_access->key, str, user.parser());
               else if (nested_member_access->member_type == pattern::CtxMemberAccess::ATTRIBUTE) {
                 if (auto attr = linked_ctx->GetAttribute(nested_member_access->key))
                   str = *attr;
               }
-              _cout(_cur_user->id(), "- " + str);
+              _cout(user.id(), "- " + str);
             }
           }
         }
@@ -420,117 +560,143 @@ void Game::h_list_linked_contexts(const std::string& event, const std::string& a
   }
 }
 
-void Game::h_list_contexts(const std::string& event, const std::string& args) {
+void Game::h_list_contexts(User& user, const std::string& event, const std::string& args) {
   util::Logger()->info("Handler::h_list_contexts: {} {}", event, args);
-  if (!_cur_user) {
-    util::Logger()->error("Game::h_list_contexts: {}, {}. _cur_user is NULL", event, args);
-    return;
-  }
   if (auto member_access = pattern::member_access(args)) {
-    for (const auto& it : _cur_user->GetContext(member_access->ctx_id, _parser)) {
+    for (auto it : user.GetContext(member_access->ctx_id, user.parser())) {
       std::string str = "";
-      if (member_access->member_type == pattern::CtxMemberAccess::VARIABLE)
-        User::AddVariableToText(it, member_access->key, str, _cur_user->event_queue(), _parser);
-      else if (member_access->member_type == pattern::CtxMemberAccess::ATTRIBUTE) {
+      if (member_access->member_type == pattern::CtxMemberAccess::VARIABLE) {
+        if ((member_access->key == "desc" || member_access->key == "description") 
+            && it->description()->one_time_events() != "")
+          it = user.MutableContext(it);
+        user.AddVariableToText(it, member_access->key, str, user.parser());
+      } else if (member_access->member_type == pattern::CtxMemberAccess::ATTRIBUTE) {
         if (auto attr = it->GetAttribute(member_access->key))
           str = *attr;
       }
-      _cout(_cur_user->id(), "- " + str);
+      _cout(user.id(), "- " + str);
     }
   }
 }
 
-void Game::h_reset_game(const std::string& event, const std::string& ctx_id) {
-  // Clear all contexts and texts
-  _contexts.clear();
-  _texts.clear();
-  // Gather user IDs
-  std::string cur_user_id = "";
-  if (_cur_user) {
-    cur_user_id = _cur_user->id();
-  } else {
-    util::Logger()->warn("Game::h_reset_game: {}, {}. _cur_user is NULL", event, ctx_id);
-  }
-  std::vector<std::string> user_ids; 
-  for (const auto& it : _users) {
-    user_ids.push_back(it.first);
-  }
-  // Reset all users
-  for (const auto& it : user_ids) {
-    _users.erase(it);
-  }
-  // Reload game files
-  parser::LoadGameFiles(_path, _contexts, _texts);
-  // Recreate all user
-  for (const auto& it : user_ids) {
-    CreateNewUser(it);
-  }
-  // Send clear all users and handle initial_events for all users
-  for (const auto& it : _users) {
-    _cout(it.first, txtad::WEB_CMD_CLEAR_CONSOLE);
-    _cur_user = it.second;
-    it.second->HandleEvent(_settings.initial_events(), _parser);
-  }
-  // Set current user to last current user
-  if (!cur_user_id.empty()) {
-    _cur_user = _users.at(cur_user_id);
-  } else {
-    _cur_user = nullptr;
-    util::Logger()->warn("Game::h_reset_game, done but without new _cur_user!");
-  }
+void Game::h_reset_game(User& user, const std::string& event, const std::string& ctx_id) {
+  // Resetting replaces all users, contexts and texts: done exclusively after current event chain.
+  Defer([this, cur_user_id = user.id()]() {
+    // Clear all contexts and texts
+    ResetUserPrototype();
+    _contexts.clear();
+    _texts.clear();
+    // Gather user IDs
+    std::vector<std::string> user_ids; 
+    for (const auto& it : _users) {
+      user_ids.push_back(it.first);
+    }
+    // Reset all users
+    for (const auto& it : user_ids) {
+      _users.erase(it);
+    }
+    set_cur_user(nullptr);
+    // Reload game files
+    for (auto it : parser::LoadGameFiles(_path, _contexts, _texts, 
+          BindHandler(&Game::h_add_to_eventqueue))) {
+      it->set_fn(BindHandler(&Game::h_exec));
+    }
+    // Recreate all user
+    for (const auto& it : user_ids) {
+      CreateNewUser(it);
+    }
+    // Send clear all users and handle initial_events for all users
+    for (const auto& it : _users) {
+      _cout(it.first, txtad::WEB_CMD_CLEAR_CONSOLE);
+      set_cur_user(it.second);
+      HandleUserEvent(*it.second, _settings.initial_events());
+    }
+    // Set current user to last current user
+    if (_users.contains(cur_user_id)) {
+      set_cur_user(_users.at(cur_user_id));
+    } else {
+      set_cur_user(nullptr);
+      util::Logger()->warn("Game::h_reset_game, done but without new _cur_user!");
+    }
+  });
 }
 
-void Game::h_reset_user(const std::string& event, const std::string& ctx_id) {
-  if (!_cur_user) {
-    util::Logger()->error("Game::h_reset_user: {}, {}. _cur_user is NULL", event, ctx_id);
-    return;
-  }
-  std::string user_id = _cur_user->id();
-  util::Logger()->info("Game::h_reset_user: Resetting user: {}. ", user_id);
-  _users.erase(user_id);
-  util::Logger()->info("Game::h_reset_user: Erased! cur_user use count: {}. ", _cur_user.use_count());
-  _cur_user = nullptr;
-  util::Logger()->info("Game::h_reset_user: Deleted! cur_user use count: {}. ", _cur_user.use_count());
-  _cur_user = CreateNewUser(user_id);
-  util::Logger()->info("Game::h_reset_user: Created new user with ID {}. ", _cur_user->id());
-  _cout(user_id, txtad::WEB_CMD_CLEAR_CONSOLE);
-  util::Logger()->info("Game::h_reset_user: Running initial cmds for: {}", _cur_user->id());
-  _cur_user->HandleEvent(_settings.initial_events(), _parser);
-  util::Logger()->info("Game::h_reset_user: DONE: {}", _cur_user->id());
-}
-
-void Game::h_remove_user(const std::string& event, const std::string& ctx_id) {
-  if (!_cur_user) {
-    util::Logger()->error("Game::h_reset_user: {}, {}. _cur_user is NULL", event, ctx_id);
-    return;
-  }
-  std::string user_id = _cur_user->id();
-  _users.erase(user_id);
-  _cur_user = nullptr;
+void Game::h_reset_user(User& user, const std::string& event, const std::string& ctx_id) {
+  // Resetting replaces the user: done exclusively after current event chain.
+  Defer([this, user_id = user.id()]() {
+    util::Logger()->info("Game::h_reset_user: Resetting user: {}. ", user_id);
+    _users.erase(user_id);
+    _cout(user_id, txtad::WEB_CMD_CLEAR_CONSOLE);
+    auto new_user = CreateInitializedUser(user_id);
+    util::Logger()->info("Game::h_reset_user: DONE: {}", new_user->id());
+  });
+}
+
+void Game::h_reload_game(User& user, const std::string& event, const std::string& ctx_id) {
+  // Replaces definition and users: done exclusively after current event chain.
+  Defer([this]() {
+    if (auto definition = LoadDefinition())
+      MigrateToDefinition(std::move(*definition));
+  });
+}
+
+void Game::h_remove_user(User& user, const std::string& event, const std::string& ctx_id) {
+  // Removing modifies users: done exclusively after current event chain.
+  Defer([this, user_id = user.id()]() {
+    _users.erase(user_id);
+    if (auto last_user = cur_user(); last_user && last_user->id() == user_id)
+      set_cur_user(nullptr);
+  });
 }
 
-std::string Game::t_substitue_fn(const std::string& subsitute) {
+std::string Game::t_substitue_fn(User& user, const std::string& subsitute) {
   util::Logger()->info("Game::t_substitue_fn: subsitute {}", subsitute);
-  if (!_cur_user) {
-    util::Logger()->error("Game::t_substitue_fn: {}. _cur_user is NULL", subsitute);
-    return txtad::NO_REPLACEMENT;
-  }
-  if (auto print_ctx = pattern::member_access(subsitute)) {
-    if (print_ctx->member_type == pattern::CtxMemberAccess::VARIABLE)
-      return GetText("", _cur_user->PrintCtx(print_ctx->ctx_id, print_ctx->key, _parser));
-    else if (print_ctx->member_type == pattern::CtxMemberAccess::ATTRIBUTE)
-      return _cur_user->PrintCtxAttribute(print_ctx->ctx_id, print_ctx->key, _parser);
-  } else if (_cur_user->texts().count(subsitute) > 0) {
-    return GetText("", _cur_user->PrintTxt(subsitute, _parser));
-  } else if (subsitute.starts_with(txtad::RAN_NUM)) {
-    return Game::RanSubstitute(subsitute);
-  } else {
-    util::Logger()->info("Handler::t_substitue_fn. {} did not match pattern.", subsitute);
+  const auto path = GetSubstitutePath(subsitute);
+  switch (path->_kind) {
+    case SubstitutePath::CTX_VARIABLE:
+      return GetText(user, "", user.PrintCtx(path->_ctx, path->_key, user.parser()));
+    case SubstitutePath::CTX_ATTRIBUTE:
+      return user.PrintCtxAttribute(path->_ctx, path->_key, user.parser());
+    case SubstitutePath::TEXT:
+      user.parser().NotMemoizable();  // (printing advances text)
+      return GetText(user, "", user.PrintTxt(path->_key, user.parser()));
+    case SubstitutePath::RAN_NUM:
+      user.NotReusable("random number");
+      user.parser().NotMemoizable();
+      return (path->_range) ? std::to_string(util::ran(path->_range->first, path->_range->second)) 
+        : txtad::NO_REPLACEMENT;
+    case SubstitutePath::NONE:
+      util::Logger()->info("Handler::t_substitue_fn. {} did not match pattern.", subsitute);
   }
   return txtad::NO_REPLACEMENT;
 }
 
-std::string Game::GetText(std::string event, std::string args) {
+std::shared_ptr<const Game::SubstitutePath> Game::GetSubstitutePath(const std::string& substitute) {
+  {
+    std::shared_lock sl(_substitute_paths_mutex);
+    if (auto it = _substitute_paths.find(substitute); it != _substitute_paths.end())
+      return it->second;
+  }
+  auto path = std::make_shared<SubstitutePath>();
+  if (auto print_ctx = pattern::member_access(substitute)) {
+    path->_kind = (print_ctx->member_type == pattern::CtxMemberAccess::VARIABLE) 
+      ? SubstitutePath::CTX_VARIABLE : SubstitutePath::CTX_ATTRIBUTE;
+    path->_ctx = User::Select(print_ctx->ctx_id);
+    path->_key = print_ctx->key;
+  } else if (_texts.count(substitute) > 0) {
+    path->_kind = SubstitutePath::TEXT;
+    path->_key = substitute;
+  } else if (substitute.starts_with(txtad::RAN_NUM)) {
+    path->_kind = SubstitutePath::RAN_NUM;
+    path->_range = RanRange(substitute);
+  }
+  std::unique_lock ul(_substitute_paths_mutex);
+  if (_substitute_paths.size() >= MAX_SUBSTITUTE_PATHS)
+    _substitute_paths.clear();
+  return _substitute_paths.emplace(substitute, std::move(path)).first->second;
+}
+
+std::string Game::GetText(User& user, std::string event, std::string args) {
   std::string txt = "";
   for (int i=0; i<args.length(); i++) {
     if (args[i] == '{') {
@@ -538,7 +704,7 @@ std::string Game::GetText(std::string event, std::string args) {
       if (closing != -1) {
         std::string subsitute = args.substr(i+1, closing-(i+1));
         util::Logger()->info("Handler::cout: found subsitute {}", subsitute);
-        txt += t_substitue_fn(subsitute);
+        txt += t_substitue_fn(user, subsitute);
         i = closing;
       } else {
         txt += args[i];
@@ -551,17 +717,112 @@ std::string Game::GetText(std::string event, std::string args) {
 }
 
 std::string Game::RanSubstitute(const std::string& subsitute) {
+  if (auto range = RanRange(subsitute))
+    return std::to_string(util::ran(range->first, range->second));
+  return txtad::NO_REPLACEMENT;
+}
+
+std::optional<std::pair<int, int>> Game::RanRange(const std::string& subsitute) {
   auto parts = util::Split(subsitute, "|");
-  if (parts.size() < 2) {
+  if (parts.size() < 3) {
     util::Logger()->warn("Handler::t_substitue_fn. {} RAN_NUM requires to and from, f.e. #ran_num|1|10.", subsitute);
-    return txtad::NO_REPLACEMENT;
+    return std::nullopt;
   }
   try { 
-    int from = std::stoi(parts[1]);
-    int to = std::stoi(parts[2]);
-    return std::to_string(util::ran(from, to));
+    return std::make_pair(std::stoi(parts[1]), std::stoi(parts[2]));
   } catch (std::exception& e) {
     util::Logger()->warn("Handler::t_substitue_fn. {} RAN_NUM requires arguments to be ints, f.e. #ran_num|1|10.", subsitute);
-    return txtad::NO_REPLACEMENT;
+    return std::nullopt;
+  }
+}
+
+void Game::HandleUserEvent(User& user, const std::string& event, bool user_inp) {
+  if (!user.HandleEvent(event, user_inp))
+    _aborted_chains++;
+}
+
+txtad::MsgFn Game::UserMsgFn(const std::string& user_id) {
+  return [&_cout = _cout, user_id](const std::string& msg) {
+    _cout(user_id, msg);
+  };
+}
+
+std::shared_ptr<User> Game::CloneUser(const User& prototype, const std::string& user_id) {
+  auto new_user = std::make_shared<User>(prototype, user_id, UserMsgFn(user_id));
+  new_user->set_parser(ExpressionParser(std::bind(&Game::t_substitue_fn, this, std::ref(*new_user), 
+          std::placeholders::_1), true));
+  return new_user;
+}
+
+void Game::BuildUserPrototype() {
+  util::Logger()->info("Game::BuildUserPrototype: running initial events for prototype");
+  // Record messages to prototype instead of sending them
+  std::vector<std::string> msgs;
+  auto cout = std::exchange(_cout, [&msgs, this](std::string user_id, std::string msg) {
+    if (user_id == txtad::PROTOTYPE_USER_ID)
+      msgs.push_back(msg);
+    else
+      _user_prototype->NotReusable("messages other user");
+  });
+  _user_prototype = std::make_shared<User>(_name, txtad::PROTOTYPE_USER_ID, UserMsgFn(txtad::PROTOTYPE_USER_ID), 
+      _contexts, _texts, _settings.initial_ctx_ids());
+  _user_prototype->set_parser(ExpressionParser(std::bind(&Game::t_substitue_fn, this, std::ref(*_user_prototype), 
+          std::placeholders::_1), true));
+  _user_prototype->LinkContextToStack(_mechanics_ctx);
+  _user_prototype->set_event_budget(_settings.event_budget());
+  _user_prototype->set_prototype(true);
+  _building_user_prototype = true;
+  try {
+    if (!_user_prototype->HandleEvent(_settings.initial_events()))
+      _user_prototype->NotReusable("event chain aborted");
+  } catch (std::exception& e) {
+    _user_prototype->NotReusable(e.what());
+  }
+  _building_user_prototype = false;
+  _cout = cout;
+
+  // State must not depend on the user's id
+  if (_user_prototype->StateContains(txtad::PROTOTYPE_USER_ID))
+    _user_prototype->NotReusable("state contains user id");
+  for (const auto& msg : msgs) {
+    if (msg.find(txtad::PROTOTYPE_USER_ID) != std::string::npos)
+      _user_prototype->NotReusable("message contains user id");
+  }
+  _user_prototype_msgs = std::move(msgs);
+  _user_prototype_version = DefinitionVersion();
+  util::Logger()->info("Game::BuildUserPrototype: done (reusable: {})", _user_prototype->reusable());
+}
+
+void Game::ResetUserPrototype() {
+  _user_prototype = nullptr;
+  _user_prototype_msgs.clear();
+  std::lock_guard lock(_user_pool_mutex);
+  _user_pool.clear();
+}
+
+void Game::FillUserPool() {
+  std::shared_lock sl(_mutex);
+  if (!_user_prototype || !_user_prototype->reusable())
+    return;
+  for (;;) {
+    {
+      std::lock_guard lock(_user_pool_mutex);
+      if (_user_pool.size() >= txtad::USER_POOL_SIZE)
+        return;
+    }
+    auto new_user = CloneUser(*_user_prototype, txtad::PROTOTYPE_USER_ID);
+    std::lock_guard lock(_user_pool_mutex);
+    _user_pool.push_back(new_user);
+  }
+}
+
+uint64_t Game::DefinitionVersion() const {
+  uint64_t version = 0;
+  for (const auto& [key, ctx] : _contexts) {
+    version += ctx->version();
+  }
+  for (const auto& [key, txt] : _texts) {
+    version += txt->version();
   }
+  return version;
 }
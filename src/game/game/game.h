@@ -2,23 +2,43 @@
 #define SRC_GAME_GAME_H 
 
 #include "builder/utils/defines.h"
+#include "game/game/game_executor.h"
 #include "game/game/user.h"
 #include "shared/objects/context/context.h"
 #include "shared/objects/settings/settings.h"
 #include "shared/objects/text/text.h"
+#include "shared/utils/eventmanager/listener.h"
 #include "shared/utils/parser/expression_parser.h"
+#include <atomic>
+#include <cstdint>
 #include <functional>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <optional>
 #include <shared_mutex>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 class Game {
   public: 
     using MsgFn = std::function<void(std::string, std::string)>;
 
+    struct UserStats {
+      size_t _cloned;  ///< new users cloned from prototype
+      size_t _initialized;  ///< new users running initial events (prototype not reusable)
+      size_t _pooled;  ///< pre-built users ready
+    };
+
     Game() {};
-    Game(std::string path, std::string name);
+    /**
+     * @param[in] path 
+     * @param[in] name 
+     * @param[in] cout (sends messages to users, defaults to this thread's global msg-fn)
+     */
+    Game(std::string path, std::string name, MsgFn cout=nullptr);
     ~Game();
 
     // getter 
@@ -28,32 +48,76 @@ class Game {
     const std::map<std::string, std::shared_ptr<Text>>& texts() const;
     const txtad::Settings& settings() const;
     const builder::Settings& builder_settings() const;
-    const std::shared_ptr<User>& cur_user();
+    std::shared_ptr<User> cur_user() const;  ///< last user, which handled an event
     bool running() const;
     const ExpressionParser& parser() const;
+    GameExecutor::Stats executor_stats() const;
+    UserStats user_stats() const;
+    size_t aborted_chains() const;  ///< event chains aborted for exceeding the event budget
     
     // setter 
-    static void set_global_msg_fn(MsgFn fn);
+    static void set_global_msg_fn(MsgFn fn);  ///< default msg-fn of games created on this thread
     void set_msg_fn(MsgFn fn);
     void set_running(bool status);
 
     // methods 
+
+    /**
+     * Handles event for given user. Events of different users are handled in
+     * parallel (only locking the acting user). Creating users and
+     * game-/user-resets are executed exclusively.
+     */
     void HandleEvent(const std::string& user_id, const std::string& event);
+
+    /**
+     * Enqueues event for given user to the game's executor (returns
+     * immediately). Events of a user are handled in order, those of
+     * different users in parallel on the executor's workers (see
+     * HandleEvent). `done` is called once the event was handled.
+     */
+    void Post(const std::string& user_id, const std::string& event, GameExecutor::DoneFn done=nullptr);
     std::shared_ptr<User> CreateNewUser(std::string user_id);
+
+    /**
+     * Creates user in state after initial events. Usually cloned from a
+     * prototype user (taken from the pool of pre-built users if available),
+     * replaying the prototype's messages. Initial events are run for the user
+     * only if their outcome can't be reused (see User::set_prototype).
+     * Requires exclusive access.
+     */
+    std::shared_ptr<User> CreateInitializedUser(const std::string& user_id);
+
+    /**
+     * Reloads game files without resetting users (hot-swap): the new
+     * definition is loaded while events are still handled, then users'
+     * context stacks, attributes and text state are migrated onto it by id
+     * at an event boundary. 
+     * @return false if loading failed (old definition is kept).
+     */
+    bool HotReload();
     std::string CheckLogic(const std::string& logic);
     static std::string RanSubstitute(const std::string& substitue);
+    /** Range of "#ran_num|from|to" (nullopt, if invalid). */
+    static std::optional<std::pair<int, int>> RanRange(const std::string& substitue);
 
   protected: 
-    static MsgFn _global_cout;
+    using Handler = void (Game::*)(User&, const std::string&, const std::string&);
+
+    static thread_local MsgFn _global_cout;
     MsgFn _cout;
 
-    mutable std::shared_mutex _mutex;  ///< Mutex for connections_.
+    mutable std::shared_mutex _mutex;  ///< Mutex for users, contexts and texts (exclusive when modified).
     const std::string _path;
     const std::string _name;
+    std::shared_ptr<spdlog::logger> _logger;
     std::map<std::string, std::shared_ptr<User>> _users;
     std::shared_ptr<User> _cur_user;
+    mutable std::mutex _cur_user_mutex;
     bool _running;
 
+    std::vector<std::function<void()>> _deferred;  ///< exclusive actions, run once event chain is done
+    std::mutex _deferred_mutex;
+
     ExpressionParser _parser;
 
     txtad::Settings _settings;
@@ -62,35 +126,117 @@ class Game {
     std::map<std::string, std::shared_ptr<Context>> _contexts;
     std::map<std::string, std::shared_ptr<Text>> _texts;
 
-    // handlers 
-    void h_add_ctx(const std::string& event, const std::string& ctx_id);
-    void h_remove_ctx(const std::string& event, const std::string& ctx_id);
-    void h_replace_ctx(const std::string& event, const std::string& args);
-    void h_set_ctx_name(const std::string& event, const std::string& args);
-    void h_set_attribute(const std::string& event, const std::string& args);
-
-    void h_add_to_eventqueue(const std::string& event, const std::string& args);
-    void h_exec(const std::string& event, const std::string& args);
-
-    void h_print(const std::string& event, const std::string& args);
-    void h_print_with_prompt(const std::string& event, const std::string& args);
-    void h_print_to(const std::string& event, const std::string& args);
-
-    void h_list_attributes(const std::string& event, const std::string& ctx_id);
-    void h_list_all_attributes(const std::string& event, const std::string& ctx_id);
-    void h_list_linked_contexts(const std::string& event, const std::string& ctx_id);
-    void h_list_contexts(const std::string& event, const std::string& ctx_id);
-
-    void h_reset_game(const std::string& event, const std::string& ctx_id);
-    void h_reset_user(const std::string& event, const std::string& ctx_id);
-
-    void h_remove_user(const std::string& event, const std::string& ctx_id);
+    // Pre-built users (see CreateInitializedUser)
+    std::shared_ptr<User> _user_prototype;  ///< state after initial events
+    std::vector<std::string> _user_prototype_msgs;  ///< messages sent to prototype (replayed to new users)
+    uint64_t _user_prototype_version = 0;  ///< definition version prototype was built on
+    bool _building_user_prototype = false;
+    std::vector<std::shared_ptr<User>> _user_pool;  ///< clones of prototype (id assigned when taken)
+    mutable std::mutex _user_pool_mutex;
+    std::atomic<size_t> _users_cloned = 0;
+    std::atomic<size_t> _users_initialized = 0;
+    std::atomic<size_t> _aborted_chains = 0;
+
+    std::unique_ptr<GameExecutor> _executor;  ///< worker handling posted events (stopped first on destruction)
+
+    // handlers (all receive the acting user)
+    void h_add_ctx(User& user, const std::string& event, const std::string& ctx_id);
+    void h_remove_ctx(User& user, const std::string& event, const std::string& ctx_id);
+    void h_replace_ctx(User& user, const std::string& event, const std::string& args);
+    void h_set_ctx_name(User& user, const std::string& event, const std::string& args);
+    void h_set_attribute(User& user, const std::string& event, const std::string& args);
+
+    void h_add_to_eventqueue(User& user, const std::string& event, const std::string& args);
+    void h_exec(User& user, const std::string& event, const std::string& args);
+
+    void h_print(User& user, const std::string& event, const std::string& args);
+    void h_print_with_prompt(User& user, const std::string& event, const std::string& args);
+    void h_print_to(User& user, const std::string& event, const std::string& args);
+
+    void h_list_attributes(User& user, const std::string& event, const std::string& ctx_id);
+    void h_list_all_attributes(User& user, const std::string& event, const std::string& ctx_id);
+    void h_list_linked_contexts(User& user, const std::string& event, const std::string& ctx_id);
+    void h_list_contexts(User& user, const std::string& event, const std::string& ctx_id);
+
+    void h_reset_game(User& user, const std::string& event, const std::string& ctx_id);
+    void h_reset_user(User& user, const std::string& event, const std::string& ctx_id);
+    void h_reload_game(User& user, const std::string& event, const std::string& ctx_id);
+
+    void h_remove_user(User& user, const std::string& event, const std::string& ctx_id);
+
+    /**
+     * Substitute (f.e. "{room.visited}") parsed once: what it refers to,
+     * resolved against the acting user (see t_substitue_fn).
+     */
+    struct SubstitutePath {
+      enum Kind { CTX_VARIABLE, CTX_ATTRIBUTE, TEXT, RAN_NUM, NONE } _kind = NONE;
+      User::ContextSelector _ctx;  ///< (CTX_*)
+      std::string _key;  ///< variable, attribute (CTX_*) or text-id
+      std::optional<std::pair<int, int>> _range;  ///< (RAN_NUM, nullopt if invalid)
+    };
+    static constexpr size_t MAX_SUBSTITUTE_PATHS = 4096;
+    std::unordered_map<std::string, std::shared_ptr<const SubstitutePath>> _substitute_paths;  ///< (by substitute)
+    mutable std::shared_mutex _substitute_paths_mutex;
 
     // tools
-    std::string t_substitue_fn(const std::string& str);
+    std::string t_substitue_fn(User& user, const std::string& str);
 
     // helpers 
-    std::string GetText(std::string event, std::string args);
+    std::string GetText(User& user, std::string event, std::string args);
+    /** Parsed substitute (parsed on first use, texts of current definition). */
+    std::shared_ptr<const SubstitutePath> GetSubstitutePath(const std::string& substitute);
+    void HandleUserEvent(User& user, const std::string& event, bool user_inp=false);  ///< counts aborted chains
+    txtad::MsgFn UserMsgFn(const std::string& user_id);
+    std::shared_ptr<User> CloneUser(const User& prototype, const std::string& user_id);
+
+    /**
+     * Runs initial events for a prototype user, recording its messages.
+     * Requires exclusive access.
+     */
+    void BuildUserPrototype();
+    void ResetUserPrototype();
+
+    /**
+     * Fills pool of pre-built users (run on executor in background).
+     */
+    void FillUserPool();
+
+    /**
+     * Sum of versions of all contexts and texts: changes with any
+     * modification of game-wide state.
+     */
+    uint64_t DefinitionVersion() const;
+
+    /**
+     * Wraps handler into listener-function, rejecting calls without acting user.
+     */
+    Listener::Fn BindHandler(Handler handler);
+    void set_cur_user(std::shared_ptr<User> user);
+
+    /**
+     * Defers action until the current event chain is done. Deferred actions
+     * are run with exclusive access to the game (f.e. removing users).
+     */
+    void Defer(std::function<void()> fn);
+    void RunDeferred();
+
+    struct Definition {
+      txtad::Settings _settings;
+      builder::Settings _builder_settings;
+      std::map<std::string, std::shared_ptr<Context>> _contexts;
+      std::map<std::string, std::shared_ptr<Text>> _texts;
+    };
+
+    /**
+     * Loads game files into a new definition (does not touch running game).
+     */
+    std::optional<Definition> LoadDefinition();
+
+    /**
+     * Replaces current definition, migrating game-wide and users' state.
+     * Requires exclusive access.
+     */
+    void MigrateToDefinition(Definition definition);
 };
 
 #endif
@@ -0,0 +1,111 @@
+#include "game/game/game_executor.h"
+#include "shared/utils/utils.h"
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <functional>
+
+GameExecutor::GameExecutor(std::string name, HandlerFn fn, size_t workers) : _name(name), _fn(fn), 
+    _next_task(0), _stop(false), _queue_depth(0), _max_queue_depth(0), _handled(0), _total_service_us(0), 
+    _max_service_us(0) {
+  for (size_t i = 0; i < std::max<size_t>(workers, 1); i++) 
+    _workers.push_back(std::make_unique<Worker>());
+  for (auto& worker : _workers) 
+    worker->_thread = std::thread(&GameExecutor::Run, this, std::ref(*worker));
+}
+
+GameExecutor::~GameExecutor() {
+  Stop();
+}
+
+// getter
+GameExecutor::Stats GameExecutor::stats() const {
+  return {_queue_depth.load(), _max_queue_depth.load(), _handled.load(), _total_service_us.load(),
+    _max_service_us.load()};
+}
+
+// methods
+void GameExecutor::Post(std::string user_id, std::string event, DoneFn done) {
+  std::shared_lock sl(_post_mutex);
+  if (_stop) {
+    util::Logger()->warn("GameExecutor::Post: {} already stopped. Dropped event {}", _name, event);
+    return;
+  }
+  Worker& worker = *_workers[std::hash<std::string>{}(user_id) % _workers.size()];
+  Push(worker, {user_id, event, done, nullptr});
+}
+
+void GameExecutor::PostTask(std::function<void()> task) {
+  std::shared_lock sl(_post_mutex);
+  if (_stop) 
+    return;
+  Push(*_workers[_next_task++ % _workers.size()], {"", "", nullptr, task});
+}
+
+void GameExecutor::Push(Worker& worker, Job job) {
+  if (!job._task) {
+    size_t depth = ++_queue_depth;
+    size_t max_depth = _max_queue_depth.load();
+    while (depth > max_depth && !_max_queue_depth.compare_exchange_weak(max_depth, depth)) {}
+  }
+  worker._queue.Push(std::move(job));
+  worker._signal.fetch_add(1);
+  worker._signal.notify_one();
+}
+
+void GameExecutor::Stop() {
+  {
+    std::unique_lock ul(_post_mutex);
+    _stop = true;
+  }
+  for (auto& worker : _workers) {
+    worker->_signal.fetch_add(1);
+    worker->_signal.notify_one();
+  }
+  for (auto& worker : _workers) {
+    if (worker->_thread.joinable())
+      worker->_thread.join();
+  }
+}
+
+void GameExecutor::Run(Worker& worker) {
+  util::LoggerContext scope(_name);
+  util::Logger()->info("GameExecutor::Run: started worker for {}", _name);
+  for (;;) {
+    // Read signal before popping: every push is followed by a bump, so waiting on it can't miss an event.
+    // Once stopped, nothing is enqueued anymore: an empty queue is done.
+    uint64_t signal = worker._signal.load();
+    const bool stop = _stop;
+    auto job = worker._queue.Pop();
+    if (!job) {
+      if (stop)
+        break;
+      worker._signal.wait(signal);
+      continue;
+    }
+    if (job->_task) {
+      try {
+        job->_task();
+      } catch (std::exception& e) {
+        util::Logger()->error("GameExecutor::Run: background task failed: {}", e.what());
+      }
+      continue;
+    }
+    auto start = std::chrono::steady_clock::now();
+    try {
+      _fn(job->_user_id, job->_event);
+    } catch (std::exception& e) {
+      util::Logger()->error("GameExecutor::Run: Handling: {}, {} failed: {}", job->_user_id, job->_event, e.what());
+    }
+    int64_t service_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count();
+    _total_service_us += service_us;
+    int64_t max_service_us = _max_service_us.load();
+    while (service_us > max_service_us && !_max_service_us.compare_exchange_weak(max_service_us, service_us)) {}
+    _handled++;
+    _queue_depth--;
+    if (job->_done)
+      job->_done();
+  }
+  util::Logger()->info("GameExecutor::Run: stopped worker for {}", _name);
+}
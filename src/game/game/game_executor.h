@@ -0,0 +1,95 @@
+#ifndef SRC_GAME_GAME_EXECUTOR_H
+#define SRC_GAME_GAME_EXECUTOR_H
+
+#include "shared/utils/mpsc_queue.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Executes the events of one game on its own worker threads. Events are
+ * enqueued from any thread, f.e. the network thread. Each user is assigned to
+ * one worker (by id), so events of a user are handled in order of arrival,
+ * while events of users on different workers are handled in parallel.
+ */
+class GameExecutor {
+  public:
+    using HandlerFn = std::function<void(const std::string&, const std::string&)>;
+    using DoneFn = std::function<void()>;
+
+    struct Stats {
+      size_t _queue_depth;  ///< events waiting or in progress
+      size_t _max_queue_depth;
+      size_t _handled;  ///< events handled in total
+      int64_t _total_service_us;  ///< time spent handling events (microseconds)
+      int64_t _max_service_us;
+    };
+
+    /**
+     * @param[in] name (logger used by worker threads)
+     * @param[in] fn (called on worker threads with user_id and event)
+     * @param[in] workers (number of worker threads, at least one)
+     */
+    GameExecutor(std::string name, HandlerFn fn, size_t workers=1);
+    ~GameExecutor();
+
+    // getter
+    Stats stats() const;
+
+    // methods
+
+    /**
+     * Enqueues event for given user (dropped, if already stopped). `done` is
+     * called on the user's worker thread, once the event was handled.
+     */
+    void Post(std::string user_id, std::string event, DoneFn done=nullptr);
+
+    /**
+     * Enqueues background work (f.e. pre-building users), run on one of the
+     * worker threads in order with its events (not counted in stats).
+     */
+    void PostTask(std::function<void()> task);
+
+    /**
+     * Handles all remaining events, then stops and joins the worker threads.
+     */
+    void Stop();
+
+  private:
+    struct Job {
+      std::string _user_id;
+      std::string _event;
+      DoneFn _done;
+      std::function<void()> _task;  ///< set for background work (no event)
+    };
+
+    struct Worker {
+      util::MPSCQueue<Job> _queue;
+      std::atomic<uint64_t> _signal = 0;  ///< bumped after every push and on stop (worker waits on it)
+      std::thread _thread;
+    };
+
+    const std::string _name;
+    const HandlerFn _fn;
+    std::vector<std::unique_ptr<Worker>> _workers;
+    std::atomic<size_t> _next_task;  ///< worker running the next background task (round robin)
+    std::atomic<bool> _stop;
+    std::shared_mutex _post_mutex;  ///< Shared while enqueuing, exclusive to stop (nothing enqueued after)
+
+    std::atomic<size_t> _queue_depth;
+    std::atomic<size_t> _max_queue_depth;
+    std::atomic<size_t> _handled;
+    std::atomic<int64_t> _total_service_us;
+    std::atomic<int64_t> _max_service_us;
+
+    void Push(Worker& worker, Job job);
+    void Run(Worker& worker);
+};
+
+#endif
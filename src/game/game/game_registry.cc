@@ -0,0 +1,31 @@
+#include "game/game/game_registry.h"
+
+GameRegistry::GameRegistry(Games games) : _games(std::make_shared<const Games>(std::move(games))) {}
+
+// getter
+std::shared_ptr<const GameRegistry::Games> GameRegistry::snapshot() const {
+  return _games.load();
+}
+
+std::shared_ptr<Game> GameRegistry::get(const std::string& game_id) const {
+  auto games = _games.load();
+  auto it = games->find(game_id);
+  return (it != games->end()) ? it->second : nullptr;
+}
+
+// methods
+void GameRegistry::Publish(const std::string& game_id, std::shared_ptr<Game> game) {
+  std::lock_guard lock(_write_mutex);
+  auto games = std::make_shared<Games>(*_games.load());
+  (*games)[game_id] = game;
+  _games.store(std::move(games));
+}
+
+bool GameRegistry::Remove(const std::string& game_id) {
+  std::lock_guard lock(_write_mutex);
+  auto games = std::make_shared<Games>(*_games.load());
+  if (games->erase(game_id) == 0)
+    return false;
+  _games.store(std::move(games));
+  return true;
+}
@@ -0,0 +1,45 @@
+#ifndef SRC_GAME_GAME_REGISTRY_H
+#define SRC_GAME_GAME_REGISTRY_H
+
+#include "game/game/game.h"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/**
+ * Registry of running games (read-copy-update). Readers take an immutable
+ * snapshot without locking; writers copy the snapshot, modify the copy and
+ * publish it with one atomic pointer swap. Replaced games are destroyed, once
+ * the last reader dropped its snapshot.
+ */
+class GameRegistry {
+  public:
+    using Games = std::map<std::string, std::shared_ptr<Game>>;
+
+    GameRegistry(Games games={});
+
+    // getter
+    std::shared_ptr<const Games> snapshot() const;
+    std::shared_ptr<Game> get(const std::string& game_id) const;
+
+    // methods
+
+    /**
+     * Adds or replaces game. The game should be fully constructed, as it is
+     * visible to readers right away.
+     */
+    void Publish(const std::string& game_id, std::shared_ptr<Game> game);
+
+    /**
+     * Removes game. Returns false if game did not exist.
+     */
+    bool Remove(const std::string& game_id);
+
+  private:
+    std::atomic<std::shared_ptr<const Games>> _games;
+    std::mutex _write_mutex;  ///< serializes writers only (readers never lock)
+};
+
+#endif
@@ -5,6 +5,7 @@
 #include "shared/utils/parser/pattern_parser.h"
 #include "shared/utils/utils.h"
 #include <cctype>
+#include <fmt/format.h>
 #include <memory>
 #include <optional>
 #include <utility>
@@ -43,21 +44,26 @@ std::string ParenthesizeQueryClauses(const std::string& query) {
   return parenthesized + "(" + query.substr(clause_begin) + ")";
 }
 
-std::string ExpandQuery(const std::string& query, const std::string& context_id) {
-  std::string expanded;
+/**
+ * Splits query at the context-id of its relative members (".attribute" or
+ * "->variable" become "{<ctx-id>.attribute}"), f.e. ".a = 1" into {"{", ".a} = 1"}.
+ * Returns no pieces, if the query is invalid (matching no context).
+ */
+std::vector<std::string> SplitQuery(const std::string& query) {
+  std::vector<std::string> pieces = {""};
   bool quoted = false;
 
   for (std::size_t i = 0; i < query.size();) {
     if (query[i] == '\'') {
       quoted = !quoted;
-      expanded += query[i++];
+      pieces.back() += query[i++];
       continue;
     }
 
     const bool attribute = query[i] == '.';
     const bool variable = query[i] == '-' && i + 1 < query.size() && query[i + 1] == '>';
     if (quoted || (!attribute && !variable)) {
-      expanded += query[i++];
+      pieces.back() += query[i++];
       continue;
     }
 
@@ -71,19 +77,44 @@ std::string ExpandQuery(const std::string& query, const std::string& context_id)
 
     if (member_begin == i) {
       util::Logger()->warn("User::GetContext. Invalid relative member in query: {}", query);
-      return "";
+      return {};
     }
 
-    expanded += "{" + context_id + member_access +
-      query.substr(member_begin, i - member_begin) + "}";
+    pieces.back() += "{";
+    pieces.push_back(member_access + query.substr(member_begin, i - member_begin) + "}");
   }
 
   if (quoted) {
     util::Logger()->warn("User::GetContext. Unclosed quote in query: {}", query);
-    return "";
+    return {};
   }
 
-  return ParenthesizeQueryClauses(expanded);
+  return (query.empty()) ? std::vector<std::string>() : pieces;
+}
+
+const size_t RECENT_EVENTS = 16;
+
+/**
+ * Describes recent events as repeating cycle ("a -> b -> a"), if they end with
+ * one, otherwise lists them.
+ */
+std::string DescribeRecentEvents(const std::deque<std::string>& recent) {
+  const size_t n = recent.size();
+  for (size_t period = 1; period <= n / 2; period++) {
+    bool cycle = true;
+    for (size_t i = n - period; i < n && cycle; i++) 
+      cycle = recent[i] == recent[i - period];
+    if (cycle) {
+      std::string str = "cycle: ";
+      for (size_t i = n - period; i < n; i++) 
+        str += recent[i] + " -> ";
+      return str + recent[n - period];
+    }
+  }
+  std::string str = "last events: ";
+  for (size_t i = 0; i < n; i++) 
+    str += ((i > 0) ? ", " : "") + recent[i];
+  return str;
 }
 
 } // namespace
@@ -92,32 +123,10 @@ User::User(const std::string& game_id, const std::string& id, const txtad::MsgFn
     const std::map<std::string, std::shared_ptr<Context>>& contexts, 
     const std::map<std::string, std::shared_ptr<Text>>& texts, 
     const std::vector<std::string>& initial_contexts) 
-    : _game_id(game_id), _id(id), _cout(cout) { 
-  int shared = 0;
-  int copied = 0;
-  util::Logger()->info("User::User({}). Copying/linking contexts...", _id);
-  for (const auto& [key, ctx] : contexts) {
-    if (ctx->shared()) {
-      _contexts[key] = ctx;
-      shared++;
-    } else {
-      _contexts[key] = std::make_shared<Context>(*ctx);
-      copied++;
-    }
-  }
-  util::Logger()->info("User::User({}). Shared {} and copied {} contexts", _id, shared, copied);
-  shared = 0; copied = 0;
-  util::Logger()->info("User::User({}). Copying/linking texts...", _id);
-  for (const auto& [key, txt] : texts) {
-    if (txt->shared()) {
-      _texts[key] = txt;
-      shared++;
-    } else {
-      _texts[key] = std::make_shared<Text>(*txt);
-      copied++;
-    }
-  }
-  util::Logger()->info("User::User({}). Shared {} and copied {} texts", _id, shared, copied);
+    : _game_id(game_id), _id(id), _cout(cout), _event_handled(false), _prototype(false), _reusable(true) { 
+  // Non-shared contexts and texts are copied on first modification (see MutableContext)
+  _contexts = contexts;
+  _texts = texts;
 
   for (const auto& it : initial_contexts) {
     if (_contexts.count(it) > 0)
@@ -127,6 +136,24 @@ User::User(const std::string& game_id, const std::string& id, const txtad::MsgFn
   }
 }
 
+User::User(const User& prototype, const std::string& id, const txtad::MsgFn& cout) 
+    : _game_id(prototype._game_id), _id(id), _cout(cout), _contexts(prototype._contexts), 
+      _texts(prototype._texts), _own_contexts(prototype._own_contexts), _own_texts(prototype._own_texts),
+      _event_queue(prototype._event_queue), _event_handled(false), _event_budget(prototype._event_budget), 
+      _prototype(false), _reusable(true) {
+  for (const auto& it : _own_contexts) 
+    _contexts[it] = std::make_shared<Context>(*_contexts.at(it));
+  for (const auto& it : _own_texts) 
+    _texts[it] = std::make_shared<Text>(*_texts.at(it));
+  // Same stack (in same order), using own contexts
+  for (const auto& it : prototype._context_stack.GetOrder()) {
+    if (auto ctx = util::get_ptr(_contexts, it))
+      LinkContextToStack(ctx);
+    else 
+      LinkContextToStack(prototype._context_stack.get(it));
+  }
+}
+
 // getter
 const std::string& User::id() const {
   return _id;
@@ -140,7 +167,7 @@ const std::map<std::string, std::shared_ptr<Text>>& User::texts() {
   return _texts;
 }
 
-std::string& User::event_queue() {
+const EventQueue& User::event_queue() const {
   return _event_queue;
 }
 
@@ -148,21 +175,88 @@ const ContextStack& User::context_stack() const {
   return _context_stack;
 }
 
+const ExpressionParser& User::parser() const {
+  return _parser;
+}
+
+std::mutex& User::mutex() {
+  return _mutex;
+}
+
+bool User::prototype() const {
+  return _prototype;
+}
+
+bool User::reusable() const {
+  return _reusable;
+}
+
+// setter 
+void User::set_parser(ExpressionParser parser) {
+  _parser = std::move(parser);
+}
+
+void User::set_id(const std::string& id, const txtad::MsgFn& cout) {
+  _id = id;
+  _cout = cout;
+}
+
+void User::set_event_budget(const txtad::EventBudget& budget) {
+  _event_budget = budget;
+}
+
+void User::set_prototype(bool prototype) {
+  _prototype = prototype;
+}
+
 // methods 
-void User::HandleEvent(const std::string& event, const ExpressionParser& parser, bool user_inp) {
-  _event_queue = event;
+bool User::HandleEvent(const std::string& event, bool user_inp) {
   util::Logger()->info("User::HandleEvent ({}): {}", _id, event);
-  while (_event_queue != "") {
-    _event_queue = util::ReplaceAll(_event_queue, txtad::UID_REPLACEMENT, _id);
-    _context_stack.TakeEvents(_event_queue, parser, user_inp);
-    user_inp = false;
+  if (_chain._depth++ == 0) 
+    _chain = {1, 0, std::chrono::steady_clock::now(), {}, false};
+  // Set aside pending events of an outer call (moved, not copied)
+  EventQueue pending = std::exchange(_event_queue, EventQueue());
+  _event_queue.Push(util::ReplaceAll(event, txtad::UID_REPLACEMENT, _id), user_inp);
+  while (!_chain._aborted) {
+    auto cur = _event_queue.Pop();
+    if (!cur)
+      break;
+    _chain._recent.push_back(cur->_event);
+    if (_chain._recent.size() > RECENT_EVENTS)
+      _chain._recent.pop_front();
+    _context_stack.TakeEvent(*cur, _parser, this);
+
+    // Check budget (only matters, if chain is not done anyway)
+    ++_chain._events;
+    if (_event_queue.empty())
+      continue;
+    if (_chain._events >= _event_budget._max_events) 
+      AbortEventChain(fmt::format("more than {} events", _event_budget._max_events));
+    else if (_event_queue.size() > _event_budget._max_queue_length) 
+      AbortEventChain(fmt::format("more than {} events pending", _event_budget._max_queue_length));
+    else if (std::chrono::steady_clock::now() - _chain._start 
+        > std::chrono::milliseconds(_event_budget._max_time_ms))
+      AbortEventChain(fmt::format("took more than {}ms", _event_budget._max_time_ms));
   }
+  _event_queue = std::move(pending);
+  // Aborted: drop events of outer calls, too
+  if (_chain._aborted)
+    _event_queue.clear();
+  _chain._depth--;
+  return !_chain._aborted;
+}
+
+void User::AbortEventChain(const std::string& reason) {
+  _chain._aborted = true;
+  _event_queue.clear();
+  util::Logger()->error("User::HandleEvent({}): event chain aborted, {} ({})", _id, reason, 
+      DescribeRecentEvents(_chain._recent));
+  if (_cout)
+    _cout("Too much is happening at once: the last action was stopped (" + reason + ").");
 }
 
 void User::AddToEventQueue(std::string events) {
-  if (_event_queue != "") 
-    _event_queue += ";";
-  _event_queue += events;
+  _event_queue.Push(util::ReplaceAll(events, txtad::UID_REPLACEMENT, _id));
 }
 
 void User::LinkContextToStack(std::shared_ptr<Context> ctx) {
@@ -180,23 +274,129 @@ void User::RemoveContext(const std::string& ctx_id) {
   }
 }
 
+void User::NotReusable(const std::string& reason) {
+  if (_prototype && _reusable) {
+    util::Logger()->info("User::NotReusable({}). Prototype not reusable: {}", _id, reason);
+    _reusable = false;
+  }
+}
+
+bool User::StateContains(const std::string& str) const {
+  for (const auto& it : _own_contexts) {
+    const auto& ctx = _contexts.at(it);
+    if (ctx->name().find(str) != std::string::npos)
+      return true;
+    for (const auto& [key, value] : ctx->attributes()) {
+      if (value.find(str) != std::string::npos)
+        return true;
+    }
+  }
+  return false;
+}
+
+std::shared_ptr<Context> User::MutableContext(const std::shared_ptr<Context>& ctx) {
+  if (ctx->shared() && _prototype) {
+    // Prototype must not change game-wide state: modify a detached copy
+    NotReusable("modifies shared context " + ctx->id());
+    return std::make_shared<Context>(*ctx);
+  }
+  if (ctx->shared() || _own_contexts.contains(ctx->id()))
+    return ctx;
+  if (util::get_ptr(_contexts, ctx->id()) != ctx) {
+    util::Logger()->warn("User::MutableContext({}). Context {} is not the user's.", _id, ctx->id());
+    return ctx;
+  }
+  util::Logger()->debug("User::MutableContext({}). Copying context {}", _id, ctx->id());
+  auto copy = std::make_shared<Context>(*ctx);
+  _contexts[copy->id()] = copy;
+  _own_contexts.insert(copy->id());
+  _context_stack.replace(copy);
+  _contexts_version->fetch_add(1, std::memory_order_release);
+  return copy;
+}
+
+std::shared_ptr<Text> User::MutableText(const std::string& txt_id) {
+  auto txt = util::get_ptr(_texts, txt_id);
+  if (txt && txt->shared() && _prototype) {
+    NotReusable("modifies shared text " + txt_id);
+    return std::make_shared<Text>(*txt);
+  }
+  if (!txt || txt->shared() || _own_texts.contains(txt_id))
+    return txt;
+  util::Logger()->debug("User::MutableText({}). Copying text {}", _id, txt_id);
+  txt = std::make_shared<Text>(*txt);
+  _texts[txt_id] = txt;
+  _own_texts.insert(txt_id);
+  return txt;
+}
+
+void User::MigrateState(User& old_user, const std::map<std::string, std::shared_ptr<Context>>& old_contexts) {
+  // Non-shared contexts and texts modified by old user (shared ones are migrated by the game)
+  for (const auto& key : old_user._own_contexts) {
+    auto ctx = util::get_ptr(_contexts, key);
+    if (ctx && !ctx->shared()) 
+      MutableContext(ctx)->MigrateState(*old_user._contexts.at(key), util::get_ptr(old_contexts, key).get());
+  }
+  for (const auto& key : old_user._own_texts) {
+    auto txt = util::get_ptr(_texts, key);
+    if (txt && !txt->shared()) 
+      MutableText(key)->MigrateState(*old_user._texts.at(key));
+  }
+
+  // Replace initial contexts with the contexts linked for the old user
+  for (const auto& it : _context_stack.GetOrder()) {
+    if (_contexts.count(it) > 0)
+      _context_stack.erase(it);
+  }
+  for (const auto& it : old_user._context_stack.GetOrder()) {
+    if (_contexts.count(it) > 0)
+      LinkContextToStack(_contexts.at(it));
+    else if (!_context_stack.exists(it))
+      util::Logger()->warn("User::MigrateState({}). Context {} no longer exists", _id, it);
+  }
+}
+
 std::string User::PrintTxt(std::string txt_id, const ExpressionParser& parser) {
-  if (_texts.count(txt_id) > 0)
-    return util::Join(_texts.at(txt_id)->print(_event_queue, parser), txtad::WEB_CMD_ADD_PROMPT);
+  if (auto txt = util::get_ptr(_texts, txt_id)) {
+    // Printing consumes one-time events
+    if (txt->one_time_events() != "")
+      txt = MutableText(txt_id);
+    std::string events = "";
+    auto printed = util::Join(txt->print(events, parser), txtad::WEB_CMD_ADD_PROMPT);
+    AddToEventQueue(events);
+    return printed;
+  }
   util::Logger()->warn("User::PrintText. Text {} not found", txt_id);
+  return "";
 }
 
 std::string User::PrintCtx(std::string ctx_id, std::string what, const ExpressionParser& parser) {
   util::Logger()->debug("User::PrintCtx. printing \"{}\"...", ctx_id);
+  return PrintCtx(Select(ctx_id), what, parser);
+}
+
+std::string User::PrintCtx(const ContextSelector& selector, const std::string& what, 
+    const ExpressionParser& parser) {
   std::string txt;
-  for (const auto& ctx : GetContext(ctx_id, parser)) {
-    User::AddVariableToText(ctx, what, txt, _event_queue, parser);
+  // Descriptions are not tracked (and printing them throws events)
+  if (what == "desc" || what == "description")
+    parser.NotMemoizable();
+  for (auto ctx : GetContext(selector, parser)) {
+    // Printing description consumes its one-time events
+    if ((what == "desc" || what == "description") && ctx->description()->one_time_events() != "")
+      ctx = MutableContext(ctx);
+    AddVariableToText(ctx, what, txt, parser);
   }
   return txt;
 }
 
 std::string User::PrintCtxAttribute(std::string ctx_id, std::string attribute, const ExpressionParser& parser) {
   util::Logger()->debug("User::PrintCtxAttribute. printing \"{}.{}\".", ctx_id, attribute);
+  return PrintCtxAttribute(Select(ctx_id), attribute, parser);
+}
+
+std::string User::PrintCtxAttribute(const ContextSelector& selector, const std::string& attribute, 
+    const ExpressionParser& parser) {
   std::string txt;
 
   auto add_to_txt = [&txt, &attribute](const std::shared_ptr<Context>& ctx) {
@@ -207,7 +407,7 @@ std::string User::PrintCtxAttribute(std::string ctx_id, std::string attribute, c
   };
 
   int counter = 0;
-  for (const auto& ctx : GetContext(ctx_id, parser)) {
+  for (const auto& ctx : GetContext(selector, parser)) {
     if (counter++ > 0) {
       txt += ";";
     }
@@ -217,7 +417,7 @@ std::string User::PrintCtxAttribute(std::string ctx_id, std::string attribute, c
 }
 
 void User::AddVariableToText(const std::shared_ptr<Context>& ctx, const std::string& what, 
-    std::string& txt, std::string& event_queue, const ExpressionParser& parser) {
+    std::string& txt, const ExpressionParser& parser) {
   util::Logger()->debug("User::AddVariableToText: {}, {}", ctx->id(), what);
   if (what == "id") {
     txt += ((txt.length() > 0) ? ", " : "") + ctx->id();
@@ -226,7 +426,9 @@ void User::AddVariableToText(const std::shared_ptr<Context>& ctx, const std::str
     txt += ((txt.length() > 0) ? ", " : "") + ctx->name();
   // Print ctx description
   } else if (what == "desc" || what == "description") {
-    txt += ((txt.length() > 0) ? ", " : "") + ctx->PrintDescription(event_queue, parser);
+    std::string events = "";
+    txt += ((txt.length() > 0) ? ", " : "") + ctx->PrintDescription(events, parser);
+    AddToEventQueue(events);
   // Print ctx attributes (or all attributes)
   } else if (what == "attributes" || what == "all_attributes") {
     std::vector<std::string> hidden;
@@ -247,8 +449,9 @@ void User::AddVariableToText(const std::shared_ptr<Context>& ctx, const std::str
     if (auto print_ctx = pattern::member_access(what)) {
       for (const auto& it : ctx->LinkedContexts(print_ctx->ctx_id.substr(1))) {
         if (auto linked_ctx = it.lock()) {
+          parser.DependsOn(Context::VersionOf(linked_ctx));
           if (print_ctx->member_type == pattern::CtxMemberAccess::VARIABLE) {
-            User::AddVariableToText(linked_ctx, print_ctx->key, txt, event_queue, parser);
+            AddVariableToText(linked_ctx, print_ctx->key, txt, parser);
           }
           else if (print_ctx->member_type == pattern::CtxMemberAccess::ATTRIBUTE) {
             if (auto attr = linked_ctx->GetAttribute(print_ctx->key))
@@ -260,10 +463,7 @@ void User::AddVariableToText(const std::shared_ptr<Context>& ctx, const std::str
   }
 }
 
-std::vector<std::shared_ptr<Context>> User::GetContext(const std::string& ctx_id, 
-    const ExpressionParser& parser) {
-  std::vector<std::shared_ptr<Context>> ctxs;
-
+User::ContextSelector User::Select(const std::string& ctx_id) {
   auto pos = ctx_id.find("[");
   std::string id = ctx_id;
   std::string query = "";
@@ -271,41 +471,79 @@ std::vector<std::shared_ptr<Context>> User::GetContext(const std::string& ctx_id
     id = ctx_id.substr(0, pos);
     query = ctx_id.substr(pos+1, ctx_id.length()-(pos+1)-1);
   }
-  util::Logger()->debug("GetContext id: {}, query: {}", id, query);
+  util::Logger()->debug("User::Select. id: {}, query: {}", id, query);
 
+  ContextSelector selector;
   if (id.starts_with("**")) {
-    for (const auto& it : _contexts) {
-      if (it.first.find(id.substr(2)) == 0) {
-        ctxs.push_back(it.second);
-      }
-    }
-  } else if (id.front() == '*') {
-    ctxs = _context_stack.find(id.substr(1));
-  } else if (_contexts.count(id) > 0) {
-    ctxs = {_contexts.at(id)};
+    selector._kind = ContextSelector::ALL;
+    selector._id = id.substr(2);
+  } else if (id.starts_with("*")) {
+    selector._kind = ContextSelector::LINKED;
+    selector._id = id.substr(1);
   } else {
-    util::Logger()->warn("User::GetContext. Context \"{}\" not found.", id);
+    selector._id = id;
   }
 
-  bool chose_random = false;
   if (query == txtad::RAN_ELEM) {
-    chose_random = true;
+    selector._random = true;
   } else if (query != "") {
-    util::Logger()->debug("User::GetContext. Fitering {} ctx with query: {}", ctxs.size(), query);
-    std::vector<std::shared_ptr<Context>> filtered_ctxs;
-
     // remove random qualifier
     auto pos = query.find(", " + txtad::RAN_ELEM);
     if (pos != std::string::npos) {
       query = query.substr(0, pos);
-      chose_random = true;
-      util::Logger()->debug("User::GetContext. reduced query {}", query);
+      selector._random = true;
     }
+    // split once at the (still unknown) context-id of relative members
+    selector._query = SplitQuery(ParenthesizeQueryClauses(query));
+  }
+  return selector;
+}
+
+std::vector<std::shared_ptr<Context>> User::GetContext(const std::string& ctx_id, 
+    const ExpressionParser& parser) {
+  return GetContext(Select(ctx_id), parser);
+}
+
+std::vector<std::shared_ptr<Context>> User::GetContext(const ContextSelector& selector, 
+    const ExpressionParser& parser) {
+  std::vector<std::shared_ptr<Context>> ctxs;
+
+  // Conditions using the result are valid until the candidates change
+  if (selector._kind == ContextSelector::LINKED)
+    parser.DependsOn(_context_stack.members_version());
+  else 
+    parser.DependsOn(_contexts_version);
+
+  if (selector._kind == ContextSelector::ALL) {
+    for (const auto& it : _contexts) {
+      if (it.first.find(selector._id) == 0) {
+        ctxs.push_back(it.second);
+      }
+    }
+  } else if (selector._kind == ContextSelector::LINKED) {
+    ctxs = _context_stack.find(selector._id);
+  } else if (auto ctx = util::get_ptr(_contexts, selector._id)) {
+    ctxs = {ctx};
+  } else {
+    util::Logger()->warn("User::GetContext. Context \"{}\" not found.", selector._id);
+  }
+
+  for (const auto& ctx : ctxs) 
+    parser.DependsOn(Context::VersionOf(ctx));
+
+  if (selector._query) {
+    util::Logger()->debug("User::GetContext. Fitering {} ctx with query", ctxs.size());
+    std::vector<std::shared_ptr<Context>> filtered_ctxs;
 
     // filter contexts not matching query
+    const auto& parts = *selector._query;
     for (const auto& ctx : ctxs) {
-      const std::string expanded_query = ExpandQuery(query, ctx->id());
-      if (!expanded_query.empty() && parser.Evaluate(expanded_query) == "1") {
+      if (parts.empty())
+        break;
+      std::string expanded_query = parts.front();
+      for (size_t i = 1; i < parts.size(); i++) 
+        expanded_query += ctx->id() + parts[i];
+      if (parser.Evaluate(expanded_query) == "1") {
         filtered_ctxs.push_back(ctx);
       }
     }
@@ -315,8 +553,10 @@ std::vector<std::shared_ptr<Context>> User::GetContext(const std::string& ctx_id
   }
 
   // Check if choose-random was selected
-  if (chose_random) {
+  if (selector._random) {
     util::Logger()->debug("User::GetContext. returning random from {} ctxs.", ctxs.size());
+    NotReusable("random context");
+    parser.NotMemoizable();
     int ran = util::ran(0, ctxs.size());
     return {ctxs.at(ran)};
   }
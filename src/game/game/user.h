@@ -3,36 +3,121 @@
 
 #include "game/utils/defines.h"
 #include "shared/objects/context/context.h"
+#include "shared/objects/settings/settings.h"
 #include "shared/objects/text/text.h"
 #include "shared/utils/eventmanager/context_stack.h"
+#include "shared/utils/eventmanager/event_queue.h"
 #include "shared/utils/parser/expression_parser.h"
 #include "shared/utils/parser/pattern_parser.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <optional>
+#include <set>
 #include <string>
 #include <vector>
 
 class User {
   public: 
+    /**
+     * Parsed context reference: "id", "*part-of-id" (linked contexts) or
+     * "**prefix-of-id" (all contexts), optionally filtered by "[query]" (see
+     * GetContext).
+     */
+    struct ContextSelector {
+      enum Kind { ID, LINKED, ALL } _kind = ID;
+      std::string _id;  ///< id, part of id (linked) or prefix of id (all)
+      /**
+       * Query split at the context-id of its relative members, joined with
+       * the id of each candidate (nullopt: not filtered, empty: invalid query
+       * matching no context).
+       */
+      std::optional<std::vector<std::string>> _query;
+      bool _random = false;  ///< choose one of the matching contexts
+    };
+
     User(const std::string& game_id, const std::string& id, const txtad::MsgFn& cout,
         const std::map<std::string, std::shared_ptr<Context>>& contexts, 
         const std::map<std::string, std::shared_ptr<Text>>& text, 
         const std::vector<std::string>& initial_contexts);
 
+    /**
+     * Clones user (f.e. a prototype after initial events). Modified contexts and
+     * texts are copied, all others still reference the game's prototypes.
+     */
+    User(const User& prototype, const std::string& id, const txtad::MsgFn& cout);
+
     // getter 
     const std::string& id() const;
     const std::map<std::string, std::shared_ptr<Context>>& contexts();
     const std::map<std::string, std::shared_ptr<Text>>& texts();
-    std::string& event_queue();
+    const EventQueue& event_queue() const;
     const ContextStack& context_stack() const;
+    const ExpressionParser& parser() const;
+    std::mutex& mutex();
+    bool prototype() const;
+    bool reusable() const;  ///< prototype only: state does not depend on the run (see set_prototype)
+
+    // setter 
+    /**
+     * Sets the user's own parser (substitutes are resolved for this user).
+     */
+    void set_parser(ExpressionParser parser);
+    void set_id(const std::string& id, const txtad::MsgFn& cout);  ///< f.e. when taking a pre-built user
+    void set_event_budget(const txtad::EventBudget& budget);
+
+    /**
+     * Marks user as prototype, from which new users are cloned. Changes
+     * affecting others (shared contexts and texts) are discarded and, as
+     * random choices, mark the prototype as not reusable.
+     */
+    void set_prototype(bool prototype);
 
     // methods 
-    void HandleEvent(const std::string& event, const ExpressionParser& parser, bool user_inp=false);
+
+    /**
+     * Handles event and all events caused by it. If called while handling
+     * events (f.e. by exec-listeners), pending events are continued afterwards
+     * and the event budget is shared with the outer call.
+     * @return false if the chain was aborted for exceeding the event budget
+     * (reported to user and logged for the author).
+     */
+    bool HandleEvent(const std::string& event, bool user_inp=false);
 
     /**
      * Accepts *<type> syntax, but expects the result to be a single context.
      */
     std::vector<std::shared_ptr<Context>> GetContext(const std::string& ctx_id, const ExpressionParser& parser);
+    std::vector<std::shared_ptr<Context>> GetContext(const ContextSelector& selector, const ExpressionParser& parser);
+
+    /**
+     * Copy-on-write: non-shared contexts reference the game's prototype until
+     * first modified. Returns the user's own copy of ctx (copied on first call
+     * and replaced in context stack), or ctx itself if shared.
+     */
+    std::shared_ptr<Context> MutableContext(const std::shared_ptr<Context>& ctx);
+
+    /**
+     * Copy-on-write for non-shared texts (see MutableContext).
+     */
+    std::shared_ptr<Text> MutableText(const std::string& txt_id);
+
+    /**
+     * Marks prototype as not reusable (no-op for normal users).
+     */
+    void NotReusable(const std::string& reason);
+
+    /**
+     * Whether str occurs in the user's own state (names and attributes of
+     * modified contexts).
+     */
+    bool StateContains(const std::string& str) const;
+
+    /** Parses reference once, f.e. "*room[.visited = 1, #ran]" (see GetContext). */
+    static ContextSelector Select(const std::string& ctx_id);
 
     // Actions
     void AddToEventQueue(std::string events);
@@ -40,22 +125,63 @@ class User {
     void RemoveContext(const std::string& ctx_id);
     std::string PrintTxt(std::string id, const ExpressionParser& parser);
     std::string PrintCtx(std::string id, std::string what, const ExpressionParser& parser);
+    std::string PrintCtx(const ContextSelector& selector, const std::string& what, const ExpressionParser& parser);
     std::string PrintCtxAttribute(std::string id, std::string what, const ExpressionParser& parser);
+    std::string PrintCtxAttribute(const ContextSelector& selector, const std::string& what, 
+        const ExpressionParser& parser);
+
+    /**
+     * Takes over the state of the same user of a previous game definition:
+     * context stack (by id) and runtime changes of non-shared contexts and texts
+     * (only those the old user modified, i.e. owns a copy of).
+     * @param[in] old_user
+     * @param[in] old_contexts (definitions of previous game, to detect runtime changes)
+     */
+    void MigrateState(User& old_user, const std::map<std::string, std::shared_ptr<Context>>& old_contexts);
 
     // helpers 
-    static void AddVariableToText(const std::shared_ptr<Context>& ctx, const std::string& what, 
-        std::string& txt, std::string& event_queue, const ExpressionParser& parser);
+
+    /**
+     * Adds ctx's id/name/description/attributes to txt (events thrown by
+     * printing are added to event queue).
+     */
+    void AddVariableToText(const std::shared_ptr<Context>& ctx, const std::string& what, 
+        std::string& txt, const ExpressionParser& parser);
 
   private: 
     const std::string _game_id;
-    const std::string _id;
-    const txtad::MsgFn _cout;
+    std::string _id;
+    txtad::MsgFn _cout;
     std::map<std::string, std::shared_ptr<Context>> _contexts;
     std::map<std::string, std::shared_ptr<Text>> _texts;
+    std::set<std::string> _own_contexts;  ///< non-shared contexts already copied from prototype
+    std::set<std::string> _own_texts;  ///< non-shared texts already copied from prototype
+    /** Increases when a context is replaced by the user's own copy (see MutableContext). */
+    std::shared_ptr<std::atomic<uint64_t>> _contexts_version = std::make_shared<std::atomic<uint64_t>>(0);
 
     ContextStack _context_stack;
-    std::string _event_queue;
+    EventQueue _event_queue;
     bool _event_handled;
+
+    /**
+     * State of the event chain currently handled (see HandleEvent)
+     */
+    struct EventChain {
+      size_t _depth = 0;  ///< nested calls of HandleEvent
+      size_t _events = 0;
+      std::chrono::steady_clock::time_point _start;
+      std::deque<std::string> _recent;  ///< last events (reported if aborted)
+      bool _aborted = false;
+    };
+    txtad::EventBudget _event_budget;
+    EventChain _chain;
+
+    ExpressionParser _parser;
+    bool _prototype;
+    bool _reusable;
+    std::mutex _mutex;  ///< Held while handling an event chain for this user
+
+    void AbortEventChain(const std::string& reason);
 };
 
 #endif
@@ -1,4 +1,5 @@
 #include "game/game/game.h"
+#include "game/game/game_registry.h"
 #include "game/server/websocket_server.h"
 #include "game/utils/defines.h"
 #include "shared/utils/parser/game_file_parser.h"
@@ -8,7 +9,6 @@
 #include <memory>
 #include <mutex>
 #include <nlohmann/json_fwd.hpp>
-#include <shared_mutex>
 #include <spdlog/spdlog.h>
 #include <string>
 #include <thread>
@@ -21,88 +21,120 @@ int main() {
 
   util::SetUpLogger(txtad::LoggerPath(), txtad::LOGGER, spdlog::level::debug);
   util::LoggerContext scope(txtad::LOGGER);
+  spdlog::set_default_logger(spdlog::get(txtad::LOGGER)); // used by threads without logger-context
 
   // Create web socket server 
   std::shared_ptr<WebsocketServer> wss = std::make_shared<WebsocketServer>();
 
-  Game::set_global_msg_fn([&wss](const std::string& id, const std::string& msg) {
+  Game::MsgFn send_msg = [&wss](const std::string& id, const std::string& msg) {
     util::Logger()->debug("MAIN: SendMessage: {}, {}", id, msg);
     try {
       wss->SendMessage(id, msg);
     } catch(std::exception& e) {
       util::Logger()->error("MAIN: SendMessage failed: {}", e.what());
     }
-  });
+  };
 
   // Create games
-  auto games = parser::InitGames<Game>(txtad::GamesPath());
-  for (auto& [_, game]: games) {
+  auto initial_games = parser::InitGames<Game>(txtad::GamesPath(), send_msg);
+  for (auto& [_, game]: initial_games) {
     game->set_running(true);
   }
+  GameRegistry games(initial_games);
 
-  std::shared_mutex mtx;
-
-  WebsocketServer::set_handle_event([&games, &mtx](const std::string& id, const std::string& game, const std::string& event) {
-    util::Logger()->debug("MAIN: Handling: {}, {}", game, event);
-    std::shared_lock sl(mtx);
-    if (games.contains(game) > 0) {
-      try {
-        games.at(game)->HandleEvent(id, event);
-      } catch(std::exception& e) {
-        util::Logger()->error("MAIN: Handling: {}, {} failed: {}", game, event, e.what());
-      }
+  wss->set_handle_event([&games](const std::string& id, const std::string& game_id, 
+        const std::string& event, WebsocketServer::DoneFn done) {
+    util::Logger()->debug("MAIN: Handling: {}, {}", game_id, event);
+    if (auto game = games.get(game_id)) {
+      // Only enqueue: the game's executor handles the event on its own thread.
+      game->Post(id, event, done);
     }
   });
 
-  std::thread thread_http([&games, &mtx]() {
+  std::thread thread_http([&games, &send_msg]() {
     httplib::Server http_server;
-    for (const auto& game : games) {
+    for (const auto& game : *games.snapshot()) {
       http_server.set_mount_point("/" + game.second->name(), game.second->path() + "/" + txtad::HTML_PATH);
       http_server.set_mount_point("/" + game.second->name(), txtad::FILES_PATH + "/" + txtad::HTML_PATH);
       http_server.set_mount_point("/" + game.second->name(), txtad::GamesPath() + game.second->name());
     }
 
     http_server.Get("/api/games/running", [&](const httplib::Request& req, httplib::Response& resp) {
-        std::shared_lock sl(mtx);
         std::map<std::string, bool> game_info;
-        for (const auto& [id, game] : games) {
+        for (const auto& [id, game] : *games.snapshot()) {
           game_info[id] = game->running();
         }
         resp.status = 200;
         resp.set_content(nlohmann::json(game_info).dump(), "application/json");
     });
 
+    http_server.Get("/api/games/stats", [&](const httplib::Request& req, httplib::Response& resp) {
+        nlohmann::json game_stats = nlohmann::json::object();
+        for (const auto& [id, game] : *games.snapshot()) {
+          const auto stats = game->executor_stats();
+          const auto user_stats = game->user_stats();
+          game_stats[id] = {{"queue_depth", stats._queue_depth}, {"max_queue_depth", stats._max_queue_depth}, 
+            {"handled", stats._handled}, {"total_service_us", stats._total_service_us}, 
+            {"max_service_us", stats._max_service_us}, 
+            {"avg_service_us", (stats._handled > 0) ? stats._total_service_us / (int64_t)stats._handled : 0},
+            {"users_cloned", user_stats._cloned}, {"users_initialized", user_stats._initialized}, 
+            {"users_pooled", user_stats._pooled}, {"aborted_chains", game->aborted_chains()}};
+        }
+        resp.status = 200;
+        resp.set_content(game_stats.dump(), "application/json");
+    });
+
+    http_server.Get("/api/events/stats", [&](const httplib::Request& req, httplib::Response& resp) {
+        const auto stats = ExpressionParser::memo_stats();
+        const auto resolution_stats = ContextStack::resolution_stats();
+        const auto substitution_stats = ExpressionParser::substitution_stats();
+        const auto condition_stats = ExpressionParser::condition_stats();
+        const size_t resolved = resolution_stats._hits + resolution_stats._misses;
+        nlohmann::json event_stats = {{"logic_evaluations", stats._evaluations}, 
+          {"logic_evaluations_saved", stats._saved}, {"compiled_expressions", ExpressionParser::compiled()},
+          {"substitutions_resolved", substitution_stats._resolved}, 
+          {"substitutions_skipped", substitution_stats._skipped},
+          {"condition_hits", condition_stats._hits}, {"condition_misses", condition_stats._misses},
+          {"resolution_hits", resolution_stats._hits}, {"resolution_misses", resolution_stats._misses}, 
+          {"resolution_hit_rate", (resolved > 0) ? (double)resolution_stats._hits / resolved : 0.0}};
+        resp.status = 200;
+        resp.set_content(event_stats.dump(), "application/json");
+    });
+
     http_server.Get("/api/game/reload/:game_id", [&](const httplib::Request& req, httplib::Response& resp) {
-        std::unique_lock sl(mtx);
         std::string game_id = req.path_params.at("game_id");
         std::string game_path = txtad::GamesPath() + game_id;
-        if (std::filesystem::is_directory(game_path)) {
-          games.erase(game_id);
-          games[game_id] = std::make_shared<Game>(game_path, game_id);
-          games[game_id]->set_running(true);
-          resp.status = 200;
+        // Hot-swap running game, keeping users' state (unless `mode=restart`)
+        auto running_game = games.get(game_id);
+        if (running_game && req.get_param_value("mode") != "restart") {
+          resp.status = (running_game->HotReload()) ? 200 : 500;
+        } else if (std::filesystem::is_directory(game_path)) {
+          // Build new game without holding any lock, then publish it with one swap.
+          try {
+            auto game = std::make_shared<Game>(game_path, game_id, send_msg);
+            game->set_running(true);
+            games.Publish(game_id, game);
+            resp.status = 200;
+          } catch (std::exception& e) {
+            util::Logger()->error("MAIN: Reloading game {} failed: {}", game_id, e.what());
+            resp.status = 500;
+          }
         } else {
           resp.status = 400;
         }
     });
 
     http_server.Get("/api/game/stop/:game_id", [&](const httplib::Request& req, httplib::Response& resp) {
-        std::unique_lock sl(mtx);
         std::string game_id = req.path_params.at("game_id");
-        if (games.contains(game_id)) {
-          games.erase(game_id);
-          resp.status = 200;
-        } else {
-          resp.status = 400;
-        }
+        resp.status = (games.Remove(game_id)) ? 200 : 400;
     });
 
     util::Logger()->info("MAIN: Successfully started http-server on port 4080");
     http_server.listen("0.0.0.0", 4080);
   });
 
-  std::thread thread_wss([&games, &wss]() {
-    wss->Start(4181);
+  std::thread thread_wss([&wss]() {
+    wss->Start(4181, txtad::WssThreads());
   });
 
   thread_http.join();
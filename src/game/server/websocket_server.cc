@@ -14,9 +14,7 @@ using websocketpp::lib::placeholders::_2;
 using websocketpp::lib::bind;
 
 
-WebsocketServer::EventHandlerFn WebsocketServer::_handle_event = nullptr;
-
-WebsocketServer::WebsocketServer() {}
+WebsocketServer::WebsocketServer() : _handle_event(nullptr) {}
 
 WebsocketServer::~WebsocketServer() {
   _server.stop();
@@ -27,7 +25,7 @@ void WebsocketServer::set_handle_event(EventHandlerFn fn) {
 }
 
 
-void WebsocketServer::Start(int port) {
+void WebsocketServer::Start(int port, size_t threads) {
   try { 
     util::Logger()->debug("WSS::Start: set_access_channels");
     _server.set_access_channels(websocketpp::log::alevel::none);
@@ -39,8 +37,19 @@ void WebsocketServer::Start(int port) {
     _server.set_reuse_addr(true);
     _server.listen(port); 
     _server.start_accept(); 
-    util::Logger()->info("WSS::Start: Successfully started websocket server on port: {}", port);
-    _server.run(); 
+    util::Logger()->info("WSS::Start: Successfully started websocket server on port: {} ({} threads)", port, 
+        threads);
+    std::vector<std::thread> workers;
+    for (size_t i=1; i<threads; i++) {
+      workers.emplace_back([this, logger = util::LOGGER]() {
+        util::LoggerContext scope(logger);
+        Run();
+      });
+    }
+    Run(); 
+    for (auto& it : workers) {
+      it.join();
+    }
   } catch (websocketpp::exception const& e) {
     util::Logger()->error("WSS::Start: websocketpp::exception: {}", e.what());
   } catch (std::exception& e) {
@@ -48,6 +57,16 @@ void WebsocketServer::Start(int port) {
   }
 }
 
+void WebsocketServer::Run() {
+  try { 
+    _server.run(); 
+  } catch (websocketpp::exception const& e) {
+    util::Logger()->error("WSS::Run: websocketpp::exception: {}", e.what());
+  } catch (std::exception& e) {
+    util::Logger()->error("WSS::Run: std::exception: {}", e.what());
+  }
+}
+
 void WebsocketServer::OnOpen(websocketpp::connection_hdl hdl) {
   std::unique_lock ul_connections(_mutex);
   const std::string user_id = ConnectionIDToString(hdl.lock().get());
@@ -63,17 +82,16 @@ void WebsocketServer::OnClose(websocketpp::connection_hdl hdl) {
   const std::string user_id = ConnectionIDToString(hdl.lock().get());
   if (_connections.count(user_id) > 0) {
     try {
-      // Send remove user command to game
-      const auto& game_id = _user_game_mapping.at(user_id);
-      ul_connections.unlock();
-      _handle_event(user_id, game_id, txtad::REMOVE_USER + " " + user_id);
-      ul_connections.lock();
-      // Delete connection.
+      // Delete connection and user-game-mapping.
+      const std::string game_id = _user_game_mapping.at(user_id);
+      _user_game_mapping.erase(user_id);
       if (_connections.size() > 1)
         _connections.erase(user_id);
       else 
         _connections.clear();
       ul_connections.unlock();
+      // Send remove user command to game
+      _handle_event(user_id, game_id, txtad::REMOVE_USER + " " + user_id, nullptr);
       util::Logger()->debug("WSS::OnClose: Connection closed successfully.");
     } catch (std::exception& e) {
       util::Logger()->error("WSS::OnClose: Failed to close connection: {}", e.what());
@@ -90,12 +108,16 @@ void WebsocketServer::OnMessage(t_server* srv, websocketpp::connection_hdl hdl,
     nlohmann::json json = nlohmann::json::parse(msg->get_payload());
     if (json.contains("game") && json.contains("event")) {
       const auto& user_id = ConnectionIDToString(hdl.lock().get());
-      const auto& game_id = json["game"];
+      const std::string game_id = json["game"];
       // if no entry exists, add new entry to user-game-mapping
-      if (_user_game_mapping.count(user_id) == 0)
-        _user_game_mapping[user_id] = game_id;
-      _handle_event(user_id, game_id, json["event"]);
-      SendMessage(user_id, txtad::WEB_CMD_CALL_DONE);
+      {
+        std::unique_lock ul_connections(_mutex);
+        _user_game_mapping.try_emplace(user_id, game_id);
+      }
+      // Only enqueues event: call-done is sent once the game handled it.
+      _handle_event(user_id, game_id, json["event"], [this, user_id]() {
+        SendMessage(user_id, txtad::WEB_CMD_CALL_DONE);
+      });
     } else {
       util::Logger()->warn("WSS::OnMessage: Missing \"game\" or \"event\"");
     }
@@ -11,12 +11,16 @@
 #include <memory>
 #include <shared_mutex>
 #include <string>
+#include <thread>
+#include <vector>
 #include <websocketpp/config/asio_no_tls.hpp>
 #include <websocketpp/server.hpp>
 
 class WebsocketServer {
   public:
-    using EventHandlerFn = std::function<void(std::string, std::string, std::string)>;
+    using DoneFn = std::function<void()>;
+    /** Handles (or enqueues) event of user for game; `done` is called once handled. */
+    using EventHandlerFn = std::function<void(std::string, std::string, std::string, DoneFn)>;
      ///< Connection_id-typedef.
     typedef decltype(websocketpp::lib::weak_ptr<void>().lock().get()) t_connection_id;
 
@@ -35,13 +39,16 @@ class WebsocketServer {
     ~WebsocketServer();
 
     // setter 
-    static void set_handle_event(EventHandlerFn fn);
+    void set_handle_event(EventHandlerFn fn);  ///< must be set before `Start`
 
     /**
-     * Initializes and starts main loop. (THREAD)
+     * Initializes and starts main loop, run by `threads` threads. Handlers of
+     * one connection are serialized by websocketpp's per-connection strand.
+     * (THREAD)
      * @param[in] port 
+     * @param[in] threads
      */
-    void Start(int port);
+    void Start(int port, size_t threads=1);
 
     /**
      * Send payload to given user
@@ -55,15 +62,17 @@ class WebsocketServer {
     // typedefs:
     typedef websocketpp::server<websocketpp::config::asio> t_server;
     typedef t_server::message_ptr t_message_ptr;
+    static_assert(websocketpp::config::asio::enable_multithreading, 
+        "per-connection strands are required to run the server on multiple threads");
     
     // members:
 
     t_server _server;  ///< server object.
-    mutable std::shared_mutex _mutex;  ///< Mutex for connections_.
+    mutable std::shared_mutex _mutex;  ///< Mutex for _connections and _user_game_mapping.
     std::map<std::string, websocketpp::connection_hdl> _connections;  ///< Dictionary with all connections.
     std::map<std::string, std::string> _user_game_mapping;   ///< maps user-id to game (for `OnClose` access)
 
-    static EventHandlerFn _handle_event;
+    EventHandlerFn _handle_event;
 
     // methods:
     
@@ -90,6 +99,12 @@ class WebsocketServer {
      */
     void OnMessage(t_server* srv, websocketpp::connection_hdl hdl, t_message_ptr msg);
 
+    /**
+     * Runs the server's event loop on the calling thread, logging errors
+     * instead of letting them escape (f.e. terminating worker threads).
+     */
+    void Run();
+
     static const std::string ConnectionIDToString(t_connection_id connection_id);
 };
 
@@ -193,7 +193,7 @@ TEST_CASE("Test listener methods calling EventManager", "[objects][context]") {
   SECTION("TakeEvent with matching listeners returns true") {
     std::string event_handled = "";
     std::string argument_called = "";
-    auto fn = [&event_handled, &argument_called](std::string event,
+    auto fn = [&event_handled, &argument_called](User*, std::string event,
         std::string arguments) {
       event_handled = event;
       argument_called = arguments;
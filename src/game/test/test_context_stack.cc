@@ -79,21 +79,21 @@ TEST_CASE("Test throwing events", "[stack]") {
   std::map<std::string, std::shared_ptr<Context>> contexts;
   
   // define basic handlers
-  Listener::Fn set_attribute = [&attributes, &parser](std::string event, std::string args) {
+  Listener::Fn set_attribute = [&attributes, &parser](User*, std::string event, std::string args) {
     test::SetAttribute(attributes, args, parser);
   };
   
-  Listener::Fn add_ctx = [&contexts, &stack](std::string event, std::string ctx_id) {
+  Listener::Fn add_ctx = [&contexts, &stack](User*, std::string event, std::string ctx_id) {
     util::Logger()->info("Adding context: {}", ctx_id);
     if (contexts.count(ctx_id) > 0)
       stack.insert(contexts.at(ctx_id));
   };
-  Listener::Fn remove_ctx = [&contexts, &stack](std::string event, std::string ctx_id) {
+  Listener::Fn remove_ctx = [&contexts, &stack](User*, std::string event, std::string ctx_id) {
     util::Logger()->info("Removing context: {}", ctx_id);
     if (stack.exists(ctx_id))
       stack.erase(ctx_id);
   };
-  Listener::Fn replace_ctx = [&contexts, &stack](std::string event, std::string args) {
+  Listener::Fn replace_ctx = [&contexts, &stack](User*, std::string event, std::string args) {
     if (const auto& parsed = pattern::replace_ctx(args)) {
       util::Logger()->info("Replacing context: {} with {}", parsed->original_ctx, parsed->new_ctx);
       if (stack.exists(parsed->original_ctx))
@@ -103,11 +103,11 @@ TEST_CASE("Test throwing events", "[stack]") {
     }
   };
 
-  Listener::Fn cout = [&event_queue](std::string event, std::string args) {
+  Listener::Fn cout = [&event_queue](User*, std::string event, std::string args) {
     util::Logger()->info("PRINT: >>{}<<", args);
   };
 
-  Listener::Fn add_to_eventqueue = [&event_queue](std::string event, std::string args) {
+  Listener::Fn add_to_eventqueue = [&event_queue](User*, std::string event, std::string args) {
     event_queue += ((event_queue != "") ? ";" : "") + args;
   };
 
@@ -185,18 +185,18 @@ TEST_CASE("Test throwing events (with context-listener)", "[stack]") {
   std::map<std::string, std::shared_ptr<Context>> contexts;
   
   // difine basic handlers
-  Listener::Fn set_attribute = [&attributes, &parser](std::string event, std::string args) {
+  Listener::Fn set_attribute = [&attributes, &parser](User*, std::string event, std::string args) {
     test::SetAttribute(attributes, args, parser);
   };
   
-  Listener::Fn add_ctx = [&contexts, &stack](std::string event, std::string ctx_id) {
+  Listener::Fn add_ctx = [&contexts, &stack](User*, std::string event, std::string ctx_id) {
     util::Logger()->info("Adding context: {}", ctx_id);
     if (contexts.count(ctx_id) > 0)
       stack.insert(contexts.at(ctx_id));
     else 
       util::Logger()->error("[add_ctx] failed: ctx '{}' not found!", ctx_id);
   };
-  Listener::Fn remove_ctx = [&contexts, &stack](std::string event, std::string ctx_id) {
+  Listener::Fn remove_ctx = [&contexts, &stack](User*, std::string event, std::string ctx_id) {
     util::Logger()->info("Removing context: {}", ctx_id);
     if (ctx_id.front() == '*') {
       for (const auto& ctx : stack.find(ctx_id.substr(1))) 
@@ -207,20 +207,20 @@ TEST_CASE("Test throwing events (with context-listener)", "[stack]") {
     else 
       util::Logger()->error("[remove_ctx] failed: ctx '{}' not found!", ctx_id);
   };
-  Listener::Fn replace_ctx = [&contexts, &stack, &add_ctx, &remove_ctx](std::string event, std::string args) {
+  Listener::Fn replace_ctx = [&contexts, &stack, &add_ctx, &remove_ctx](User*, std::string event, std::string args) {
     if (const auto& parsed = pattern::replace_ctx(args)) {
       util::Logger()->info("Replacing context: {} with {}", parsed->original_ctx, parsed->new_ctx);
       // Get context to add: 
-      remove_ctx("", parsed->original_ctx);
-      add_ctx("", parsed->new_ctx);
+      remove_ctx(nullptr, "", parsed->original_ctx);
+      add_ctx(nullptr, "", parsed->new_ctx);
     }
   };
 
-  Listener::Fn cout = [&event_queue](std::string event, std::string args) {
+  Listener::Fn cout = [&event_queue](User*, std::string event, std::string args) {
     util::Logger()->info("PRINT: >>{}<<", args);
   };
 
-  Listener::Fn add_to_eventqueue = [&event_queue](std::string event, std::string args) {
+  Listener::Fn add_to_eventqueue = [&event_queue](User*, std::string event, std::string args) {
     event_queue += ((event_queue != "") ? ";" : "") + args;
   };
 
@@ -294,3 +294,251 @@ TEST_CASE("Test throwing events (with context-listener)", "[stack]") {
     REQUIRE(!stack.exists("rooms.mindfullness"));
   }
 }
+
+TEST_CASE("Test stack-wide listener index", "[stack]") {
+  ExpressionParser parser([](const std::string&) { return ""; });
+  std::vector<std::string> executed;
+  auto handler = [&executed](const std::string& id) {
+    return [&executed, id](User*, std::string, std::string) { executed.push_back(id); };
+  };
+  auto ids = [](const auto& candidates) {
+    std::vector<std::string> ids;
+    for (const auto& [ctx, listener] : candidates)
+      ids.push_back(ctx->id() + "/" + listener->id());
+    return ids;
+  };
+
+  ContextStack stack;
+  auto low = std::make_shared<Context>("low", 0);
+  low->AddListener(std::make_shared<LHandler>("A", "go (.*)", handler("low/A")));
+  low->AddListener(std::make_shared<LHandler>("B", "look", handler("low/B")));
+  auto high = std::make_shared<Context>("high", 5);
+  high->AddListener(std::make_shared<LHandler>("B", "go west", handler("high/B"), false));
+  high->AddListener(std::make_shared<LHandler>("A", "(.*)", handler("high/A")));
+  auto same = std::make_shared<Context>("same", 5);
+  same->AddListener(std::make_shared<LHandler>("A", "go (.*)", handler("same/A")));
+  REQUIRE(stack.insert(low));
+  REQUIRE(stack.insert(high));
+  REQUIRE(stack.insert(same));
+
+  SECTION("candidates ordered by contexts and listeners") {
+    REQUIRE(ids(stack.Candidates("go west")) == std::vector<std::string>{"high/A", "high/B", "same/A", "low/A"});
+    REQUIRE(ids(stack.Candidates("look")) == std::vector<std::string>{"high/A", "low/B"});
+    REQUIRE(ids(stack.Candidates("")) == std::vector<std::string>{"high/A"});
+  }
+
+  SECTION("permeable and non-permeable listeners and contexts") {
+    stack.TakeEvent("go west", parser);
+    // high/B is not permeable: stops context "high", but "high" is permeable 
+    REQUIRE(executed == std::vector<std::string>{"high/A", "high/B", "same/A", "low/A"});
+    executed.clear();
+    auto wall = std::make_shared<Context>("wall", 1, false);
+    wall->AddListener(std::make_shared<LHandler>("A", "go west", handler("wall/A")));
+    REQUIRE(stack.insert(wall));
+    stack.TakeEvent("go west", parser);
+    REQUIRE(executed == std::vector<std::string>{"high/A", "high/B", "same/A", "wall/A"});
+  }
+
+  SECTION("index updated on erase, replace and listener changes") {
+    REQUIRE(stack.erase("high"));
+    REQUIRE(ids(stack.Candidates("go west")) == std::vector<std::string>{"same/A", "low/A"});
+    low->AddListener(std::make_shared<LHandler>("C", "go west", handler("low/C")));
+    same->RemoveListener("A");
+    REQUIRE(ids(stack.Candidates("go west")) == std::vector<std::string>{"low/A", "low/C"});
+    auto low_copy = std::make_shared<Context>(*low);
+    low_copy->RemoveListener("A");
+    REQUIRE(stack.replace(low_copy));
+    REQUIRE(ids(stack.Candidates("go west")) == std::vector<std::string>{"low/C"});
+    REQUIRE(stack.insert(std::make_shared<Context>(*high)));
+    REQUIRE(ids(stack.Candidates("go west")) == std::vector<std::string>{"high/A", "high/B", "low/C"});
+  }
+
+  SECTION("contexts linked while handling event") {
+    auto later = std::make_shared<Context>("later", 3);
+    later->AddListener(std::make_shared<LHandler>("A", "go (.*)", handler("later/A")));
+    auto earlier = std::make_shared<Context>("earlier", 10);
+    earlier->AddListener(std::make_shared<LHandler>("A", "go (.*)", handler("earlier/A")));
+    same->AddListener(std::make_shared<LHandler>("Link", "go (.*)", [&](User*, std::string, std::string) { 
+        stack.insert(later);
+        stack.insert(earlier);
+      }));
+    stack.TakeEvent("go west", parser);
+    // Only contexts ordered after the one handling the event are reached
+    REQUIRE(executed == std::vector<std::string>{"high/A", "high/B", "same/A", "later/A", "low/A"});
+  }
+}
+
+TEST_CASE("Test same logic evaluated once per event", "[stack]") {
+  std::map<std::string, std::string> attributes = {{"potions", "1"}};
+  size_t substituted = 0;
+  ExpressionParser parser([&](const std::string& str) { 
+    substituted++;
+    return attributes.at(str); 
+  });
+  std::vector<std::string> forwarded;
+  LForwarder::set_overwite_fn([&forwarded](User*, std::string, std::string args) { 
+    forwarded.push_back(args); 
+  });
+
+  ContextStack stack;
+  for (const auto& id : {"a", "b", "c"}) {
+    auto ctx = std::make_shared<Context>(id, 0);
+    ctx->AddListener(std::make_shared<LContextForwarder>("L", "drink (.*)", ctx, "#drink {}", true, 
+          UseCtx::NO, "{potions} > 0"));
+    REQUIRE(stack.insert(ctx));
+  }
+
+  // Regex tested first: logic not evaluated
+  stack.TakeEvent("go west", parser);
+  REQUIRE(substituted == 0);
+
+  // Forwarders don't modify attributes directly: evaluated once
+  stack.TakeEvent("drink potion", parser);
+  REQUIRE(forwarded.size() == 3);
+  REQUIRE(substituted == 1);
+
+  // Attribute writes invalidate memo
+  auto writer = std::make_shared<Context>("writer", 1);
+  writer->AddAttribute("x", "0");
+  writer->AddListener(std::make_shared<LHandler>("W", "drink (.*)", [&](User*, std::string, std::string) {
+        writer->SetAttribute("x", "1");
+        attributes["potions"] = "0";
+      }));
+  REQUIRE(stack.insert(writer));
+  stack.TakeEvent("drink potion", parser);
+  REQUIRE(forwarded.size() == 3);
+  REQUIRE(substituted == 2);
+}
+
+TEST_CASE("Test memoized logic recomputed after writes of contexts not on stack", "[stack]") {
+  auto closet = std::make_shared<Context>("closet", 0);
+  closet->AddAttribute("potions", "1");
+  size_t substituted = 0;
+  ExpressionParser parser;
+  parser = ExpressionParser([&](const std::string& str) { 
+    substituted++;
+    parser.DependsOn(Context::VersionOf(closet));
+    return *closet->GetAttribute(str); 
+  });
+  std::vector<std::string> forwarded;
+  LForwarder::set_overwite_fn([&forwarded](User*, std::string, std::string args) { 
+    forwarded.push_back(args); 
+  });
+
+  // Second forwarder evaluated after handler emptied the (unlinked) closet
+  ContextStack stack;
+  auto ctx = std::make_shared<Context>("a", 0);
+  ctx->AddListener(std::make_shared<LContextForwarder>("A1", "drink (.*)", ctx, "#first", true, 
+        UseCtx::NO, "{potions} > 0"));
+  ctx->AddListener(std::make_shared<LHandler>("A2", "drink (.*)", [&](User*, std::string, std::string) {
+        closet->SetAttribute("potions", "0");
+      }));
+  ctx->AddListener(std::make_shared<LContextForwarder>("A3", "drink (.*)", ctx, "#second", true, 
+        UseCtx::NO, "{potions} > 0"));
+  REQUIRE(stack.insert(ctx));
+  stack.TakeEvent("drink potion", parser);
+  REQUIRE(forwarded == std::vector<std::string>{"#first"});
+  REQUIRE(substituted == 2);
+
+  // Unchanged: memoized
+  closet->SetAttribute("potions", "2");
+  auto other = std::make_shared<Context>("b", 0);
+  other->AddListener(std::make_shared<LContextForwarder>("B1", "drink (.*)", other, "#third", true, 
+        UseCtx::NO, "{potions} > 0"));
+  REQUIRE(stack.insert(other));
+  forwarded.clear();
+  substituted = 0;
+  ctx->RemoveListener("A2");
+  stack.TakeEvent("drink potion", parser);
+  REQUIRE(forwarded == std::vector<std::string>{"#first", "#second", "#third"});
+  REQUIRE(substituted == 1);
+}
+
+TEST_CASE("Test context-forwarders matching names through index", "[stack]") {
+  ExpressionParser parser;
+  std::vector<std::string> forwarded;
+  LForwarder::set_overwite_fn([&forwarded](User*, std::string, std::string args) { 
+    forwarded.push_back(args); 
+  });
+
+  ContextStack stack;
+  std::map<std::string, std::shared_ptr<Context>> items;
+  for (const auto& [id, name] : std::vector<std::pair<std::string, std::string>>{{"potion", "Heiltrank"}, 
+      {"mana", "Manatrank"}, {"sword", "Schwert"}}) {
+    auto ctx = std::make_shared<Context>(id, name, "");
+    ctx->AddListener(std::make_shared<LContextForwarder>("L", "pick up (.*)", ctx, "#pick <ctx>", true, 
+          UseCtx::NAME_FUZZY));
+    items[id] = ctx;
+    REQUIRE(stack.insert(ctx));
+  }
+
+  stack.TakeEvent("pick up heiltrnk", parser);
+  REQUIRE(forwarded == std::vector<std::string>{"#pick potion"});
+
+  // Without stack, names are matched directly
+  const auto& listener = items["mana"]->listeners().at("L");
+  REQUIRE(listener->MatchEvent("pick up manatrnk")._names == nullptr);
+  REQUIRE(listener->Test("pick up manatrnk", parser));
+  REQUIRE(!listener->Test("pick up schwert", parser));
+
+  // Renamed contexts are matched by their new name
+  forwarded.clear();
+  items["sword"]->set_name("Lampe");
+  stack.TakeEvent("pick up lampe", parser);
+  REQUIRE(forwarded == std::vector<std::string>{"#pick sword"});
+
+  // Removed contexts are not matched
+  forwarded.clear();
+  REQUIRE(stack.erase("potion"));
+  stack.TakeEvent("pick up heiltrank", parser);
+  REQUIRE(forwarded.empty());
+  stack.TakeEvent("pick up schwert", parser);
+  REQUIRE(forwarded.empty());
+}
+
+TEST_CASE("Test resolution cache", "[stack]") {
+  std::map<std::string, std::string> attributes = {{"lit", "1"}};
+  ExpressionParser parser([&attributes](const std::string& str) { return attributes.at(str); });
+  std::vector<std::string> executed;
+  LForwarder::set_overwite_fn([&executed](User*, std::string, std::string args) { 
+    executed.push_back(args); 
+  });
+  auto handler = [&executed](const std::string& id) {
+    return [&executed, id](User*, std::string, std::string args) { executed.push_back(id + ": " + args); };
+  };
+
+  ContextStack stack;
+  auto ctx = std::make_shared<Context>("room", 0);
+  ctx->AddListener(std::make_shared<LHandler>("A", "show (.*)", handler("A")));
+  ctx->AddListener(std::make_shared<LForwarder>("B", "show exits", "#print exits", true, "{lit} = 1"));
+  REQUIRE(stack.insert(ctx));
+
+  const auto stats = ContextStack::resolution_stats();
+  stack.TakeEvent("show exits", parser);
+  REQUIRE(executed == std::vector<std::string>{"A: exits", "#print exits"});
+  REQUIRE(ContextStack::resolution_stats()._misses == stats._misses + 1);
+
+  // Resolved from cache, logic is evaluated again
+  executed.clear();
+  attributes["lit"] = "0";
+  stack.TakeEvent("show exits", parser);
+  REQUIRE(executed == std::vector<std::string>{"A: exits"});
+  REQUIRE(ContextStack::resolution_stats()._hits == stats._hits + 1);
+
+  // Listener edits invalidate cache
+  executed.clear();
+  ctx->AddListener(std::make_shared<LHandler>("C", "show exits", handler("C")));
+  stack.TakeEvent("show exits", parser);
+  REQUIRE(executed == std::vector<std::string>{"A: exits", "C: "});
+  REQUIRE(ContextStack::resolution_stats()._misses == stats._misses + 2);
+
+  // Linking contexts invalidates cache
+  executed.clear();
+  auto other = std::make_shared<Context>("other", 1);
+  other->AddListener(std::make_shared<LHandler>("D", "show (.*)", handler("D")));
+  REQUIRE(stack.insert(other));
+  stack.TakeEvent("show exits", parser);
+  REQUIRE(executed == std::vector<std::string>{"D: exits", "A: exits", "C: "});
+  REQUIRE(ContextStack::resolution_stats()._misses == stats._misses + 3);
+  REQUIRE(ContextStack::resolution_stats()._hits == stats._hits + 1);
+}
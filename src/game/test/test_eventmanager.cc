@@ -1,6 +1,8 @@
 #include "shared/utils/test_helpers.h"
 #include "game/utils/defines.h"
 #include "shared/objects/context/context.h"
+#include "shared/utils/eventmanager/context_stack.h"
+#include "shared/utils/eventmanager/event_queue.h"
 #include "shared/utils/eventmanager/eventmanager.h"
 #include "shared/utils/eventmanager/listener.h"
 #include "shared/utils/parser/expression_parser.h"
@@ -9,6 +11,7 @@
 #include <fmt/format.h>
 #include <memory>
 #include <string>
+#include <vector>
 
 void TakeEvents(std::string& events, EventManager& em, ExpressionParser& parser) {
   util::Logger()->debug("TakeEvents: \"{}\"", events);
@@ -35,11 +38,11 @@ TEST_CASE("Test eventmanager basic use", "[eventmanager]") {
   ExpressionParser parser(fn);
   std::string event_queue = "";
 
-  Listener::Fn set_attribute = [&attributes, &parser](std::string event, std::string args) {
+  Listener::Fn set_attribute = [&attributes, &parser](User*, std::string event, std::string args) {
     test::SetAttribute(attributes, args, parser);
   };
 
-  Listener::Fn add_to_eventqueue = [&event_queue](std::string event, std::string args) {
+  Listener::Fn add_to_eventqueue = [&event_queue](User*, std::string event, std::string args) {
     event_queue += ((event_queue != "") ? ";" : "") + args;
   };
 
@@ -136,11 +139,11 @@ TEST_CASE("Test eventmanager event match replacements", "[eventmanager]") {
   ExpressionParser parser(fn);
   std::string event_queue = "";
 
-  Listener::Fn set_attribute = [&attributes, &parser](std::string event, std::string args) {
+  Listener::Fn set_attribute = [&attributes, &parser](User*, std::string event, std::string args) {
     test::SetAttribute(attributes, args, parser);
   };
 
-  Listener::Fn add_to_eventqueue = [&event_queue](std::string event, std::string args) {
+  Listener::Fn add_to_eventqueue = [&event_queue](User*, std::string event, std::string args) {
     event_queue += ((event_queue != "") ? ";" : "") + args;
   };
   LForwarder::set_overwite_fn(add_to_eventqueue);
@@ -203,11 +206,11 @@ TEST_CASE("Test context-forwarder single capture matching remains unchanged", "[
   std::string event_queue = "";
   auto ctx_room = std::make_shared<Context>("rooms/room_1", "Room One", "");
 
-  Listener::Fn set_attribute = [&attributes, &parser](std::string event, std::string args) {
+  Listener::Fn set_attribute = [&attributes, &parser](User*, std::string event, std::string args) {
     test::SetAttribute(attributes, args, parser);
   };
 
-  Listener::Fn add_to_eventqueue = [&event_queue](std::string event, std::string args) {
+  Listener::Fn add_to_eventqueue = [&event_queue](User*, std::string event, std::string args) {
     event_queue += ((event_queue != "") ? ";" : "") + args;
   };
   LForwarder::set_overwite_fn(add_to_eventqueue);
@@ -225,6 +228,79 @@ TEST_CASE("Test context-forwarder single capture matching remains unchanged", "[
   REQUIRE(attributes["called"] == "rooms/room_1");
 }
 
+TEST_CASE("Test listener match result", "[eventmanager]") {
+  ExpressionParser parser;
+  std::vector<std::string> executed;
+
+  Listener::Fn fn_executed = [&executed](User*, std::string event, std::string args) {
+    executed.push_back(args);
+  };
+  LForwarder::set_overwite_fn(fn_executed);
+
+  SECTION("Test returns captures") {
+    LForwarder listener("P1", "login ([^|]+)\\|(.*)", "#sa msg=#event2", true, "'#event1' = 'patricia'");
+
+    auto match = listener.Test("login patricia|ok", parser);
+    REQUIRE(match);
+    REQUIRE(match._captures == std::vector<std::string>{"login patricia|ok", "patricia", "ok"});
+
+    REQUIRE_FALSE(listener.Test("login susie|ok", parser));  // logic rejected
+    REQUIRE_FALSE(listener.Test("logout patricia", parser));  // regex rejected
+  }
+
+  SECTION("Execute consumes the match") {
+    LForwarder listener("P1", "say (.*)", "#sa msg=#event", true);
+
+    auto match = listener.Test("say hello", parser);
+    REQUIRE(match);
+    listener.Execute("say hello", match, nullptr);
+    REQUIRE(executed == std::vector<std::string>{"#sa msg=hello"});
+
+    // Arguments are taken from the match only (the event is not matched again)
+    match._captures[1] = "bye";
+    listener.Execute("say hello", match, nullptr);
+    REQUIRE(executed.back() == "#sa msg=bye");
+  }
+
+  SECTION("Regex is matched once per event") {
+    // Counts matches of the regex (logic and arguments use the captures)
+    struct CountingForwarder : LForwarder {
+      using LForwarder::LForwarder;
+      mutable size_t _matched = 0;
+      Match MatchEvent(const std::string& event) const override {
+        _matched++;
+        return LForwarder::MatchEvent(event);
+      }
+    };
+    auto listener = std::make_shared<CountingForwarder>("P1", "say (.*)", "#sa msg=#event", true, 
+        "'#event1' != 'nothing'");
+    auto ctx = std::make_shared<Context>("ctx", 1);
+    ctx->AddListener(listener);
+
+    ctx->TakeEvent("say hello", parser);
+    REQUIRE(listener->_matched == 1);
+    REQUIRE_FALSE(ctx->TakeEvent("say nothing", parser));
+    REQUIRE(listener->_matched == 2);
+
+    ContextStack stack;
+    stack.insert(ctx);
+    stack.TakeEvent("say hi", parser);
+    REQUIRE(listener->_matched == 3);
+    REQUIRE(executed == std::vector<std::string>{"#sa msg=hello", "#sa msg=hi"});
+  }
+
+  SECTION("Context-forwarders pass their captures on") {
+    auto ctx_room = std::make_shared<Context>("rooms/room_1", "Room One", "");
+    LContextForwarder listener("P1", "go (.*)", ctx_room, "#goto #event", true, UseCtx::NAME);
+
+    REQUIRE_FALSE(listener.Test("go Wrong Room", parser));
+    auto match = listener.Test("go Room One", parser);
+    REQUIRE(match);
+    listener.Execute("go Room One", match, nullptr);
+    REQUIRE(executed == std::vector<std::string>{"#goto Room One"});
+  }
+}
+
 TEST_CASE("Test eventmanager: SetAttribute", "[eventmanager]") {
   const std::string E_SET_MANA = "#sa mana=20";
   const std::string E_ADD_MANA = "#sa mana+=20";
@@ -241,11 +317,11 @@ TEST_CASE("Test eventmanager: SetAttribute", "[eventmanager]") {
   ExpressionParser parser(fn);
   std::string event_queue = "";
 
-  Listener::Fn set_attribute = [&attributes, &parser](std::string event, std::string args) {
+  Listener::Fn set_attribute = [&attributes, &parser](User*, std::string event, std::string args) {
     test::SetAttribute(attributes, args, parser);
   };
 
-  Listener::Fn add_to_eventqueue = [&event_queue](std::string event, std::string args) {
+  Listener::Fn add_to_eventqueue = [&event_queue](User*, std::string event, std::string args) {
     event_queue += ((event_queue != "") ? ";" : "") + args;
   };
   LForwarder::set_overwite_fn(add_to_eventqueue);
@@ -298,10 +374,10 @@ TEST_CASE("Test permeability", "[eventmanager]") {
   ExpressionParser parser(fn);
   std::string event_queue = "";
 
-  Listener::Fn set_attribute = [&attributes, &parser](std::string event, std::string args) {
+  Listener::Fn set_attribute = [&attributes, &parser](User*, std::string event, std::string args) {
     test::SetAttribute(attributes, args, parser);
   };
-  Listener::Fn add_to_eventqueue = [&event_queue](std::string event, std::string args) {
+  Listener::Fn add_to_eventqueue = [&event_queue](User*, std::string event, std::string args) {
     event_queue += ((event_queue != "") ? ";" : "") + args;
   };
   LForwarder::set_overwite_fn(add_to_eventqueue);
@@ -331,10 +407,10 @@ TEST_CASE("Test logic", "[eventmanager]") {
   ExpressionParser parser(fn);
   std::string event_queue = "";
 
-  Listener::Fn set_attribute = [&attributes, &parser](std::string event, std::string args) {
+  Listener::Fn set_attribute = [&attributes, &parser](User*, std::string event, std::string args) {
     test::SetAttribute(attributes, args, parser);
   };
-  Listener::Fn add_to_eventqueue = [&event_queue](std::string event, std::string args) {
+  Listener::Fn add_to_eventqueue = [&event_queue](User*, std::string event, std::string args) {
     event_queue += ((event_queue != "") ? ";" : "") + args;
   };
   LForwarder::set_overwite_fn(add_to_eventqueue);
@@ -419,3 +495,193 @@ TEST_CASE("Test logic", "[eventmanager]") {
     REQUIRE(event_queue == E_SET_RUNES); 
   }
 }
+
+TEST_CASE("Test event queue", "[eventmanager]") {
+  EventQueue queue;
+  REQUIRE(queue.empty());
+
+  SECTION("Events are split and taken in order") {
+    queue.Push("go west; #sa player.hp--;;");
+    queue.Push("look");
+    REQUIRE(queue.size() == 3);
+    REQUIRE(queue.str() == "go west;#sa player.hp--;look");
+    REQUIRE(queue.Pop()->_event == "go west");
+    REQUIRE(queue.Pop()->_event == "#sa player.hp--");
+    REQUIRE(queue.Pop()->_event == "look");
+    REQUIRE(!queue.Pop());
+  }
+
+  SECTION("User input is not split") {
+    queue.Push("say a;b", true);
+    auto event = queue.Pop();
+    REQUIRE(event->_event == "say a;b");
+    REQUIRE(event->_user_inp);
+    REQUIRE(event->_kind == EVENT_USER);
+  }
+
+  SECTION("Events are classified") {
+    queue.Push("#help", true);
+    queue.Push("go west;#sa player.hp--");
+    REQUIRE(queue.Pop()->_kind == EVENT_SYSTEM);
+    REQUIRE(queue.Pop()->_kind == EVENT_GENERATED);
+    REQUIRE(queue.Pop()->_kind == EVENT_SYSTEM);
+  }
+
+  SECTION("';' inside brackets does not split") {
+    REQUIRE(EventQueue::Split("#sa a.b = ({x;y}); #> [1;2]") 
+        == std::vector<std::string>{"#sa a.b = ({x;y})", "#> [1;2]"});
+    // Unbalanced brackets (f.e. in text): every ';' splits
+    REQUIRE(EventQueue::Split("#> :(;#> b") == std::vector<std::string>{"#> :(", "#> b"});
+    REQUIRE(EventQueue::Split("#> :);#> b") == std::vector<std::string>{"#> :)", "#> b"});
+  }
+}
+
+TEST_CASE("Test eventmanager prefix index", "[eventmanager]") {
+  EventManager em;
+  ExpressionParser parser;
+  std::vector<std::string> executed;
+  auto add = [&em, &executed](std::string id, std::string re_event, bool permeable=true) {
+    em.AddListener(std::make_shared<LHandler>(id, re_event, [&executed, id](User*, std::string, std::string) {
+        executed.push_back(id); }, permeable));
+  };
+  auto candidates = [&em](const std::string& event) {
+    std::vector<std::string> ids;
+    for (const auto& listener : em.Candidates(event))
+      ids.push_back(listener->id());
+    return ids;
+  };
+
+  add("P1", "go to (.*)");
+  add("P2", "<user-inp>");
+  add("P3", "go .*");
+  add("P4", "pick up (.*)");
+  add("P5", "#sa (.*)");
+  REQUIRE(util::Regex("go to (.*)").prefix() == "go to ");
+  REQUIRE(util::Regex("<user-inp>").prefix() == "");
+
+  SECTION("Only listeners with matching prefix are candidates (in listener order)") {
+    REQUIRE(candidates("go to closet") == std::vector<std::string>{"P1", "P2", "P3"});
+    REQUIRE(candidates("pick up knife") == std::vector<std::string>{"P2", "P4"});
+    REQUIRE(candidates("#sa mana=10") == std::vector<std::string>{"P2", "P5"});
+    REQUIRE(candidates("go") == std::vector<std::string>{"P2"});
+
+    REQUIRE(em.TakeEvent("go to closet", parser));
+    REQUIRE(executed == std::vector<std::string>{"P1", "P2", "P3"});
+  }
+
+  SECTION("Non-permeable listeners still stop the event") {
+    add("P0", "go to closet", false);
+    REQUIRE(em.TakeEvent("go to closet", parser));
+    REQUIRE(executed == std::vector<std::string>{"P0"});
+  }
+
+  SECTION("Index follows replaced and removed listeners") {
+    add("P1", "pick up knife");
+    REQUIRE(candidates("go to closet") == std::vector<std::string>{"P2", "P3"});
+    REQUIRE(candidates("pick up knife") == std::vector<std::string>{"P1", "P2", "P4"});
+    em.RemoveListener("P2");
+    em.RemoveListener("P4");
+    REQUIRE(candidates("pick up knife") == std::vector<std::string>{"P1"});
+    REQUIRE(candidates("hello").empty());
+    REQUIRE_FALSE(em.TakeEvent("hello", parser));
+  }
+}
+
+TEST_CASE("Test command dispatcher", "[eventmanager]") {
+  ExpressionParser parser;
+  std::vector<std::string> executed;
+  auto fn = [&executed](const std::string& name) -> Listener::Fn {
+    return [&executed, name](User*, std::string event, std::string args) { 
+      executed.push_back(name + ":" + args); };
+  };
+
+  auto commands = std::make_shared<LCommandDispatcher>("H_COMMANDS");
+  commands->AddCommand("#ctx add", fn("add"));
+  commands->AddCommand("#sa", fn("sa"));
+  commands->AddCommand("#>", fn("print"));
+  commands->AddCommand("#>>", fn("print_prompt"));
+  commands->AddCommand("#lst* atts", fn("lst_all"));
+  commands->AddCommand("#reset game", fn("reset"), false);
+  REQUIRE(commands->prefix() == "#");
+
+  SECTION("Commands accept the same events as equivalent handlers") {
+    EventManager handlers;
+    handlers.AddListener(std::make_shared<LHandler>("H1", "#ctx add (.*)", fn("add")));
+    handlers.AddListener(std::make_shared<LHandler>("H2", "#sa (.*)", fn("sa")));
+    handlers.AddListener(std::make_shared<LHandler>("H3", "#> (.*)", fn("print")));
+    handlers.AddListener(std::make_shared<LHandler>("H4", "#>> (.*)", fn("print_prompt")));
+    handlers.AddListener(std::make_shared<LHandler>("H5", "#lst* atts (.*)", fn("lst_all")));
+    handlers.AddListener(std::make_shared<LHandler>("H6", "#reset game", fn("reset")));
+    EventManager dispatcher;
+    dispatcher.AddListener(commands);
+
+    for (const std::string event : {"#ctx add rooms/closet", "#ctx  add x", "#ctx add", "#ctx add ", "#sa mana=10", 
+        "#sa  mana", "#sa", "#sam x", "#> hello world", "#>> hello", "#>>> x", "#> two\nlines", "#lst* atts x", 
+        "#lst atts x", "#reset game", "#reset game now", "#reset", "hello", ""}) {
+      INFO(event);
+      executed.clear();
+      bool handled = handlers.TakeEvent(event, parser);
+      auto expected = executed;
+      executed.clear();
+      REQUIRE(dispatcher.TakeEvent(event, parser) == handled);
+      REQUIRE(executed == expected);
+    }
+  }
+
+  SECTION("Listeners of higher priority contexts intercept commands") {
+    auto mechanics = std::make_shared<Context>("ctx_mechanic", 0, false);
+    mechanics->AddListener(commands);
+    auto author = std::make_shared<Context>("author", 1, false);
+    author->AddListener(std::make_shared<LHandler>("A1", "#sa (.*)", fn("author"), false));
+    ContextStack stack;
+    stack.insert(mechanics);
+    stack.insert(author);
+
+    stack.TakeEvent("#sa mana=10", parser);
+    stack.TakeEvent("#> hi", parser);
+    REQUIRE(executed == std::vector<std::string>{"author:mana=10", "print:hi"});
+  }
+}
+
+TEST_CASE("Test listener event kinds", "[eventmanager]") {
+  ExpressionParser parser;
+  std::vector<std::string> executed;
+  auto handler = [&executed](const std::string& id) {
+    return [&executed, id](User*, std::string, std::string) { executed.push_back(id); };
+  };
+  auto inp = std::make_shared<LHandler>("inp", "<user-inp>", handler("inp"));
+  auto sys = std::make_shared<LHandler>("sys", "#(.*)", handler("sys"));
+  auto any = std::make_shared<LHandler>("any", "(.*)", handler("any"));
+  auto alt = std::make_shared<LHandler>("alt", "(#help|help)", handler("alt"));
+  REQUIRE(inp->kinds() == (EVENT_USER | EVENT_GENERATED));
+  REQUIRE(sys->kinds() == EVENT_SYSTEM);
+  REQUIRE(any->kinds() == EVENT_ANY);
+  REQUIRE(alt->kinds() == EVENT_ANY);
+  REQUIRE(std::make_shared<LHandler>("look", "look", handler("look"))->kinds() == (EVENT_USER | EVENT_GENERATED));
+
+  LCommandDispatcher commands("commands");
+  commands.AddCommand("#sa", handler("#sa"));
+  REQUIRE(commands.kinds() == EVENT_SYSTEM);
+
+  ContextStack stack;
+  auto ctx = std::make_shared<Context>("ctx", 0);
+  for (const auto& it : {inp, sys, any, alt})
+    ctx->AddListener(it);
+  REQUIRE(stack.insert(ctx));
+
+  auto ids = [](const auto& candidates) {
+    std::vector<std::string> ids;
+    for (const auto& [ctx, listener] : candidates)
+      ids.push_back(listener->id());
+    return ids;
+  };
+  REQUIRE(ids(stack.Candidates("#help", EVENT_SYSTEM)) == std::vector<std::string>{"alt", "any", "sys"});
+  REQUIRE(ids(stack.Candidates("help", EVENT_USER)) == std::vector<std::string>{"alt", "any", "inp"});
+
+  std::string events = "#help";
+  stack.TakeEvents(events, parser, true);
+  REQUIRE(executed == std::vector<std::string>{"alt", "any", "sys"});
+  executed.clear();
+  stack.TakeEvent("go", parser);
+  REQUIRE(executed == std::vector<std::string>{"any", "inp"});
+}
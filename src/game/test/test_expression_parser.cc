@@ -1,9 +1,12 @@
 #include "game/game/game.h"
 #include "game/utils/defines.h"
+#include "shared/objects/context/context.h"
+#include "shared/utils/eventmanager/context_stack.h"
 #include "shared/utils/fuzzy_search/fuzzy.h"
 #include "shared/utils/parser/expression_parser.h"
 #include "shared/utils/test_helpers.h"
 #include <catch2/catch_test_macros.hpp>
+#include <memory>
 #include <string>
 
 TEST_CASE("Text expression parser", "[parser]") {
@@ -177,3 +180,287 @@ TEST_CASE("Text replacements", "[parser]") {
   REQUIRE(parser.Evaluate("{#ran_num|dog|1}") == txtad::NO_REPLACEMENT);
   test::test_random_parser(parser, "{#ran_num|1|10} = 5", "1", 0.1);
 }
+
+TEST_CASE("Test expression memo", "[parser]") {
+  std::map<std::string, std::string> attributes = {{"mana", "10"}};
+  size_t substituted = 0;
+  bool random = false;
+  ExpressionParser* self = nullptr;
+  ExpressionParser parser([&](const std::string& str) { 
+    substituted++; 
+    if (random)
+      self->NotMemoizable();
+    return attributes.at(str); 
+  });
+  self = &parser;
+  uint64_t version = 0;
+
+  // Without memo, every evaluation substitutes
+  REQUIRE(parser.Evaluate("{mana} > 5") == "1");
+  REQUIRE(parser.Evaluate("{mana} > 5") == "1");
+  REQUIRE(substituted == 2);
+
+  {
+    const auto stats = ExpressionParser::memo_stats();
+    ExpressionParser::Memo memo(parser, [&version]() { return version; });
+    REQUIRE(parser.Evaluate("{mana} > 5") == "1");
+    REQUIRE(parser.Evaluate("{mana} > 5") == "1");
+    REQUIRE(substituted == 3);
+    REQUIRE(ExpressionParser::memo_stats()._evaluations == stats._evaluations + 2);
+    REQUIRE(ExpressionParser::memo_stats()._saved == stats._saved + 1);
+
+    // Version changed: evaluated again
+    attributes["mana"] = "1";
+    version++;
+    REQUIRE(parser.Evaluate("{mana} > 5") == "0");
+    REQUIRE(substituted == 4);
+    REQUIRE(parser.Evaluate("{mana} > 5") == "0");
+    REQUIRE(substituted == 4);
+
+    // Cleared
+    memo.Clear();
+    REQUIRE(parser.Evaluate("{mana} > 5") == "0");
+    REQUIRE(substituted == 5);
+
+    // Not memoizable
+    random = true;
+    REQUIRE(parser.Evaluate("{mana} < 5") == "1");
+    REQUIRE(parser.Evaluate("{mana} < 5") == "1");
+    REQUIRE(substituted == 7);
+    random = false;
+  }
+
+  // Memo removed
+  REQUIRE(parser.Evaluate("{mana} > 5") == "0");
+  REQUIRE(substituted == 8);
+}
+
+TEST_CASE("Test compiled expressions", "[parser]") {
+  std::map<std::string, std::string> substitutes = {{"num", "10"}, {"neg", "-3"}, {"empty", ""}, 
+    {"id", "chars/fux"}, {"list", "[book; tabako; wine]"}, {"op", "1+1"}, {"bracket", "(2)"}, 
+    {"quote", "it's"}, {"name", "Hund"}, {"fuzzy_list", "Bottle; Tabako"}, {"a", "0"}, {"b", "2"}, 
+    {"mana", "10"}, {"inventory", "[bottle; tabako; wine]"}, {"player_name", "chars/fux"}, 
+    {"players", "[chars/fux; chars/jan]"}, {"rooms/closet", "Closet"}};
+  ExpressionParser parser([&substitutes](const std::string& str) { 
+    return substitutes.contains(str) ? substitutes.at(str) : txtad::NO_REPLACEMENT; });
+
+  // Expressions of other tests in this file, compared with the interpreter
+  const std::vector<std::string> expressions = {"10 * 10", "10*2", "20+10*2", "20+10*2-10", "20+10*2/10", 
+    "(1+1)*2+2", "(1+1)*(2+2)", "Hund ~ Hündin = {no_match}", "Hund ~ hund = {direct}", 
+    "Hund ~ Hunde = {starts_with}", "Hund ~ JahrHUNDert = {contains}", "Mimesis ~ Mimisis = {fuzzy}", 
+    "book:[bottle; lighter; book]", "tabako:[bottle; lighter; book] = 0", "[tabako|lighter]:[bottle; lighter; book]",
+    "tobako~:[Bottle; Lighter; Tabako; Book]", "tobako~:[Bottle; Lighter; Tabako; Book] = [{fuzzy}]", 
+    "{fuzzy} : (tobako~:[Bottle; Lighter; Tabako; Book])", " 10 + 10", "10+ 10", "10 +10", "Ha lo=Halo", 
+    "Ha lo = Ha lo", "10 : [ 5; ;720;10;8; 72 ;5]", "[ 10 | 11 ] : [5;720;11;8;72]", "10 - 10 + 10", 
+    "10 * 10 - 10 + 5", "10 / 10 - 10+5 * 5 ", "10 / 5 * 2 ", "10 ~ 100", "10 ~ 110", "hund ~ jahrhundert", 
+    "10 : [5;10]", "10 >= 9", "10 <= 9", "10 < 100", "mimisis ~: [Eingedenken; das Hinzutretende; Mimesis; Leid]", 
+    "4:[4]", "Hund ~ hund = 1", "Mimesis ~ mimisis =4", "1 && 0", "0 || 1", "(20*10>4) && (4:[10;3; 4])", 
+    "4 - ( 2 + 2)", "4 - ( 2 + 2) + 2", "((1+1)*2+2)*(2+2)+10", "((1+1)*2+2)*(2+2)+(10*(2+(10-10)))", 
+    "2+4*2", "(10-10)*2+2+4*2", "Affair~:[affaire;eine auffaire;eine frau]", "a~:[affaire;eine auffaire;eine frau]",
+    // Structure depending on results or substitutes 
+    "5+(1-4)", "(1-4)+2", "2*(1-4)", "x ~(Hund)", "(1+1)~1", "5 +", "{num} > 5", "{num}*2+{num}", 
+    "({num}-12) < 0", "{neg} < 0", "{neg}*2", "'{neg}' < 0", "{empty} = ''", "'{empty}'=x", "({empty})", 
+    "{id} = 'chars/fux'", "'{id}' = chars/fux", "({id}) = x", "tabako:{list}", "[{fuzzy}] : (tobako~:{list})",
+    "{op} = 2", "'{op}' = 2", "({op})*2", "{bracket} = 2", "'{bracket}'", "{quote} = x", "{name} ~ hund = {direct}",
+    "{name}~:[{fuzzy_list}]", "{unknown} = 1", "it's {num} > 5", "('a)' = {op})", "{num}{num} = 1010", 
+    "(({num}+2)*(2-{num})) > {neg}",
+    // Expressions of other tests (except "10 / 0": integer division by zero in interpreter)
+    "tabako:[bottle; lighter; book]", "10 + 10", "10+10", "Ha lo=Ha lo", "2010 : [ 5; ;720;10;8; 72 ;5]",
+    "10 - 10", "10 / 10", "10 + 10 + 10", "10 = 10", "10 = 11", "hündin ~ jahrhundert = {no_match}",
+    "hund ~ hunde = {starts_with}", "hund ~ jahrhundert = {contains}", "Mimesis ~ mimisis = {fuzzy}",
+    "Hund ~ hund", "hund ~ Hund", "hund ~ hunde", "hunde ~ hund", "hündin ~ jahrhundert", "Mimesis ~ mimisis",
+    "10 : [10]", "10 : [10;5]", "10 : [5;720;10;8;72]", "10 : [5;720;11;8;72]", "[10|11] : [5;720;11;8;72]",
+    "10 > 100", "10 > 9", "10 < 9", "10 >= 10", "10 >= 11", "10 <= 11", "10 <= 10",
+    "Mimesis ~: [Eingedenken; mimesisch; das Hinzutretende; Leid]",
+    "mimisis ~: [Eingedenken; das Hinzutretende; Leid]", "1 && 1", "0 && 1", "0 && 0", "1 || 1", "1 || 0",
+    "0 || 0", "eine Affair~:[affaire;eine auffaire;eine frau]", "eine Frau~:[affaire;eine auffaire;eine frau]",
+    "Liebe~:[affaire;eine auffaire;eine frau]", "f~:[affaire;eine auffaire;eine frau]",
+    "{player_name}='chars/fux'", "{player_name}='chars/jan'", "{player_name}={player_name}",
+    "{player_name}:[{players}]", "{player_name}~:[{players}]", "{rooms/closet}=Closet", "tabako:{inventory}",
+    "[{fuzzy}] : (tobako~:{inventory})", "cigarettes:{inventory}", "{#ran_num}", "{#ran_num|dog|1}",
+    "{mana} > 5", "{mana} < 5", "1+1", "(1+2)*3 = 9", "({mana} > 5) = 1", "({mana} > 5) && ({mana} < 20)",
+    "{fuzzy} : ({name}~:[Bottle; Hund; Hunde])", "{direct} : ({name}~:[Bottle; Hund; Hunde])", "{mana} + 1",
+    "({a} = 1) && ({b} = 2)", "{a} = 1 && {b}", "({a} = 0) || ({b} = 2)", "({a} = 0) || ({b} = 3)",
+    "({a} > 0) && ({b} > 0)", "({a} > 0) || ({b} > 0)", "{name} = Hund", "({mana} < 5) && ({name} = Hund)",
+    "{mana} + {#ran_num}"};
+
+  // Same result as interpreter, unless a right operand of '&&'/ '||' was skipped (its
+  // substitutes are not resolved, see Test short-circuit evaluation)
+  auto require_same = [](const ExpressionParser& parser, const std::string& expression) {
+    const size_t skipped = ExpressionParser::substitution_stats()._skipped;
+    const std::string res = parser.Evaluate(expression);
+    if (ExpressionParser::substitution_stats()._skipped == skipped)
+      REQUIRE(res == parser.EvaluateInterpreted(expression));
+  };
+
+  const size_t compiled = ExpressionParser::compiled();
+  for (const auto& expression : expressions) {
+    INFO(expression);
+    require_same(parser, expression);
+    require_same(parser, expression);
+  }
+  REQUIRE(ExpressionParser::compiled() > compiled);
+
+  // Without substitutes
+  ExpressionParser no_substitutes;
+  for (const auto& expression : expressions) {
+    INFO(expression << " without substitutes");
+    require_same(no_substitutes, expression);
+  }
+
+  // Same compiled expression, different substitutes
+  for (const auto& key : {"num", "a", "mana", "name", "inventory"}) {
+    const std::string original = substitutes.at(key);
+    for (const auto& value : {"0", "-1", "7", "", "a b", "1+1", "(", "'", "~1", "[1;2]", "x/y"}) {
+      substitutes[key] = value;
+      for (const auto& expression : expressions) {
+        INFO(expression << " with {" << key << "}=" << value);
+        require_same(parser, expression);
+      }
+    }
+    substitutes[key] = original;
+  }
+}
+
+TEST_CASE("Test compiled expressions evicted when exceeding maximum", "[parser]") {
+  ExpressionParser parser;
+  for (size_t i=0; i<ExpressionParser::MAX_COMPILED+10; i++) {
+    REQUIRE(parser.Evaluate(std::to_string(i) + "+1") == std::to_string(i+1));
+    REQUIRE(parser.Evaluate("1+1") == "2");
+  }
+  // Only least recently used expressions are removed
+  REQUIRE(ExpressionParser::compiled() <= ExpressionParser::MAX_COMPILED);
+  REQUIRE(ExpressionParser::compiled() > ExpressionParser::MAX_COMPILED/2);
+}
+
+TEST_CASE("Test typed expression values", "[parser]") {
+  using Value = ExpressionParser::Value;
+  REQUIRE(Value::String("12")._numeric);
+  REQUIRE(Value::String("12")._int == 12);
+  REQUIRE(!Value::String("twelve")._numeric);
+  REQUIRE(Value::Int(1, Value::BOOL).str() == "1");
+  REQUIRE(Value::Int(-3).str() == "-3");
+  REQUIRE(Value::List({4, 1}).str() == "[4;1]");
+  REQUIRE(Value::List({}).str() == "[]");
+
+  std::map<std::string, std::string> substitutes = {{"mana", "10"}, {"name", "Hund"}};
+  ExpressionParser parser([&substitutes](const std::string& str) { return substitutes.at(str); });
+
+  // Results of operators stay typed
+  REQUIRE(parser.Evaluate("(1+2)*3 = 9") == "1");
+  REQUIRE(parser.Evaluate("({mana} > 5) = 1") == "1");
+  REQUIRE(parser.Evaluate("({mana} > 5) && ({mana} < 20)") == "1");
+  REQUIRE(parser.Evaluate("{fuzzy} : ({name}~:[Bottle; Hund; Hunde])") == "0");
+  REQUIRE(parser.Evaluate("{direct} : ({name}~:[Bottle; Hund; Hunde])") == "1");
+
+  // Errors return the substituted expression (division by zero, too)
+  substitutes["mana"] = "much";
+  REQUIRE(parser.Evaluate("{mana} + 1") == "'much' + 1");
+  REQUIRE(parser.Evaluate("{mana} + 1") == parser.EvaluateInterpreted("{mana} + 1"));
+  REQUIRE(parser.Evaluate("10 / 0") == "10 / 0");
+}
+
+TEST_CASE("Test short-circuit evaluation", "[parser]") {
+  std::map<std::string, std::string> substitutes = {{"a", "0"}, {"b", "2"}};
+  std::map<std::string, size_t> substituted;
+  ExpressionParser parser([&](const std::string& str) { 
+    substituted[str]++; 
+    return substitutes.at(str); 
+  });
+
+  // Right operand not needed: not substituted
+  auto stats = ExpressionParser::substitution_stats();
+  REQUIRE(parser.Evaluate("({a} = 1) && ({b} = 2)") == "0");
+  REQUIRE(parser.Evaluate("{a} = 1 && {b}") == "0");
+  REQUIRE(parser.Evaluate("({a} = 0) || ({b} = 2)") == "1");
+  REQUIRE(substituted["a"] == 3);
+  REQUIRE(substituted["b"] == 0);
+  REQUIRE(ExpressionParser::substitution_stats()._resolved == stats._resolved + 3);
+  REQUIRE(ExpressionParser::substitution_stats()._skipped == stats._skipped + 3);
+
+  // Right operand needed
+  substitutes["a"] = "1";
+  REQUIRE(parser.Evaluate("({a} = 1) && ({b} = 2)") == "1");
+  REQUIRE(parser.Evaluate("({a} = 0) || ({b} = 3)") == "0");
+  REQUIRE(substituted["b"] == 2);
+
+  // Left to right, also if both operands are brackets
+  substitutes["a"] = "0";
+  substitutes["b"] = "none";
+  REQUIRE(parser.Evaluate("({a} > 0) && ({b} > 0)") == "0");
+  REQUIRE(parser.Evaluate("({a} > 0) || ({b} > 0)") == "('0' > 0) || ('none' > 0)");
+  REQUIRE(substituted["b"] == 3);
+}
+
+TEST_CASE("Test condition cache", "[parser]") {
+  auto mana = std::make_shared<ExpressionParser::Version>(0);
+  std::map<std::string, std::string> substitutes = {{"mana", "10"}, {"name", "Hund"}};
+  std::map<std::string, size_t> substituted;
+  std::unique_ptr<ExpressionParser> parser;
+  parser = std::make_unique<ExpressionParser>([&](const std::string& str) { 
+    substituted[str]++; 
+    if (str == "mana")
+      parser->DependsOn(mana);
+    else if (str == "#ran_num")
+      parser->NotMemoizable();
+    return substitutes.at(str); 
+  }, true);
+
+  // Cached until dependency changes
+  auto stats = ExpressionParser::condition_stats();
+  REQUIRE(parser->Evaluate("{mana} > 5") == "1");
+  REQUIRE(parser->Evaluate("{mana} > 5") == "1");
+  REQUIRE(substituted["mana"] == 1);
+  REQUIRE(ExpressionParser::condition_stats()._misses == stats._misses + 1);
+  REQUIRE(ExpressionParser::condition_stats()._hits == stats._hits + 1);
+  substitutes["mana"] = "2";
+  (*mana)++;
+  REQUIRE(parser->Evaluate("{mana} > 5") == "0");
+  REQUIRE(parser->Evaluate("{mana} > 5") == "0");
+  REQUIRE(substituted["mana"] == 2);
+
+  // Substitutes not declaring their dependencies (or not memoizable) are not cached
+  REQUIRE(parser->Evaluate("{name} = Hund") == "1");
+  REQUIRE(parser->Evaluate("{name} = Hund") == "1");
+  REQUIRE(substituted["name"] == 2);
+  REQUIRE(parser->Evaluate("({mana} < 5) && ({name} = Hund)") == "1");
+  REQUIRE(parser->Evaluate("({mana} < 5) && ({name} = Hund)") == "1");
+  REQUIRE(substituted["name"] == 4);
+  substitutes["#ran_num"] = "3";
+  (*mana)++;
+  parser->DependsOn(mana);  // (not evaluating: no-op)
+  REQUIRE(parser->Evaluate("{mana} + {#ran_num}") == "5");
+  REQUIRE(parser->Evaluate("{mana} + {#ran_num}") == "5");
+  REQUIRE(substituted["#ran_num"] == 2);
+
+  // Copies do not share cached conditions
+  ExpressionParser copy(*parser);
+  REQUIRE(copy.Evaluate("{mana} > 5") == "0");
+  REQUIRE(substituted["mana"] == 7);
+
+  // Parsers not caching conditions
+  ExpressionParser uncached([&](const std::string& str) { substituted[str]++; return substitutes.at(str); });
+  REQUIRE(uncached.Evaluate("{mana} > 5") == "0");
+  REQUIRE(uncached.Evaluate("{mana} > 5") == "0");
+  REQUIRE(substituted["mana"] == 9);
+
+  // Full cache: least recently used conditions are evicted
+  substituted["mana"] = 0;
+  REQUIRE(parser->Evaluate("{mana} > 0") == "1");
+  for (size_t i=0; i<ExpressionParser::MAX_CONDITIONS+10; i++) {
+    REQUIRE(parser->Evaluate("{mana} > " + std::to_string(i+10)) == "0");
+    REQUIRE(parser->Evaluate("{mana} > 0") == "1");
+  }
+  REQUIRE(substituted["mana"] == ExpressionParser::MAX_CONDITIONS+11);
+
+  // Versions of contexts and linked contexts
+  auto ctx = std::make_shared<Context>("room", "Room", "");
+  auto version = Context::VersionOf(ctx);
+  const uint64_t at = version->load();
+  ctx->set_name("Kitchen");
+  REQUIRE(version->load() > at);
+  ContextStack stack;
+  const uint64_t members = stack.members_version()->load();
+  stack.insert(ctx);
+  REQUIRE(stack.members_version()->load() > members);
+}
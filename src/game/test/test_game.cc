@@ -1,5 +1,6 @@
 #include "builder/game/builder_game.h"
 #include "game/game/game.h"
+#include "game/game/game_registry.h"
 #include "game/utils/defines.h"
 #include "shared/utils/defines.h"
 #include "shared/utils/parser/expression_parser.h"
@@ -7,11 +8,17 @@
 #include "shared/utils/test_helpers.h"
 #include "shared/utils/utils.h"
 #include "shared/objects/tests/test_case.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <catch2/catch_test_macros.hpp>
+#include <fmt/format.h>
 #include <map>
+#include <mutex>
 #include <nlohmann/json.hpp>
 #include <nlohmann/json_fwd.hpp>
 #include <string>
+#include <thread>
 #include <vector>
 
 TEST_CASE("Test Creating Game", "[game]") {
@@ -160,6 +167,39 @@ TEST_CASE("Test two games and multiple users (shared)", "[game]") {
     REQUIRE(game_1.contexts().at("general")->GetAttribute("counter").value_or("-1") == "1");
   }
 
+  SECTION ("Test two games created on other threads with own msg-fn") {
+    const std::string GAME_1_NAME = "test_game";
+    test::GameWrapper test_game_wrapper_1(GAME_1_NAME, settings, {{"", {ctx_general}}}, {});
+    const std::string GAME_2_NAME = "test_game_2";
+    test::GameWrapper test_game_wrapper_2(GAME_2_NAME, settings, {{"", {ctx_general}}}, {});
+
+    std::string cout_1 = "";
+    std::string cout_2 = "";
+    std::shared_ptr<Game> game_1;
+    std::shared_ptr<Game> game_2;
+    std::thread([&]() {
+      game_1 = std::make_shared<Game>(txtad::GamesPath() + GAME_1_NAME, GAME_1_NAME, 
+          [&cout_1](std::string, std::string txt) { cout_1 += txt; });
+      game_2 = std::make_shared<Game>(txtad::GamesPath() + GAME_2_NAME, GAME_2_NAME, 
+          [&cout_2](std::string, std::string txt) { cout_2 += txt; });
+    }).join();
+
+    const std::string USER_ID = "0x1234";
+    game_1->HandleEvent(USER_ID, "");
+    game_2->HandleEvent(USER_ID, "");
+
+    // Forwarders of game one still call into game one
+    game_1->HandleEvent(USER_ID, "increase-counter");
+    REQUIRE(game_1->contexts().at("general")->GetAttribute("counter").value_or("-1") == "1");
+    REQUIRE(game_2->contexts().at("general")->GetAttribute("counter").value_or("-1") == "0");
+
+    // Messages go to the game's own msg-fn
+    game_1->HandleEvent(USER_ID, "#> one");
+    game_2->HandleEvent(USER_ID, "#> two");
+    REQUIRE(cout_1 == "one");
+    REQUIRE(cout_2 == "two");
+  }
+
   SECTION ("Test one games and two user") {
     // Create game
     const std::string GAME_NAME = "test_game";
@@ -178,6 +218,245 @@ TEST_CASE("Test two games and multiple users (shared)", "[game]") {
     game.HandleEvent(G2_USER_ID, "increase-counter");
     REQUIRE(game.contexts().at("general")->GetAttribute("counter").value_or("-1") == "2");
   }
+
+  SECTION ("Test one games and two users in parallel") {
+    // Create game
+    const std::string GAME_NAME = "test_game";
+    const std::string GAME_PATH = txtad::GamesPath() + GAME_NAME;
+    test::GameWrapper test_game_wrapper(GAME_NAME, settings, {{"", {ctx_general}}}, {});
+    Game game(GAME_PATH, GAME_NAME);
+
+    // Create users
+    const std::vector<std::string> USER_IDS = {"0x1234", "0x1235", "0x1236", "0x1237"};
+    for (const auto& user_id : USER_IDS) {
+      game.HandleEvent(user_id, "");
+    }
+
+    // Each user increases the shared counter 50 times, all users at once
+    std::vector<std::thread> threads;
+    for (const auto& user_id : USER_IDS) {
+      threads.emplace_back([&game, user_id]() {
+        for (int i=0; i<50; i++) {
+          game.HandleEvent(user_id, "increase-counter");
+        }
+      });
+    }
+    for (auto& it : threads) {
+      it.join();
+    }
+    REQUIRE(game.contexts().at("general")->GetAttribute("counter").value_or("-1") == "200");
+  }
+}
+
+TEST_CASE("Test game executor", "[game]") {
+  const nlohmann::json settings = {
+    {"initial_events", ""},
+    {"initial_contexts", {"general"}}
+  };
+
+  const nlohmann::json ctx_general = {
+    {"id", "general"},
+    {"name", "General"},
+    {"description", "Some general handlers"},
+    {"attributes", {{"counter", "0"}}},
+    {"listeners", {
+      {{"id", "L1"}, {"re_event", "increase-counter"}, {"arguments", 
+        "#sa general.counter++"}, {"permeable", true}}
+    }},
+  };
+
+  const std::string GAME_NAME = "test_game";
+  const std::string GAME_PATH = txtad::GamesPath() + GAME_NAME;
+  test::GameWrapper test_game_wrapper(GAME_NAME, settings, {{"", {ctx_general}}}, {});
+  Game game(GAME_PATH, GAME_NAME);
+  REQUIRE(game.executor_stats()._handled == 0);
+
+  // Post events from several threads, wait for all to be handled
+  const std::vector<std::string> USER_IDS = {"0x1234", "0x1235", "0x1236"};
+  std::atomic<int> done = 0;
+  std::vector<std::thread> threads;
+  for (const auto& user_id : USER_IDS) {
+    threads.emplace_back([&game, &done, user_id]() {
+      game.Post(user_id, "", [&done]() { done++; });
+      for (int i=0; i<20; i++) {
+        game.Post(user_id, "increase-counter", [&done]() { done++; });
+      }
+    });
+  }
+  for (auto& it : threads) {
+    it.join();
+  }
+  while (done < 63) {
+    std::this_thread::yield();
+  }
+
+  REQUIRE(game.contexts().at("general")->GetAttribute("counter").value_or("-1") == "60");
+  const auto stats = game.executor_stats();
+  REQUIRE(stats._handled == 63);
+  REQUIRE(stats._queue_depth == 0);
+  REQUIRE(stats._max_queue_depth >= 1);
+  REQUIRE(stats._max_service_us <= stats._total_service_us);
+}
+
+TEST_CASE("Test game executor handles users in parallel", "[game]") {
+  // Two users on different workers: the first waits for the second one's event
+  std::string first = "0x1", second;
+  for (int i = 2; second.empty(); i++) {
+    if (std::hash<std::string>{}("0x" + std::to_string(i)) % 2 != std::hash<std::string>{}(first) % 2)
+      second = "0x" + std::to_string(i);
+  }
+  std::atomic<bool> second_handled = false;
+  std::atomic<bool> first_waited = false;
+  std::vector<std::string> order;
+  std::mutex order_mutex;
+  GameExecutor executor("test_executor", [&](const std::string& user_id, const std::string& event) {
+    if (user_id == first && event == "wait") {
+      auto start = std::chrono::steady_clock::now();
+      while (!second_handled && std::chrono::steady_clock::now() - start < std::chrono::seconds(5))
+        std::this_thread::yield();
+      first_waited = second_handled.load();
+    } else if (user_id == second) {
+      second_handled = true;
+    }
+    std::lock_guard lock(order_mutex);
+    order.push_back(user_id + ":" + event);
+  }, 2);
+  executor.Post(first, "wait");
+  executor.Post(first, "next");
+  executor.Post(second, "event");
+  executor.Stop();
+
+  REQUIRE(first_waited);
+  // Events of a user stay in order
+  auto wait = std::find(order.begin(), order.end(), first + ":wait");
+  REQUIRE(std::find(order.begin(), order.end(), first + ":next") > wait);
+  REQUIRE(executor.stats()._handled == 3);
+}
+
+TEST_CASE("Test game registry", "[game]") {
+  const nlohmann::json settings = {
+    {"initial_events", ""},
+    {"initial_contexts", {"general"}}
+  };
+
+  const nlohmann::json ctx_general = {
+    {"id", "general"},
+    {"name", "General"},
+    {"description", "Some general handlers"},
+    {"attributes", {{"counter", "0"}}},
+    {"listeners", {
+      {{"id", "L1"}, {"re_event", "increase-counter"}, {"arguments", 
+        "#sa general.counter++"}, {"permeable", true}}
+    }},
+  };
+
+  const std::string GAME_NAME = "test_game";
+  const std::string GAME_PATH = txtad::GamesPath() + GAME_NAME;
+  test::GameWrapper test_game_wrapper(GAME_NAME, settings, {{"", {ctx_general}}}, {});
+  GameRegistry games({{GAME_NAME, std::make_shared<Game>(GAME_PATH, GAME_NAME)}});
+  REQUIRE(games.get("unknown") == nullptr);
+
+  const std::string USER_ID = "0x1234";
+  auto old_game = games.get(GAME_NAME);
+  old_game->HandleEvent(USER_ID, "");
+  old_game->HandleEvent(USER_ID, "increase-counter");
+  auto old_snapshot = games.snapshot();
+
+  // Reload: new game is built while old game keeps running, then published
+  auto new_game = std::make_shared<Game>(GAME_PATH, GAME_NAME);
+  old_game->HandleEvent(USER_ID, "increase-counter");
+  REQUIRE(old_game->contexts().at("general")->GetAttribute("counter").value_or("-1") == "2");
+  games.Publish(GAME_NAME, new_game);
+  REQUIRE(games.get(GAME_NAME) == new_game);
+  REQUIRE(new_game->contexts().at("general")->GetAttribute("counter").value_or("-1") == "0");
+
+  // Old snapshot stays untouched
+  REQUIRE(old_snapshot->at(GAME_NAME) == old_game);
+
+  // Remove game
+  REQUIRE(games.Remove(GAME_NAME));
+  REQUIRE(!games.Remove(GAME_NAME));
+  REQUIRE(games.snapshot()->empty());
+}
+
+TEST_CASE("Test hot reload migrating users' state", "[game]") {
+  const nlohmann::json settings = {
+    {"initial_events", ""},
+    {"initial_contexts", {"general", "player"}}
+  };
+
+  nlohmann::json ctx_general = {
+    {"id", "general"},
+    {"name", "General"},
+    {"description", "Some general handlers"},
+    {"attributes", {{"counter", "0"}}},
+    {"listeners", {
+      {{"id", "L1"}, {"re_event", "hit"}, {"arguments", "#sa general.counter++;#sa player.hp--"}, 
+        {"permeable", true}}
+    }},
+  };
+  nlohmann::json ctx_player = {
+    {"id", "player"},
+    {"name", "Player"},
+    {"description", "The player"},
+    {"shared", false},
+    {"attributes", {{"hp", "10"}, {"mana", "5"}}},
+  };
+  nlohmann::json ctx_room = {
+    {"id", "room"},
+    {"name", "Room"},
+    {"description", "A room"},
+    {"shared", false},
+  };
+
+  const std::string GAME_NAME = "test_game";
+  const std::string GAME_PATH = txtad::GamesPath() + GAME_NAME;
+  auto test_game_wrapper = std::make_unique<test::GameWrapper>(GAME_NAME, settings, 
+      std::map<std::string, std::vector<nlohmann::json>>{{"", {ctx_general, ctx_player, ctx_room}}}, 
+      std::map<std::string, nlohmann::json>{});
+  Game game(GAME_PATH, GAME_NAME);
+
+  // Play: change shared and non-shared state, link context
+  const std::string USER_ID = "0x1234";
+  game.HandleEvent(USER_ID, "");
+  game.HandleEvent(USER_ID, "hit");
+  game.HandleEvent(USER_ID, "#ctx add room");
+  REQUIRE(game.contexts().at("general")->GetAttribute("counter").value_or("-1") == "1");
+  REQUIRE(game.cur_user()->contexts().at("player")->GetAttribute("hp").value_or("-1") == "9");
+
+  // Author edits game files
+  ctx_general["listeners"].push_back({{"id", "L2"}, {"re_event", "heal"}, {"arguments", "#sa player.hp++"}, 
+      {"permeable", true}});
+  ctx_player["attributes"] = {{"hp", "10"}, {"mana", "7"}, {"xp", "0"}};
+  ctx_room["name"] = "Hall";
+  test_game_wrapper.reset();
+  test_game_wrapper = std::make_unique<test::GameWrapper>(GAME_NAME, settings, 
+      std::map<std::string, std::vector<nlohmann::json>>{{"", {ctx_general, ctx_player, ctx_room}}}, 
+      std::map<std::string, nlohmann::json>{});
+
+  SECTION("Reload via HotReload") {
+    REQUIRE(game.HotReload());
+  }
+  SECTION("Reload via #reload game") {
+    game.HandleEvent(USER_ID, "#reload game");
+  }
+
+  auto user = game.cur_user();
+  REQUIRE(user);
+  REQUIRE(user->id() == USER_ID);
+  // Game-wide state is kept
+  REQUIRE(game.contexts().at("general")->GetAttribute("counter").value_or("-1") == "1");
+  // Runtime changes are kept, author's edits are applied otherwise
+  const auto& player = user->contexts().at("player");
+  REQUIRE(player->GetAttribute("hp").value_or("-1") == "9");
+  REQUIRE(player->GetAttribute("mana").value_or("-1") == "7");
+  REQUIRE(player->GetAttribute("xp").value_or("-1") == "0");
+  // Context stack is kept
+  REQUIRE(user->context_stack().exists("room"));
+  REQUIRE(user->contexts().at("room")->name() == "Hall");
+  // New definition is used
+  game.HandleEvent(USER_ID, "heal");
+  REQUIRE(player->GetAttribute("hp").value_or("-1") == "10");
 }
 
 TEST_CASE("Test two users and non-shared contexts", "[game]") {
@@ -216,6 +495,118 @@ TEST_CASE("Test two users and non-shared contexts", "[game]") {
     game.HandleEvent(USER_ID_2, "increase-counter");
     REQUIRE(game.cur_user()->contexts().at("general")->GetAttribute("counter").value_or("-1") == "1");
   }
+
+  SECTION ("Test contexts are copied on first modification") {
+    const std::string GAME_NAME = "test_game";
+    const std::string GAME_PATH = txtad::GamesPath() + GAME_NAME;
+    test::GameWrapper test_game_wrapper(GAME_NAME, settings, {{"", {ctx_general}}}, {});
+    Game game(GAME_PATH, GAME_NAME);
+
+    const std::string USER_ID = "0x1234";
+    game.HandleEvent(USER_ID, "");
+    auto user = game.cur_user();
+    // Unmodified: user references game's prototype
+    REQUIRE(user->contexts().at("general") == game.contexts().at("general"));
+
+    game.HandleEvent(USER_ID, "increase-counter");
+    auto own_ctx = user->contexts().at("general");
+    REQUIRE(own_ctx != game.contexts().at("general"));
+    REQUIRE(own_ctx->GetAttribute("counter").value_or("-1") == "1");
+    REQUIRE(game.contexts().at("general")->GetAttribute("counter").value_or("-1") == "0");
+    // Context stack uses the copy
+    REQUIRE(user->context_stack().get("general") == own_ctx);
+
+    // Further modifications use the same copy
+    game.HandleEvent(USER_ID, "increase-counter");
+    REQUIRE(user->contexts().at("general") == own_ctx);
+    REQUIRE(own_ctx->GetAttribute("counter").value_or("-1") == "2");
+  }
+}
+
+TEST_CASE("Test new users cloned from prototype", "[game]") {
+  const nlohmann::json ctx_general = {
+    {"id", "general"},
+    {"name", "General"},
+    {"description", "Some general handlers"},
+    {"attributes", {{"counter", "0"}}},
+    {"listeners", nlohmann::json::array()},
+  };
+  const nlohmann::json ctx_player = {
+    {"id", "player"},
+    {"name", "Hero"},
+    {"description", "The player"},
+    {"shared", false},
+    {"attributes", {{"visits", "0"}}},
+    {"listeners", {
+      {{"id", "L1"}, {"re_event", "visit"}, {"arguments", "#sa player.visits++"}, {"permeable", true}}
+    }},
+  };
+
+  const std::string GAME_NAME = "test_game";
+  const std::string GAME_PATH = txtad::GamesPath() + GAME_NAME;
+  std::map<std::string, std::vector<std::string>> msgs;
+  std::mutex msgs_mutex;
+  auto cout = [&msgs, &msgs_mutex](std::string user_id, std::string msg) {
+    std::lock_guard lock(msgs_mutex);
+    msgs[user_id].push_back(msg);
+  };
+
+  SECTION("Initial events independent of user") {
+    const nlohmann::json settings = {
+      {"initial_events", "#> Welcome {player->name};#sa player.visits++"},
+      {"initial_contexts", {"general", "player"}}
+    };
+    test::GameWrapper test_game_wrapper(GAME_NAME, settings, {{"", {ctx_general, ctx_player}}}, {});
+    Game game(GAME_PATH, GAME_NAME, cout);
+
+    game.HandleEvent("0x1", "");
+    game.HandleEvent("0x2", "");
+    // Pool is filled in background
+    for (int i=0; i<1000 && game.user_stats()._pooled < txtad::USER_POOL_SIZE; i++) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    REQUIRE(game.user_stats()._pooled == txtad::USER_POOL_SIZE);
+    game.HandleEvent("0x3", "");
+    game.HandleEvent("0x1", "visit");
+
+    const auto stats = game.user_stats();
+    REQUIRE(stats._cloned == 3);
+    REQUIRE(stats._initialized == 0);
+    std::lock_guard lock(msgs_mutex);
+    for (const auto& [user_id, visits] : std::map<std::string, std::string>{{"0x1", "2"}, {"0x2", "1"}, {"0x3", "1"}}) {
+      REQUIRE(msgs[user_id] == std::vector<std::string>{"Welcome Hero"});
+      game.HandleEvent(user_id, "");
+      REQUIRE(game.cur_user()->id() == user_id);
+      REQUIRE(game.cur_user()->contexts().at("player")->GetAttribute("visits").value_or("-1") == visits);
+      REQUIRE(game.cur_user()->context_stack().exists("player"));
+    }
+    REQUIRE(game.contexts().at("player")->GetAttribute("visits").value_or("-1") == "0");
+  }
+
+  SECTION("Initial events changing game-wide state or depending on user") {
+    for (const std::string initial_events : {"#sa general.counter++", "#> Hi #uid", "#> {#ran_num|1|10}"}) {
+      const nlohmann::json settings = {
+        {"initial_events", initial_events},
+        {"initial_contexts", {"general", "player"}}
+      };
+      test::GameWrapper test_game_wrapper(GAME_NAME, settings, {{"", {ctx_general, ctx_player}}}, {});
+      Game game(GAME_PATH, GAME_NAME, cout);
+
+      game.HandleEvent("0x1", "");
+      game.HandleEvent("0x2", "");
+      game.HandleEvent("0x3", "");
+
+      const auto stats = game.user_stats();
+      REQUIRE(stats._cloned == 0);
+      REQUIRE(stats._initialized == 3);
+      if (initial_events == "#sa general.counter++") {
+        REQUIRE(game.contexts().at("general")->GetAttribute("counter").value_or("-1") == "3");
+      } else if (initial_events == "#> Hi #uid") {
+        std::lock_guard lock(msgs_mutex);
+        REQUIRE(msgs["0x2"] == std::vector<std::string>{"Hi 0x2"});
+      }
+    }
+  }
 }
 
 TEST_CASE("Test Game handlers/mechanics", "[game]") {
@@ -580,6 +971,57 @@ TEST_CASE("Test exec listeners", "[game]") {
   }
 }
 
+TEST_CASE("Test event budget aborts runaway event chains", "[game]") {
+  const nlohmann::json settings = {
+    {"initial_events", ""},
+    {"initial_contexts", {"general"}},
+    {"event_budget", {{"max_events", 100}, {"max_queue_length", 50}}}
+  };
+
+  const nlohmann::json ctx_general = {
+    {"id", "general"},
+    {"name", "General"},
+    {"description", "Some general handlers"},
+    {"attributes", {{"counter", "0"}}},
+    {"listeners", {
+      {{"id", "L1"}, {"re_event", "ping"}, {"arguments", "pong"}, {"permeable", true}},
+      {{"id", "L2"}, {"re_event", "pong"}, {"arguments", "ping"}, {"permeable", true}},
+      {{"id", "L3"}, {"re_event", "spam"}, {"arguments", "spam;spam"}, {"permeable", true}},
+      {{"id", "L4"}, {"re_event", "nested"}, {"arguments", "ping"}, {"exec", true}, {"permeable", true}},
+      {{"id", "L5"}, {"re_event", "increase-counter"}, {"arguments", "#sa general.counter++"}, 
+        {"permeable", true}},
+    }},
+  };
+
+  const std::string GAME_NAME = "test_game";
+  const std::string GAME_PATH = txtad::GamesPath() + GAME_NAME;
+  test::GameWrapper test_game_wrapper(GAME_NAME, settings, {{"", {ctx_general}}}, {});
+  std::vector<std::string> msgs;
+  Game game(GAME_PATH, GAME_NAME, [&msgs](std::string user_id, std::string msg) { msgs.push_back(msg); });
+  REQUIRE(game.settings().event_budget()._max_events == 100);
+
+  const std::string USER_ID = "0x1234";
+  game.HandleEvent(USER_ID, "");
+  std::string event;
+  SECTION("Listeners forwarding to each other") {
+    event = "ping";
+  }
+  SECTION("Queue growing") {
+    event = "spam";
+  }
+  SECTION("Cycle inside exec listener") {
+    event = "nested";
+  }
+  game.HandleEvent(USER_ID, event);
+  REQUIRE(game.aborted_chains() == 1);
+  REQUIRE(msgs.size() == 1);
+  REQUIRE(msgs.back().find("stopped") != std::string::npos);
+  // User can continue
+  game.HandleEvent(USER_ID, "increase-counter");
+  REQUIRE(game.contexts().at("general")->GetAttribute("counter").value_or("-1") == "1");
+  REQUIRE(game.aborted_chains() == 1);
+}
+
 TEST_CASE("Test game-tests", "[game]") {
   const nlohmann::json settings = {
     {"initial_events", ""},
@@ -1088,3 +1530,42 @@ TEST_CASE("Test multi print", "[game]") {
     REQUIRE(get_cout() == "char_info: 10");
   }
 }
+
+TEST_CASE("Test parsed context selectors", "[game]") {
+  auto selector = User::Select("room");
+  REQUIRE(selector._kind == User::ContextSelector::ID);
+  REQUIRE(selector._id == "room");
+  REQUIRE_FALSE(selector._query);
+  REQUIRE_FALSE(selector._random);
+
+  selector = User::Select("*char[#ran]");
+  REQUIRE(selector._kind == User::ContextSelector::LINKED);
+  REQUIRE(selector._id == "char");
+  REQUIRE_FALSE(selector._query);
+  REQUIRE(selector._random);
+
+  // Relative members are expanded once, split at the context-id
+  selector = User::Select("**users[.poisened > 0 && .name = 'a.b', #ran]");
+  REQUIRE(selector._kind == User::ContextSelector::ALL);
+  REQUIRE(selector._id == "users");
+  REQUIRE(selector._random);
+  REQUIRE(selector._query == std::vector<std::string>{"({", ".poisened} > 0 )&&( {", ".name} = 'a.b')"});
+
+  // Invalid queries match no context
+  REQUIRE(User::Select("**users[.poisened > 'a]")._query == std::vector<std::string>{});
+
+  // Random choices are not cached by the evaluating parser
+  std::map<std::string, std::shared_ptr<Context>> contexts = {
+    {"a", std::make_shared<Context>("a", "A", "")}, {"b", std::make_shared<Context>("b", "B", "")}};
+  User user("game", "0x1", [](std::string) {}, contexts, {}, {"a", "b"});
+  const auto random = User::Select("**[#ran]");
+  size_t substituted = 0;
+  std::unique_ptr<ExpressionParser> parser;
+  parser = std::make_unique<ExpressionParser>([&](const std::string&) {
+    substituted++;
+    return user.PrintCtx(random, "id", *parser);
+  }, true);
+  parser->Evaluate("{ctx} = a");
+  parser->Evaluate("{ctx} = a");
+  REQUIRE(substituted == 2);
+}
@@ -1,8 +1,14 @@
 #include "game/utils/defines.h"
 #include "shared/utils/fuzzy_search/fuzzy.h"
+#include "shared/utils/fuzzy_search/name_index.h"
+#include "shared/utils/mpsc_queue.h"
 #include "shared/utils/parser/game_file_parser.h"
+#include "shared/utils/regex/automaton.h"
 #include "shared/utils/utils.h"
 #include <catch2/catch_test_macros.hpp>
+#include <regex>
+#include <string>
+#include <thread>
 #include <unordered_set>
 #include <vector>
 
@@ -49,6 +55,43 @@ TEST_CASE("Test fuzzy search", "[utils]") {
   REQUIRE(fuzzy::fuzzy(B, A) == fuzzy::FuzzyMatch::FUZZY);
 }
 
+TEST_CASE("Test fuzzy name index", "[utils]") {
+  const std::vector<std::string> names = {"Heiltrank", "heiltrank", "Manatrank", "Trank", "Elefant", 
+    "Elephant", "Schwert", "Schwertscheide", "Tür", "Tor", "Ei", "", "Kiste", "kleine Kiste", "Kisten"};
+  const std::vector<std::string> args = {"heiltrank", "Heiltrnk", "trank", "tran", "elefant", "schwer", 
+    "Schwerter", "scheide", "tür", "to", "ei", "", "kiste", "kisde", "x", "kleine kiste", "Manatrankk"};
+  fuzzy::NameIndex index;
+  for (const auto& name : names)
+    index.Add(name);
+  index.Add("Trank");
+  REQUIRE(index.size() == names.size());
+
+  SECTION("equals fuzzy") {
+    for (const auto& arg : args) {
+      for (const auto& name : names) {
+        INFO(name << " ~ " << arg);
+        REQUIRE(index.Match(name, arg) == fuzzy::fuzzy(name, arg));
+      }
+      for (const auto& [name, match] : index.Query(arg))
+        REQUIRE(match != fuzzy::FuzzyMatch::NO_MATCH);
+    }
+  }
+
+  SECTION("removing names") {
+    REQUIRE(index.Query("trank").count("Trank") == 1);
+    index.Remove("Trank");
+    REQUIRE(index.contains("Trank"));
+    index.Remove("Trank");
+    REQUIRE(!index.contains("Trank"));
+    REQUIRE(index.Query("trank").count("Trank") == 0);
+    REQUIRE(index.Query("trank").count("Heiltrank") == 1);
+    // Not indexed: matched directly
+    REQUIRE(index.Match("Trank", "trank") == fuzzy::FuzzyMatch::DIRECT);
+    index.Add("Trank");
+    REQUIRE(index.Query("trank").at("Trank") == fuzzy::FuzzyMatch::DIRECT);
+  }
+}
+
 TEST_CASE("Test GetUserId" "[util]") {
   const std::string USER_ID = "0x7f4fd40074b0";
   const std::string INP_PART = "Fuck you!"; 
@@ -119,3 +162,154 @@ TEST_CASE("Test ran range bounds", "[utils]") {
     REQUIRE(ticked.contains(it));
   }
 }
+
+TEST_CASE("Test MPSCQueue", "[utils]") {
+  util::MPSCQueue<std::string> queue;
+  REQUIRE(!queue.Pop());
+
+  SECTION("Single producer keeps order") {
+    queue.Push("a");
+    queue.Push("b");
+    REQUIRE(queue.Pop().value_or("") == "a");
+    REQUIRE(queue.Pop().value_or("") == "b");
+    REQUIRE(!queue.Pop());
+  }
+
+  SECTION("Multiple producers: every value is taken exactly once, in order per producer") {
+    const int PRODUCERS = 4;
+    const int VALUES = 1000;
+    std::vector<std::thread> producers;
+    for (int p=0; p<PRODUCERS; p++) {
+      producers.emplace_back([&queue, p]() {
+        for (int i=0; i<VALUES; i++) 
+          queue.Push(std::to_string(p) + ":" + std::to_string(i));
+      });
+    }
+    std::vector<int> last(PRODUCERS, -1);
+    int taken = 0;
+    while (taken < PRODUCERS*VALUES) {
+      if (auto value = queue.Pop()) {
+        auto pos = value->find(":");
+        int p = std::stoi(value->substr(0, pos));
+        int i = std::stoi(value->substr(pos+1));
+        REQUIRE(i == last[p]+1);
+        last[p] = i;
+        taken++;
+      }
+    }
+    for (auto& it : producers) {
+      it.join();
+    }
+    REQUIRE(!queue.Pop());
+  }
+}
+
+TEST_CASE("Test regex automaton equals std::regex", "[utils]") {
+  const std::vector<std::string> patterns = {
+    "", "abc", "a|b|", "(a|ab)(c|bcd)(d*)", "go to (.*)", "(.*) (.*)", "(.*?) (.*)", "^(?!#)(.*)",
+    "(?=a)(.*)", "#sa (.*)", "y|yes", "(a)|b", "x(a)?y", "([^|]+)\\|([^|]+)\\|(.*)", "[a-c]+d{2}",
+    "a{2,}", "a{1,3}?(a*)", "(?:ab)+(b?)", "[-a]|[a-]|[\\d\\s]+", "\\w+\\W\\w*", ".", "a.c$",
+    "(a*)b|(a*)", "ab?c?", "(?:a|b)*?(b*)", "[^a\\n]*", "(\\.)\\*", "(ab|a)?(b*)", "(?:(a)|b)?c?",
+  };
+  const std::string alphabet = "ab cd#|.*\n";
+  std::vector<std::string> inputs = {"", "go to closet", "#sa mana=20", "a b c", "abcd", "abd", "aabb",
+    "abbd", "aad", "12 ab", "7 \t x", "x1y"};
+  // All strings of up to three characters of the alphabet
+  std::vector<std::string> level = {""};
+  for (int len = 1; len <= 3; len++) {
+    std::vector<std::string> next;
+    for (const auto& prefix : level) {
+      for (char c : alphabet)
+        next.push_back(prefix + c);
+    }
+    inputs.insert(inputs.end(), next.begin(), next.end());
+    level = next;
+  }
+
+  SECTION("Matches and captures equal std::regex") {
+    for (const auto& pattern : patterns) {
+      auto automaton = util::RegexAutomaton::Compile(pattern);
+      INFO(pattern);
+      REQUIRE(automaton);
+      std::regex regex(pattern);
+      for (const auto& input : inputs) {
+        INFO(input);
+        std::smatch match;
+        bool expected = std::regex_match(input, match, regex);
+        std::vector<std::string> captures;
+        REQUIRE(automaton->Match(input, &captures) == expected);
+        REQUIRE(automaton->Match(input) == expected);
+        if (expected) {
+          REQUIRE(captures.size() == match.size());
+          for (size_t i = 0; i < match.size(); i++)
+            REQUIRE(captures[i] == match[i].str());
+        }
+      }
+    }
+  }
+
+  SECTION("Long inputs are matched without backtracking") {
+    auto automaton = util::RegexAutomaton::Compile("(?:(.*) (.*)|(x*))");
+    const std::string input = std::string(100000, 'x') + " " + std::string(100000, 'y');
+    std::vector<std::string> captures;
+    REQUIRE(automaton->Match(input, &captures));
+    REQUIRE(captures == std::vector<std::string>{input, std::string(100000, 'x'), std::string(100000, 'y'), ""});
+    REQUIRE(automaton->Match(std::string(200000, 'x'), &captures));
+    REQUIRE(captures[3].length() == 200000);
+    REQUIRE_FALSE(automaton->Match(input + "\n"));
+  }
+
+  SECTION("Unsupported syntax falls back to std::regex") {
+    for (const std::string pattern : {"(a)\\1", "\\bab", "(a|b)+", "(a*)?", "[[:alpha:]]", "a{", "(?<=a)b"})
+      REQUIRE_FALSE(util::RegexAutomaton::Compile(pattern));
+
+    util::Regex regex("(a|b)+c");
+    std::vector<std::string> captures;
+    REQUIRE(regex.Match("abbc", &captures));
+    REQUIRE(captures == std::vector<std::string>{"abbc", "b"});
+  }
+
+  SECTION("Literal prefix") {
+    REQUIRE(util::RegexAutomaton::Compile("go to (.*)")->prefix() == "go to ");
+    REQUIRE(util::RegexAutomaton::Compile("(?:#sa )(x|y)")->prefix() == "#sa ");
+    REQUIRE(util::RegexAutomaton::Compile("ab+c")->prefix() == "ab");
+    REQUIRE(util::RegexAutomaton::Compile("a?b")->prefix() == "");
+    REQUIRE(util::RegexAutomaton::Compile("y|yes")->prefix() == "");
+    REQUIRE(util::RegexAutomaton::Compile("^(?!#)(.*)")->prefix() == "");
+    REQUIRE(util::Regex("show *items").prefix() == "show *items");
+  }
+
+  SECTION("Regex keeps escaping") {
+    REQUIRE(util::Regex("show *items").Match("show *items"));
+    REQUIRE_FALSE(util::Regex("show *items").Match("showitems"));
+    REQUIRE(util::Regex("go.*").Match("go to"));
+    REQUIRE(util::Regex("<user-inp>").Match("hello"));
+    REQUIRE_FALSE(util::Regex("<user-inp>").Match("#sa hello"));
+  }
+}
+
+TEST_CASE("Test regex interning", "[utils]") {
+  const size_t interned = util::Regex::interned();
+  {
+    util::Regex a("interned (.*) pattern");
+    util::Regex b("interned (.*) pattern");
+    REQUIRE(util::Regex::interned() == interned + 1);
+    // Same escaped pattern: shared, too
+    util::Regex c("interned *");
+    util::Regex d("interned \\*");
+    REQUIRE(util::Regex::interned() == interned + 2);
+    REQUIRE(c.str() != d.str());
+    REQUIRE(c.Match("interned *"));
+    REQUIRE(d.Match("interned *"));
+
+    // Copies share compiled pattern
+    std::vector<util::Regex> copies(100, a);
+    REQUIRE(util::Regex::interned() == interned + 2);
+    std::vector<std::string> captures;
+    REQUIRE(copies.back().Match("interned 1 pattern", &captures));
+    REQUIRE(captures == std::vector<std::string>{"interned 1 pattern", "1"});
+    REQUIRE(b.prefix() == "interned ");
+  }
+  // Released when no longer used
+  REQUIRE(util::Regex::interned() == interned);
+}
@@ -1,6 +1,8 @@
 #include "defines.h"
 #include "builder/utils/defines.h"
 #include "shared/utils/utils.h"
+#include <algorithm>
+#include <thread>
 
 const std::string& txtad::GamesPath() {
   static const std::string path = util::LoadJsonFromDisc(builder::CONFIG)->at("txtad").at("games_path");
@@ -16,3 +18,15 @@ const std::string& txtad::TmpPath() {
   static const std::string path = util::LoadJsonFromDisc(builder::CONFIG)->at("txtad").at("tmp_path");
   return path;
 }
+
+size_t txtad::WssThreads() {
+  static const size_t threads = util::LoadJsonFromDisc(builder::CONFIG)->at("txtad").value("wss_threads", 
+      std::max(1u, std::thread::hardware_concurrency()));
+  return threads;
+}
+
+size_t txtad::GameThreads() {
+  static const size_t threads = util::LoadJsonFromDisc(builder::CONFIG)->at("txtad").value("game_threads", 
+      std::clamp(std::thread::hardware_concurrency(), 1u, 4u));
+  return threads;
+}
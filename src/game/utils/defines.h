@@ -1,6 +1,7 @@
 #ifndef SRC_GAME_UTILS_DEFINES_H
 #define SRC_GAME_UTILS_DEFINES_H 
 
+#include <cstddef>
 #include <functional>
 #include <set>
 #include <string>
@@ -16,6 +17,8 @@ namespace txtad {
   const std::string& GamesPath();
   const std::string& LoggerPath();
   const std::string& TmpPath();
+  size_t WssThreads();  ///< threads running the websocket server ("wss_threads", defaults to number of cores)
+  size_t GameThreads();  ///< worker threads per game ("game_threads", defaults to number of cores, at most 4)
   const std::string GAME_SETTINGS = "settings.json";
   const std::string GAME_TESTS = "tests.json";
   const std::string GAME_FILES = "game_files/";
@@ -50,6 +53,10 @@ namespace txtad {
   // Other cmds
   const std::string NEW_CONNECTION = "#new_connection";
   const std::string REMOVE_USER = "#remove_user";
+
+  // Pre-built users
+  const std::string PROTOTYPE_USER_ID = "#user_prototype";
+  const size_t USER_POOL_SIZE = 4;  ///< users kept ready (cloned from prototype) per game
 };
 
 #endif
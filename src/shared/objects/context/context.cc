@@ -17,6 +17,7 @@ std::string Context::id() const {
 }
 
 std::string Context::name() const {
+  std::shared_lock sl(_mutex);
   return _name;
 }
 
@@ -27,7 +28,8 @@ const std::shared_ptr<Text> Context::description() const {
 std::string Context::entry_condition_pattern() const {
   return _entry_condition.str();
 }
-const std::map<std::string, std::string>& Context::attributes() const {
+std::map<std::string, std::string> Context::attributes() const {
+  std::shared_lock sl(_mutex);
   return _attributes;
 }
 int Context::priority() const {
@@ -42,23 +44,36 @@ bool Context::shared() const {
 const std::map<std::string, std::shared_ptr<Listener>>& Context::listeners() const {
   return _event_manager->listeners();
 }
+uint64_t Context::version() const {
+  return _version + ((_description) ? _description->version() : 0);
+}
+uint64_t Context::listeners_version() const {
+  return _event_manager->version();
+}
+std::shared_ptr<const std::atomic<uint64_t>> Context::VersionOf(const std::shared_ptr<Context>& ctx) {
+  return std::shared_ptr<const std::atomic<uint64_t>>(ctx, &ctx->_version);
+}
 
 // ***** ***** Setters ***** ***** //
 void Context::set_name(const std::string& name) {
+  std::unique_lock ul(_mutex);
   _name = name;
+  _version++;
 }
 
 void Context::set_description(std::shared_ptr<Text> txt) {
   _description = txt;
+  _version++;
 }
 
 void Context::set_entry_condition(const std::string& pattern) {
   _entry_condition = util::Regex(pattern);
+  _version++;
 }
 
   // ***** ***** String representation of the class ***** ***** //
 std::string Context::ToString() const {
-  return "Name: " + _name + "\n" + "Description: " + _description->txt() + "\n" + "Entry Condition (regex): " + _entry_condition.str();
+  return "Name: " + name() + "\n" + "Description: " + _description->txt() + "\n" + "Entry Condition (regex): " + _entry_condition.str();
 }
 
 std::string Context::PrintDescription(std::string& event_queue, const ExpressionParser& parser) {
@@ -67,19 +82,32 @@ std::string Context::PrintDescription(std::string& event_queue, const Expression
   
   // ***** ***** Entry check ***** ***** //
 bool Context::CheckEntry(const std::string& test) const {
-  return std::regex_match(test, static_cast<std::regex>(_entry_condition));
+  return _entry_condition.Match(test);
 }
 
   // ***** ***** Attribute methods ***** ***** //
 bool Context::SetAttribute(const std::string& key, const std::string& value) {
+  std::unique_lock ul(_mutex);
   if (_attributes.count(key) > 0) {
     _attributes[key] = value;
+    _version++;
     return true;
   }
   return false;
 }
 
+bool Context::UpdateAttribute(const std::string& key, const std::function<std::string(const std::string&)>& fn) {
+  std::unique_lock ul(_mutex);
+  auto it = _attributes.find(key);
+  if (it == _attributes.end()) 
+    return false;
+  it->second = fn(it->second);
+  _version++;
+  return true;
+}
+
 std::optional<std::string> Context::GetAttribute(const std::string& key) const {
+  std::shared_lock sl(_mutex);
   auto it = _attributes.find(key);
   if (it != _attributes.end()) {
     return it->second;
@@ -88,36 +116,46 @@ std::optional<std::string> Context::GetAttribute(const std::string& key) const {
 }
 		 
 bool Context::RemoveAttribute(const std::string& key) {
+  std::unique_lock ul(_mutex);
   auto it = _attributes.find(key);
   if (it != _attributes.end()) {
     _attributes.erase(key);
+    _version++;
     return true;
   }
   return false;
 }
 
 bool Context::AddAttribute(const std::string& key, std::string initial_value) {
+  std::unique_lock ul(_mutex);
   if (_attributes.count(key) > 0) {
     util::Logger()->debug("Context::AddAttribute: attribute {} already exists", key);
     return false;
   }
   _attributes[key] = initial_value;
+  _version++;
   return true;
 }
 
 bool Context::HasAttribute(const std::string& key) const {
+  std::shared_lock sl(_mutex);
   return _attributes.count(key) > 0;
 }
   
   // ***** ***** Listener methods calling EventManager ***** ***** //
 
-bool Context::TakeEvent(std::string event, const ExpressionParser& parser) {
-  return _event_manager->TakeEvent(event, parser);
+bool Context::TakeEvent(std::string event, const ExpressionParser& parser, User* user) {
+  return _event_manager->TakeEvent(event, parser, user);
+}
+
+std::vector<std::shared_ptr<Listener>> Context::Candidates(const std::string& event) const {
+  return _event_manager->Candidates(event);
 }
 
 void Context::AddListener(std::shared_ptr<Listener> listener) {
   if (_event_manager) {
     _event_manager->AddListener(listener);
+    _version++;
   } else {
     util::Logger()->error("Context::AddListener: event_manager does not exist for listener {}", 
         listener->id());
@@ -127,6 +165,7 @@ void Context::AddListener(std::shared_ptr<Listener> listener) {
 void Context::RemoveListener(const std::string& id) {
   if (_event_manager) {
     _event_manager->RemoveListener(id);
+    _version++;
   } else {
     util::Logger()->error("Context::RemoveListener: event_manager does not exist for id {}", id);
   }
@@ -141,17 +180,35 @@ std::vector<std::weak_ptr<Context>> Context::LinkedContexts(std::string type) {
   return linked_contexts;
 }
 
+void Context::MigrateState(const Context& old_state, const Context* old_definition) {
+  const std::string name = old_state.name();
+  if (!old_definition || old_definition->name() != name)
+    set_name(name);
+  const auto definition_attributes = (old_definition) ? old_definition->attributes() 
+    : std::map<std::string, std::string>();
+  for (const auto& [key, value] : old_state.attributes()) {
+    auto it = definition_attributes.find(key);
+    if (old_definition && it != definition_attributes.end() && it->second == value)
+      continue;
+    if (!SetAttribute(key, value))
+      AddAttribute(key, value);
+  }
+  if (_description && old_state._description)
+    _description->MigrateState(*old_state._description);
+}
+
 void Context::UpdateMeta(std::string name, std::string entry_condition_pattern, int priority, 
       bool permeable, bool shared) {
-  _name = name; 
+  set_name(name);
   _entry_condition = util::Regex(entry_condition_pattern);
   _priority = priority; 
   _permeable = permeable; 
   _shared = shared;
+  _version++;
 }
 nlohmann::json Context::json() const {
-  nlohmann::json j = {{"id", _id}, {"name", _name}, {"description", _description->json()}, 
-    {"re_entrycondition", _entry_condition.str()}, {"attributes", _attributes}, {"priority", _priority}, 
+  nlohmann::json j = {{"id", _id}, {"name", name()}, {"description", _description->json()}, 
+    {"re_entrycondition", _entry_condition.str()}, {"attributes", attributes()}, {"priority", _priority}, 
     {"permeable", _permeable}, {"shared", _shared}, {"listeners", nlohmann::json::array()} };
   for (const auto& it : _event_manager->listeners()) {
     j["listeners"].push_back(it.second->json());
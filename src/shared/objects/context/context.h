@@ -5,16 +5,21 @@
 #include "shared/utils/eventmanager/eventmanager.h"
 #include "shared/utils/eventmanager/listener.h"
 #include "shared/utils/utils.h"
+#include <atomic>
+#include <cstdint>
 #include <nlohmann/json.hpp>
 #include <string>
 #include <map>
+#include <functional>
 #include <memory>
 #include <optional>
+#include <shared_mutex>
 
   // ***** ***** Forward Declarations ***** ***** //
 class EventManager;
 class Listener;
 class ExpressionParser;
+class User;
 
   // ***** ***** Constructor ***** ***** //
 class Context {
@@ -22,7 +27,7 @@ class Context {
 public:
   Context(const std::string& id, int priority, bool permeable=true) : _id(id), _name(""), 
       _description(std::make_shared<Text>(std::string(""))), _entry_condition(""), 
-      _priority(priority), _permeable(permeable), _shared(true),
+      _priority(priority), _permeable(permeable), _shared(true), _version(0),
       _event_manager(std::make_unique<EventManager>()) {
     util::Logger()->debug("Context. Context {} created", id); 
   }
@@ -31,7 +36,7 @@ public:
       const std::string& entry_condition_pattern="", int priority=0, bool permeable=true)
     : _id(id), _name(name), _description(std::make_shared<Text>(description)),
       _entry_condition(entry_condition_pattern), _priority(priority), _permeable(permeable), 
-      _shared(true), _event_manager(std::make_unique<EventManager>()) {
+      _shared(true), _version(0), _event_manager(std::make_unique<EventManager>()) {
     util::Logger()->debug("Context. Context \"{}\" created", _id); 
   }
 
@@ -39,14 +44,14 @@ public:
     : _id(id), _name(json.at("name")), _description(text), _entry_condition(json.value("re_entrycondition", "")),
       _attributes(json.value("attributes", std::map<std::string, std::string>())), 
       _priority(json.value("priority", 0)), _permeable(json.value("permeable", false)), _shared(json.value("shared", true)),
-      _event_manager(std::make_unique<EventManager>()) {
+      _version(0), _event_manager(std::make_unique<EventManager>()) {
     util::Logger()->debug("Context. Context {} created", _id); 
   }
 
-  Context(const Context& other) : _id(other._id), _name(other._name), 
+  Context(const Context& other) : _id(other._id), _name(other.name()), 
     _description(std::make_shared<Text>(*other._description)), _entry_condition(other.entry_condition_pattern()), 
-    _attributes(other._attributes), _priority(other._priority), _permeable(other._permeable), 
-    _event_manager(other._event_manager 
+    _attributes(other.attributes()), _priority(other._priority), _permeable(other._permeable), 
+    _shared(other._shared), _version(0), _event_manager(other._event_manager 
         ? std::make_unique<EventManager>(*other._event_manager) 
         : std::make_unique<EventManager>()) {}
 
@@ -59,11 +64,22 @@ public:
   std::string name() const;
   const std::shared_ptr<Text> description() const;
   std::string entry_condition_pattern() const;
-  const std::map<std::string, std::string>& attributes() const;
+  std::map<std::string, std::string> attributes() const; ///< copy, as shared contexts may change concurrently
   int priority() const;
   bool permeable() const;
   bool shared() const;
   const std::map<std::string, std::shared_ptr<Listener>>& listeners() const;
+  /**
+   * Increases with every modification (incl. its description), f.e. to detect
+   * whether state derived from this context is outdated.
+   */
+  uint64_t version() const;
+  uint64_t listeners_version() const;  ///< increases when listeners are added/ removed
+  /**
+   * Version of ctx's name, attributes and listeners (not its description),
+   * sharing ownership of ctx (see ExpressionParser::DependsOn).
+   */
+  static std::shared_ptr<const std::atomic<uint64_t>> VersionOf(const std::shared_ptr<Context>& ctx);
 
   // ***** ***** Setters ***** ***** //
   void set_name(const std::string& name);
@@ -79,13 +95,21 @@ public:
 
   // ***** ***** Attribute methods ***** ***** //
   bool SetAttribute(const std::string& key, const std::string& value);
+  /**
+   * Atomically replaces the value of an existing attribute by fn(current-value).
+   * (Read-modify-write for shared contexts, which are used by multiple users)
+   * @return false if attribute does not exist.
+   */
+  bool UpdateAttribute(const std::string& key, const std::function<std::string(const std::string&)>& fn);
   std::optional<std::string> GetAttribute(const std::string& key) const;
   bool RemoveAttribute(const std::string& key);
   bool AddAttribute(const std::string& key, std::string initial_value=""); 
   bool HasAttribute(const std::string& key) const;
   
   // ***** ***** Listener methods calling EventManager ***** ***** //
-  bool TakeEvent(std::string event, const ExpressionParser& parser);
+  bool TakeEvent(std::string event, const ExpressionParser& parser, User* user=nullptr);
+  /** Listeners, which might accept event (see EventManager::Candidates). */
+  std::vector<std::shared_ptr<Listener>> Candidates(const std::string& event) const;
 
   void AddListener(std::shared_ptr<Listener> listener); ///< also for modifying
   // void AddListener(const nlohmann::json& listener);
@@ -93,6 +117,13 @@ public:
 
   std::vector<std::weak_ptr<Context>> LinkedContexts(std::string type);
 
+  /**
+   * Takes over runtime state (name, attributes, description) of the same
+   * context of a previous game definition. If the old definition is given,
+   * only values changed at runtime are taken (keeping the author's edits).
+   */
+  void MigrateState(const Context& old_state, const Context* old_definition=nullptr);
+
   void UpdateMeta(std::string name, std::string entry_condition_pattern, int priority, 
       bool permeable, bool shared);
   nlohmann::json json() const;
@@ -107,8 +138,11 @@ private:
   int _priority;
   bool _permeable;
   bool _shared;
+  std::atomic<uint64_t> _version;
 
   std::unique_ptr<EventManager> _event_manager;
+
+  mutable std::shared_mutex _mutex;  ///< Guards name and attributes (shared contexts are used by all users)
 };
 
 #endif
@@ -1,29 +1,53 @@
 #ifndef SRC_SHARED_OBJECTS_SETTINGS_H_
 #define SRC_SHARED_OBJECTS_SETTINGS_H_
 
+#include <cstddef>
 #include <nlohmann/json.hpp>
 #include <string>
 #include <vector>
 
 namespace txtad {
+  /**
+   * Limits for the chain of events caused by one input (aborted if exceeded,
+   * f.e. listeners forwarding to each other).
+   */
+  struct EventBudget {
+    size_t _max_events = 10000;  ///< events handled
+    size_t _max_queue_length = 1000;  ///< events pending
+    int _max_time_ms = 2000;  ///< wall time
+
+    EventBudget() {}
+    EventBudget(const nlohmann::json& json) : _max_events(json.value("max_events", EventBudget()._max_events)),
+        _max_queue_length(json.value("max_queue_length", EventBudget()._max_queue_length)), 
+        _max_time_ms(json.value("max_time_ms", EventBudget()._max_time_ms)) {}
+
+    nlohmann::json ToJson() const {
+      return {{"max_events", _max_events}, {"max_queue_length", _max_queue_length}, {"max_time_ms", _max_time_ms}};
+    }
+  };
+
   class Settings {
     public: 
       Settings() {}
       Settings(const nlohmann::json& json) : _initial_events(json.at("initial_events")), 
-          _initial_ctx_ids(json.at("initial_contexts").get<std::vector<std::string>>()) {}
+          _initial_ctx_ids(json.at("initial_contexts").get<std::vector<std::string>>()), 
+          _event_budget(json.value("event_budget", nlohmann::json::object())) {}
 
       // getter 
       std::string initial_events() const { return _initial_events; }
       const std::vector<std::string>& initial_ctx_ids() const { return _initial_ctx_ids; }
+      const EventBudget& event_budget() const { return _event_budget; }
 
       // Methods 
       nlohmann::json ToJson() const {
-        return {{"initial_events", _initial_events}, {"initial_contexts", _initial_ctx_ids}};
+        return {{"initial_events", _initial_events}, {"initial_contexts", _initial_ctx_ids}, 
+          {"event_budget", _event_budget.ToJson()}};
       }
 
     private: 
       std::string _initial_events;
       std::vector<std::string> _initial_ctx_ids;
+      EventBudget _event_budget;
   };
 }
 
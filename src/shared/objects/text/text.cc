@@ -4,15 +4,16 @@
 #include <iostream>
 #include <memory>
 #include <nlohmann/json.hpp>
+#include <utility>
 
 Text::Text(std::string txt, std::string one_time_events, std::string permanent_events, bool shared, 
     std::string logic, Text* next) 
  : _shared(shared), _txt(txt), _one_time_events(one_time_events), _permanent_events(permanent_events), 
-  _logic(logic), _next(next) {}
+  _logic(logic), _next(next), _version(0) {}
 
 Text::Text(std::string txt) : Text(txt, "", "") {}
 
-Text::Text(nlohmann::json json, std::string ctx_id) {
+Text::Text(nlohmann::json json, std::string ctx_id) : _version(0) {
   _next = nullptr;
   // If list-style, get first element of list and create next from remaining
   // list.
@@ -39,6 +40,10 @@ Text::Text(nlohmann::json json, std::string ctx_id) {
   _logic = json.value("logic", "");
 }
 
+Text::Text(const Text& other) : _shared(other._shared), _txt(other._txt), 
+  _one_time_events(other.one_time_events()), _permanent_events(other._permanent_events), 
+  _logic(other._logic), _next(other._next), _version(0) {}
+
 Text::~Text() { 
   // std::cout << "Text::~Text: Deleting text: " << _txt << std::endl; 
 }
@@ -46,21 +51,32 @@ Text::~Text() {
 // getter 
 bool Text::shared() const { return _shared; }
 std::string Text::txt() const { return _txt; }
-std::string Text::one_time_events() const { return _one_time_events; }
+std::string Text::one_time_events() const { 
+  std::lock_guard lock(_mutex);
+  return _one_time_events; 
+}
 std::string Text::permanent_events() const { return _permanent_events; }
 std::string Text::logic() const { return _logic; }
 std::shared_ptr<Text> Text::next() const { return _next; }
+uint64_t Text::version() const { return _version + ((_next) ? _next->version() : 0); }
 
 // setter 
-void Text::set_next(std::shared_ptr<Text> txt) { _next = txt; }
+void Text::set_next(std::shared_ptr<Text> txt) { 
+  _next = txt; 
+  _version++;
+}
 
 // methods
 std::vector<std::string> Text::print(std::string& event_queue, const ExpressionParser& parser) {
   std::vector<std::string> txts;
   if (_logic == "" || parser.Evaluate(_logic) == "1") {
     AddEvents(_permanent_events, event_queue);
-    AddEvents(_one_time_events, event_queue);
-    _one_time_events = "";
+    std::unique_lock lock(_mutex);
+    if (!_one_time_events.empty()) {
+      AddEvents(std::exchange(_one_time_events, ""), event_queue);
+      _version++;
+    }
+    lock.unlock();
     txts.push_back(_txt);
   }
   if (_next) {
@@ -83,6 +99,7 @@ void Text::ReplaceAt(std::shared_ptr<Text> new_text, int index) {
     }
     // Replace next with new text
     _next = new_text;
+    _version++;
   } else if (_next) {
     // Call with index reduced by one.
     _next->ReplaceAt(new_text, --index);
@@ -101,6 +118,7 @@ void Text::InsertAt(std::shared_ptr<Text> new_text, int index) {
     }
     // Replace next with new text
     _next = new_text;
+    _version++;
   } else if (_next) {
     // Call with index reduced by one.
     _next->InsertAt(new_text, --index);
@@ -117,11 +135,22 @@ std::shared_ptr<Text> Text::RemoveAt(int index) {
     return nullptr;
   }
   _next = _next->RemoveAt(--index);
+  _version++;
   return shared_from_this();
 }
 
+void Text::MigrateState(const Text& old_state) {
+  if (old_state.one_time_events().empty()) {
+    std::lock_guard lock(_mutex);
+    _one_time_events = "";
+    _version++;
+  }
+  if (_next && old_state._next) 
+    _next->MigrateState(*old_state._next);
+}
+
 nlohmann::json Text::json() const {
-  nlohmann::json j = {{"shared", _shared}, {"txt", _txt}, {"one_time_events", _one_time_events},
+  nlohmann::json j = {{"shared", _shared}, {"txt", _txt}, {"one_time_events", one_time_events()},
     {"permanent_events", _permanent_events}, {"logic", _logic}};
   if (_next) {
     std::vector<nlohmann::json> txts = {j};
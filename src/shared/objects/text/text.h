@@ -2,7 +2,10 @@
 #define SRC_SHARED_OBJECTS_TEXT_H_
 
 #include "shared/utils/parser/expression_parser.h"
+#include <atomic>
+#include <cstdint>
 #include <memory>
+#include <mutex>
 #include <nlohmann/json_fwd.hpp>
 #include <string>
 #include <vector>
@@ -22,6 +25,7 @@ class Text : public std::enable_shared_from_this<Text> {
      * events)
      */
     Text(nlohmann::json json, std::string ctx_id="");
+    Text(const Text& other);
     ~Text();
 
     // getter 
@@ -31,6 +35,7 @@ class Text : public std::enable_shared_from_this<Text> {
     std::string permanent_events() const;
     std::string logic() const;
     std::shared_ptr<Text> next() const;
+    uint64_t version() const;  ///< increases with every modification of this or following elements
 
     // setter 
     void set_next(std::shared_ptr<Text> txt);
@@ -58,6 +63,12 @@ class Text : public std::enable_shared_from_this<Text> {
      */
     std::shared_ptr<Text> RemoveAt(int index);
 
+    /**
+     * Takes over runtime state of the same text of a previous game definition:
+     * one-time events already thrown stay consumed (element by element).
+     */
+    void MigrateState(const Text& old_state);
+
     /** 
      * Converts text to json
      */
@@ -70,6 +81,8 @@ class Text : public std::enable_shared_from_this<Text> {
     std::string _permanent_events;   ///< events thrown every time the text is printed
     std::string _logic; ///< logic condition checked before printing
     std::shared_ptr<Text> _next; ///< next text to be printed
+    std::atomic<uint64_t> _version;
+    mutable std::mutex _mutex; ///< Guards one-time-events (shared texts are printed by all users)
   
     static void AddEvents(std::string events, std::string& event_queue);
 };
@@ -1,6 +1,8 @@
 #ifndef SHARED_UTILS_DEFINES_H
 #define SHARED_UTILS_DEFINES_H
 
+#include <cstdint>
+
 enum UseCtx {
   NO = 0,
   REGEX,
@@ -10,4 +12,12 @@ enum UseCtx {
   NAME_FUZZY_OR_STARTS_WITH,
 };
 
+/** Kind of event (bit mask: listeners accept a combination of kinds). */
+enum EventKind : uint8_t {
+  EVENT_USER = 1,  ///< input of user
+  EVENT_SYSTEM = 2,  ///< '#'-command (of user or handlers)
+  EVENT_GENERATED = 4,  ///< thrown by handlers/ forwarders
+  EVENT_ANY = EVENT_USER | EVENT_SYSTEM | EVENT_GENERATED,
+};
+
 #endif
@@ -1,16 +1,26 @@
 #include "context_stack.h"
+#include "shared/utils/eventmanager/listener.h"
 #include "shared/utils/utils.h"
 #include <algorithm>
 #include <cstddef>
 #include <iterator>
+#include <tuple>
 
-ContextStack::ContextStack() {};
+ContextStack::ContextStack() : _members(std::make_shared<std::atomic<uint64_t>>(0)) {};
 
 // getter
 std::string ContextStack::cur_event() const {
   return _cur_event;
 }
 
+std::shared_ptr<const std::atomic<uint64_t>> ContextStack::members_version() const {
+  return _members;
+}
+
+ContextStack::ResolutionStats ContextStack::resolution_stats() {
+  return {_resolution_hits.load(), _resolution_misses.load()};
+}
+
 // methods
 bool ContextStack::insert(std::shared_ptr<Context> context) {
   if (_contexts.count(context->id()) > 0) {
@@ -18,6 +28,8 @@ bool ContextStack::insert(std::shared_ptr<Context> context) {
     return false;
   }
   _contexts.emplace(context->id(), context);
+  AddLink(context, {-context->priority(), _num_links++});
+  _version++;
   // If lowest priority, insert into back
   if (_sorted_contexts.empty()) {
     _sorted_contexts.push_back(context);
@@ -33,6 +45,7 @@ bool ContextStack::insert(std::shared_ptr<Context> context) {
       }
     }
   }
+  _members->fetch_add(1, std::memory_order_release);
   return true;
 }
 
@@ -41,6 +54,8 @@ bool ContextStack::erase(const std::string& id) {
     util::Logger()->warn("ContextStack::Remove. Context {} not found.", id);
     return false;
   }
+  RemoveLink(_contexts.at(id).get());
+  _version++;
   _contexts.erase(id);
   auto it = std::find_if(_sorted_contexts.begin(), _sorted_contexts.end(), [id](const auto& it) {
     return it->id() == id; });
@@ -49,6 +64,27 @@ bool ContextStack::erase(const std::string& id) {
   } else {
     util::Logger()->error("ContextStack::Remove. Context {} removed from map but was not found in vector.", id);
   }
+  _members->fetch_add(1, std::memory_order_release);
+  return true;
+}
+
+bool ContextStack::replace(std::shared_ptr<Context> context) {
+  auto it = _contexts.find(context->id());
+  if (it == _contexts.end())
+    return false;
+  // Keep position (order) of replaced context
+  auto link = _links.find(it->second.get());
+  const Order order = (link != _links.end()) ? link->second._order 
+    : Order{-context->priority(), _num_links++};
+  RemoveLink(it->second.get());
+  AddLink(context, order);
+  _version++;
+  it->second = context;
+  for (auto& ctx : _sorted_contexts) {
+    if (ctx->id() == context->id())
+      ctx = context;
+  }
+  _members->fetch_add(1, std::memory_order_release);
   return true;
 }
 
@@ -56,7 +92,7 @@ bool ContextStack::exists(const std::string& id) const {
   return _contexts.count(id) > 0;
 }
 
-std::shared_ptr<Context> ContextStack::get(const std::string& id) {
+std::shared_ptr<Context> ContextStack::get(const std::string& id) const {
   const auto& it = _contexts.find(id);
   if (it != _contexts.end())
     return it->second;
@@ -75,44 +111,187 @@ std::vector<std::shared_ptr<Context>> ContextStack::find(const std::string& id_p
   return ctxs;
 }
 
-std::vector<std::string> ContextStack::GetOrder() {
+std::vector<std::string> ContextStack::GetOrder() const {
   std::vector<std::string> sorted_context_ids;
   std::transform(_sorted_contexts.begin(), _sorted_contexts.end(), std::back_inserter(sorted_context_ids),
         [](const auto& it) { return it->id(); });
   return sorted_context_ids;
 }
 
-void ContextStack::TakeEvents(std::string& events, const ExpressionParser& parser, bool user_inp) {
+void ContextStack::TakeEvents(std::string& events, const ExpressionParser& parser, bool user_inp, User* user) {
   // If events are empty, return
   if (events == "") {
     return;
   }
   // If user_inp don't split! Otherwise Split events and handle after eachother
-  auto vec_events = (user_inp) ? std::vector<std::string>{events} : util::Split(events, ";");
+  auto vec_events = (user_inp) ? std::vector<std::string>{events} : EventQueue::Split(events);
   events = "";
-  for (auto event : vec_events) {
-    if (event.find(" #") == 0) {
-      event = event.substr(1);
-    } 
+  for (auto& event : vec_events) {
     util::Logger()->debug("ContextStack::TakeEvents: {}", event);
-    TakeEvent(event.substr(0), parser);
+    const EventKind kind = EventQueue::Classify(event, user_inp);
+    TakeEvent(EventQueue::Event{std::move(event), user_inp, kind}, parser, user);
   }
   _cur_event = "";
 }
 
-void ContextStack::TakeEvent(const std::string& event, const ExpressionParser& parser) {
+void ContextStack::TakeEvent(const std::string& event, const ExpressionParser& parser, User* user) {
+  TakeEvent(EventQueue::Event{event, false, EventQueue::Classify(event, false)}, parser, user);
+}
+
+void ContextStack::TakeEvent(const EventQueue::Event& queued_event, const ExpressionParser& parser, 
+    User* user) {
+  const std::string& event = queued_event._event;
   _cur_event = event;
-  // (using index-based iteration, since container might be modified during
-  // iteration
-  for (size_t i=0; i<_sorted_contexts.size();) {
-    if (auto ctx = _sorted_contexts[i]) {
-      util::Logger()->info("CTX {} take_event: {}", ctx->id(), event);
-      // If event accepted by context and context is non-permeable: stop!
-      if (ctx->TakeEvent(event, parser) && !ctx->permeable())
-        return;
-      ++i;
-    } else {
-      util::Logger()->warn("CTX STACK: skipping, probably due to remove");
+  // Evaluate the same logic of different listeners once, unless linked
+  // contexts or their attributes or names change
+  ExpressionParser::Memo memo(parser, [this]() { return LinkedVersion(); });
+  UpdateListeners();
+  UpdateNames();
+  // Listeners matching the event (cached): only their checks (f.e. logic) are evaluated
+  auto resolution = Resolve(event, queued_event._kind);
+  util::Logger()->debug("ContextStack::TakeEvent: \"{}\": {} matching listeners", event, resolution->size());
+  size_t version = _version;
+  for (size_t i=0; i<resolution->size();) {
+    // Listeners of one context are consecutive
+    const auto ctx = (*resolution)[i]._ctx;
+    const Order order = (*resolution)[i]._order;
+    bool accepted = false, stop = false;
+    for (; i<resolution->size() && (*resolution)[i]._ctx == ctx; i++) {
+      if (stop)
+        continue;
+      const auto& listener = (*resolution)[i]._listener;
+      const auto& match = (*resolution)[i]._match;
+      if (listener->Check(match, parser)) {
+        util::Logger()->debug("CTX {}: - ACCEPTED: \"{}\" with {}", ctx->id(), listener->id(), 
+            listener->event());
+        accepted = true;
+        listener->Execute(event, match, user);
+        UpdateNames();
+        stop = !listener->permeable();
+      } else {
+        util::Logger()->debug("CTX {}: - REJECTED: \"{}\" with {}", ctx->id(), listener->id(), 
+            listener->event());
+      }
+    }
+    if (!accepted)
+      continue;
+    // If event accepted by context and context is non-permeable: stop!
+    if (!ctx->permeable())
+      return;
+    // If handlers changed linked contexts or their listeners, continue with
+    // contexts ordered after this one.
+    UpdateListeners();
+    UpdateNames();
+    if (version != _version) {
+      version = _version;
+      resolution = Resolve(event, queued_event._kind);
+      i = std::upper_bound(resolution->begin(), resolution->end(), order, [](const Order& o, const auto& r) {
+          return o < r._order; }) - resolution->begin();
+    }
+  }
+}
+
+std::vector<std::pair<std::shared_ptr<Context>, std::shared_ptr<Listener>>> ContextStack::Candidates(
+    const std::string& event, EventKind kind) {
+  UpdateListeners();
+  std::vector<std::pair<std::shared_ptr<Context>, std::shared_ptr<Listener>>> candidates;
+  for (const auto& it : FindCandidates(event, kind))
+    candidates.emplace_back(it._ctx, it._listener);
+  return candidates;
+}
+
+std::shared_ptr<const ContextStack::Resolution> ContextStack::Resolve(const std::string& event, 
+    EventKind kind) {
+  if (_resolutions_version != _version) {
+    _resolutions.clear();
+    _resolutions_version = _version;
+  }
+  std::string key = std::to_string(kind) + ":" + event;
+  auto it = _resolutions.find(key);
+  if (it != _resolutions.end()) {
+    _resolution_hits.fetch_add(1, std::memory_order_relaxed);
+    return it->second;
+  }
+  _resolution_misses.fetch_add(1, std::memory_order_relaxed);
+  auto resolution = std::make_shared<Resolution>();
+  for (auto& candidate : FindCandidates(event, kind)) {
+    if (auto match = candidate._listener->MatchEvent(event)) {
+      // Context-forwarders match names of linked contexts with one query per argument
+      match._names = &_names;
+      resolution->push_back({std::move(candidate), std::move(match)});
+    }
+  }
+  if (_resolutions.size() >= MAX_RESOLUTIONS)
+    _resolutions.clear();
+  _resolutions.emplace(std::move(key), resolution);
+  return resolution;
+}
+
+std::vector<ContextStack::Candidate> ContextStack::FindCandidates(const std::string& event, 
+    EventKind kind) const {
+  std::vector<Candidate> candidates;
+  for (const auto& ctx : _sorted_contexts) {
+    auto link = _links.find(ctx.get());
+    if (link == _links.end())
+      continue;
+    for (auto& listener : ctx->Candidates(event)) {
+      if (listener->kinds() & kind)
+        candidates.push_back({link->second._order, ctx, std::move(listener)});
     }
   }
+  // (contexts are sorted by order, unless priorities changed since linking)
+  auto by_order = [](const Candidate& a, const Candidate& b) { return a._order < b._order; };
+  if (!std::is_sorted(candidates.begin(), candidates.end(), by_order))
+    std::stable_sort(candidates.begin(), candidates.end(), by_order);
+  return candidates;
+}
+
+void ContextStack::AddLink(const std::shared_ptr<Context>& ctx, Order order) {
+  _links[ctx.get()] = {order, ctx->listeners_version(), std::nullopt};
+}
+
+void ContextStack::RemoveLink(const Context* ctx) {
+  auto link = _links.find(ctx);
+  if (link == _links.end())
+    return;
+  if (link->second._name)
+    _names.Remove(*link->second._name);
+  _links.erase(link);
+}
+
+void ContextStack::UpdateListeners() {
+  for (const auto& ctx : _sorted_contexts) {
+    auto link = _links.find(ctx.get());
+    if (link == _links.end() || link->second._listeners_version == ctx->listeners_version())
+      continue;
+    link->second._listeners_version = ctx->listeners_version();
+    _version++;
+  }
+}
+
+uint64_t ContextStack::LinkedVersion() const {
+  // (linked contexts fixed while _version is unchanged: sum of their versions only increases)
+  uint64_t version = static_cast<uint64_t>(_version) << 32;
+  for (const auto& ctx : _sorted_contexts)
+    version += Context::VersionOf(ctx)->load(std::memory_order_acquire);
+  return version;
+}
+
+void ContextStack::UpdateNames() {
+  const uint64_t version = LinkedVersion();
+  if (version == _names_version)
+    return;
+  for (const auto& ctx : _sorted_contexts) {
+    auto link = _links.find(ctx.get());
+    if (link == _links.end())
+      continue;
+    std::string name = ctx->name();
+    if (link->second._name == name)
+      continue;
+    if (link->second._name)
+      _names.Remove(*link->second._name);
+    _names.Add(name);
+    link->second._name = std::move(name);
+  }
+  _names_version = version;
 }
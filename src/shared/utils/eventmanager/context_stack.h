@@ -1,36 +1,130 @@
 #ifndef SRC_UTILS_CONTEXT_STACK_H
 #define SRC_UTILS_CONTEXT_STACK_H
 
+#include <atomic>
+#include <cstdint>
 #include <map>
 #include <memory>
+#include <optional>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 #include "shared/objects/context/context.h"
+#include "shared/utils/eventmanager/event_queue.h"
+#include "shared/utils/fuzzy_search/name_index.h"
 #include "shared/utils/parser/expression_parser.h"
 
 class ContextStack {
   public: 
+    struct ResolutionStats {
+      size_t _hits;  ///< events resolved from cache
+      size_t _misses;  ///< events resolved by matching all candidates
+    };
+
     ContextStack();
 
     // getter 
     std::string cur_event() const;
+    /** Increases when contexts are linked, unlinked or replaced (see ExpressionParser::DependsOn). */
+    std::shared_ptr<const std::atomic<uint64_t>> members_version() const;
+    static ResolutionStats resolution_stats();  ///< (of all stacks)
 
     // methods
     bool exists(const std::string& id) const;
     bool insert(std::shared_ptr<Context> context);
     bool erase(const std::string& id);
-    std::shared_ptr<Context> get(const std::string& id);
+    /**
+     * Replaces linked context of same id, keeping its position. Returns false
+     * if no such context is linked.
+     */
+    bool replace(std::shared_ptr<Context> context);
+    std::shared_ptr<Context> get(const std::string& id) const;
     std::vector<std::shared_ptr<Context>> find(const std::string& id_part);
 
-    std::vector<std::string> GetOrder();
-    void TakeEvents(std::string& events, const ExpressionParser& parser, bool user_inp=false);
+    std::vector<std::string> GetOrder() const;
+    void TakeEvents(std::string& events, const ExpressionParser& parser, bool user_inp=false, 
+        User* user=nullptr);
+    /**
+     * Passes single (already split) event to linked contexts by priority.
+     * Listeners not accepting the event's kind are skipped.
+     */
+    void TakeEvent(const EventQueue::Event& event, const ExpressionParser& parser, User* user=nullptr);
+    /** Passes (handler-generated or system) event. */
+    void TakeEvent(const std::string& event, const ExpressionParser& parser, User* user=nullptr);
+
+    /**
+     * Listeners of all linked contexts, which might accept event (their prefix
+     * matches and they accept its kind) with their context, in order of
+     * contexts and listeners.
+     */
+    std::vector<std::pair<std::shared_ptr<Context>, std::shared_ptr<Listener>>> Candidates(
+        const std::string& event, EventKind kind=EVENT_ANY);
 
   private: 
+    /** Order of a linked context: (-priority, number of link). */
+    using Order = std::pair<int, size_t>;
+
+    struct Link {
+      Order _order;
+      uint64_t _listeners_version;  ///< version of context's listeners when last checked
+      std::optional<std::string> _name;  ///< name in index of names
+    };
+
+    struct Candidate {
+      Order _order;
+      std::shared_ptr<Context> _ctx;
+      std::shared_ptr<Listener> _listener;
+    };
+
+    /** Candidate, whose listener matched the event (see Listener::MatchEvent). */
+    struct Resolved : Candidate {
+      Listener::Match _match;
+    };
+    using Resolution = std::vector<Resolved>;
+
+    static constexpr size_t MAX_RESOLUTIONS = 256;
+
     std::map<std::string, std::shared_ptr<Context>> _contexts;
     std::vector<std::shared_ptr<Context>> _sorted_contexts;
     std::string _cur_event;
 
-    void TakeEvent(const std::string& event, const ExpressionParser& parser);
+    /** Order of linked contexts (candidates are found in the index of each context's listeners). */
+    std::unordered_map<const Context*, Link> _links;
+    size_t _num_links = 0;
+    size_t _version = 0;  ///< increases when linked contexts change
+    std::shared_ptr<std::atomic<uint64_t>> _members;  ///< (see members_version)
+
+    /** 
+     * Names of linked contexts, used by context-forwarders to match names
+     * (checked for renamed contexts, when LinkedVersion changed).
+     */
+    fuzzy::NameIndex _names;
+    uint64_t _names_version = UINT64_MAX;
+
+    /**
+     * Cache of resolved events (by kind and event): listeners matching the
+     * event in order. Valid as long as linked contexts and their listeners
+     * are unchanged (only their `Check`, f.e. logic, is evaluated for every
+     * event).
+     */
+    std::unordered_map<std::string, std::shared_ptr<const Resolution>> _resolutions;
+    size_t _resolutions_version = 0;
+    static inline std::atomic<size_t> _resolution_hits = 0;
+    static inline std::atomic<size_t> _resolution_misses = 0;
+
+    void AddLink(const std::shared_ptr<Context>& ctx, Order order);
+    void RemoveLink(const Context* ctx);
+    /** Increases version, if listeners of a linked context have changed. */
+    void UpdateListeners();
+    void UpdateNames();
+    /** 
+     * Increases when linked contexts change or one of them is written (name,
+     * attributes or listeners, see Context::VersionOf).
+     */
+    uint64_t LinkedVersion() const;
+    std::vector<Candidate> FindCandidates(const std::string& event, EventKind kind) const;
+    std::shared_ptr<const Resolution> Resolve(const std::string& event, EventKind kind);
 };
 
 #endif
@@ -0,0 +1,85 @@
+#include "shared/utils/eventmanager/event_queue.h"
+#include "shared/utils/utils.h"
+#include <utility>
+
+EventQueue::EventQueue() {}
+
+// getter
+bool EventQueue::empty() const {
+  return _events.empty();
+}
+
+size_t EventQueue::size() const {
+  return _events.size();
+}
+
+std::string EventQueue::str() const {
+  std::string str = "";
+  for (const auto& it : _events) {
+    str += ((str.length() == 0) ? "" : ";") + it._event;
+  }
+  return str;
+}
+
+// methods
+void EventQueue::Push(const std::string& events, bool user_inp) {
+  if (events == "")
+    return;
+  if (user_inp) {
+    _events.push_back({events, true, Classify(events, true)});
+    return;
+  }
+  for (auto& it : Split(events)) {
+    const EventKind kind = Classify(it, false);
+    _events.push_back({std::move(it), false, kind});
+  }
+}
+
+std::optional<EventQueue::Event> EventQueue::Pop() {
+  if (_events.empty())
+    return std::nullopt;
+  Event event = std::move(_events.front());
+  _events.pop_front();
+  return event;
+}
+
+void EventQueue::clear() {
+  _events.clear();
+}
+
+std::vector<std::string> EventQueue::Split(const std::string& events) {
+  std::vector<std::string> parts;
+  int depth = 0;
+  bool balanced = true;
+  size_t begin = 0;
+  for (size_t i = 0; i < events.length(); i++) {
+    char c = events[i];
+    if (c == '{' || c == '(' || c == '[') {
+      depth++;
+    } else if (c == '}' || c == ')' || c == ']') {
+      if (--depth < 0) 
+        balanced = false;
+    } else if (c == ';' && depth == 0) {
+      parts.push_back(events.substr(begin, i - begin));
+      begin = i + 1;
+    }
+  }
+  parts.push_back(events.substr(begin));
+  if (!balanced || depth != 0) 
+    parts = util::Split(events, ";");
+
+  std::vector<std::string> cleaned;
+  for (auto& it : parts) {
+    if (it.find(" #") == 0)
+      it.erase(0, 1);
+    if (it != "")
+      cleaned.push_back(std::move(it));
+  }
+  return cleaned;
+}
+
+EventKind EventQueue::Classify(const std::string& event, bool user_inp) {
+  if (event.starts_with('#'))
+    return EVENT_SYSTEM;
+  return (user_inp) ? EVENT_USER : EVENT_GENERATED;
+}
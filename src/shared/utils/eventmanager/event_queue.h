@@ -0,0 +1,55 @@
+#ifndef SRC_UTILS_EVENTMANAGER_EVENT_QUEUE_H
+#define SRC_UTILS_EVENTMANAGER_EVENT_QUEUE_H
+
+#include <cstddef>
+#include <deque>
+#include <optional>
+#include <string>
+#include <vector>
+#include "shared/utils/defines.h"
+
+/**
+ * Pending events of one user (first in, first out). Events are split once when
+ * added, instead of re-splitting a ';'-joined string for every event handled.
+ */
+class EventQueue {
+  public:
+    struct Event {
+      std::string _event;
+      bool _user_inp;  ///< raw user input (never split)
+      EventKind _kind;
+    };
+
+    EventQueue();
+
+    // getter
+    bool empty() const;
+    size_t size() const;
+    std::string str() const;  ///< ';'-joined (f.e. for logging)
+
+    // methods
+
+    /**
+     * Splits events and adds them to the back of the queue. User input is
+     * added as single event.
+     */
+    void Push(const std::string& events, bool user_inp=false);
+    std::optional<Event> Pop();
+    void clear();
+
+    /**
+     * Splits events at ';', but not inside brackets ("{}", "()", "[]"), so
+     * that expressions may contain ';'. If brackets are unbalanced (f.e. in
+     * printed text) every ';' splits. Empty events are dropped, leading
+     * whitespace of mechanics events (" #...") is removed.
+     */
+    static std::vector<std::string> Split(const std::string& events);
+
+    /** '#'-commands are system events, others user input or generated. */
+    static EventKind Classify(const std::string& event, bool user_inp);
+
+  private:
+    std::deque<Event> _events;
+};
+
+#endif
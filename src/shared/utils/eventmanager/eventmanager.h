@@ -1,58 +1,129 @@
 #ifndef SRC_UTILS_EVENTMANAGER_EVENTMANAGER_H
 #define SRC_UTILS_EVENTMANAGER_EVENTMANAGER_H
 
+#include <algorithm>
+#include <cstdint>
 #include <map>
 #include <memory>
+#include <spdlog/common.h>
 #include <string>
+#include <vector>
 #include "listener.h"
 #include "shared/utils/parser/expression_parser.h"
 #include "shared/utils/utils.h"
 
 class EventManager {
   public: 
+    using Listeners = std::map<std::string, std::shared_ptr<Listener>>;
+
     EventManager() {};
 
     // getter 
-    const std::map<std::string, std::shared_ptr<Listener>>& listeners() {
+    const Listeners& listeners() {
       return _listeners;
     }
+    uint64_t version() const { return _version; }  ///< increases when listeners are added/ removed
 
     // Methods 
     void AddListener(std::shared_ptr<Listener> listener) {
+      if (_listeners.contains(listener->id()))
+        RemoveFromIndex(*_listeners.at(listener->id()));
       _listeners[listener->id()] = listener;
+      const std::string prefix = listener->prefix();
+      if (_by_prefix[prefix].empty())
+        _prefix_lengths[prefix.length()]++;
+      _by_prefix[prefix][listener->id()] = listener;
+      _version++;
     }
     void RemoveListener(const std::string& id) {
       if (_listeners.contains(id)) {
+        RemoveFromIndex(*_listeners.at(id));
         _listeners.erase(id);
+        _version++;
       } else {
         util::Logger()->warn("EventManager::RemoveListener: listener \"{}\" not found!", id);
       }
     }
 
-    bool TakeEvent(std::string event, const ExpressionParser& parser) {
+    /**
+     * Listeners, which might accept event (their prefix matches) in listener
+     * order.
+     */
+    std::vector<std::shared_ptr<Listener>> Candidates(const std::string& event) const {
+      std::vector<const Listeners::value_type*> entries;
+      size_t buckets = 0;
+      for (const auto& [length, count] : _prefix_lengths) {
+        if (length > event.length())
+          break;
+        auto it = _by_prefix.find(event.substr(0, length));
+        if (it == _by_prefix.end())
+          continue;
+        buckets++;
+        for (const auto& entry : it->second)
+          entries.push_back(&entry);
+      }
+      if (buckets > 1) {
+        std::sort(entries.begin(), entries.end(), [](const auto* a, const auto* b) {
+            return a->first < b->first; });
+      }
+      // (shared: handlers might replace listeners while executing)
+      std::vector<std::shared_ptr<Listener>> candidates;
+      candidates.reserve(entries.size());
+      for (const auto* entry : entries)
+        candidates.push_back(entry->second);
+      return candidates;
+    }
+
+    bool TakeEvent(std::string event, const ExpressionParser& parser, User* user=nullptr) {
       util::Logger()->debug("EventManager::TakeEvent: \"{}\"", event);
-      std::string all = "";
-      for (const auto& it : _listeners) {
-        all += it.first + ", ";
+      auto candidates = Candidates(event);
+      if (util::Logger()->should_log(spdlog::level::debug)) {
+        std::string all = "";
+        for (const auto& it : candidates) {
+          all += it->id() + ", ";
+        }
+        util::Logger()->debug("EventManager::TakeEvent: candidates: \"{}\" (of {} listeners)", all,
+            _listeners.size());
       }
-      util::Logger()->debug("EventManager::TakeEvent: listeners: \"{}\"", all);
       bool accepted = false;
-      for (const auto& it : _listeners) {
-        if (it.second->Test(event, parser)) {
-          util::Logger()->debug("EventManager::TakeEvent: - ACCEPTED: \"{}\" with {}", it.first, it.second->event());
+      for (const auto& it : candidates) {
+        if (auto match = it->Test(event, parser)) {
+          util::Logger()->debug("EventManager::TakeEvent: - ACCEPTED: \"{}\" with {}", it->id(), it->event());
           accepted = true;
-          it.second->Execute(event);
-          if (!it.second->permeable())
+          it->Execute(event, match, user);
+          if (!it->permeable())
             return true;
         } else {
-          util::Logger()->debug("EventManager::TakeEvent: - REJECTED : \"{}\" with {}", it.first, it.second->event());
+          util::Logger()->debug("EventManager::TakeEvent: - REJECTED : \"{}\" with {}", it->id(), it->event());
         }
       }
       return accepted;
     }
 
   private: 
-    std::map<std::string, std::shared_ptr<Listener>> _listeners;
+    Listeners _listeners;
+    uint64_t _version = 0;
+
+    /**
+     * Index: listeners by the literal every event they accept starts with ("" if
+     * pattern has none, f.e. <user-inp>), and number of prefixes per length.
+     * Only buckets of prefixes of an event need to be tested.
+     */
+    std::map<std::string, Listeners> _by_prefix;
+    std::map<size_t, size_t> _prefix_lengths;
+
+    void RemoveFromIndex(const Listener& listener) {
+      const std::string prefix = listener.prefix();
+      auto it = _by_prefix.find(prefix);
+      if (it == _by_prefix.end())
+        return;
+      it->second.erase(listener.id());
+      if (it->second.empty()) {
+        _by_prefix.erase(it);
+        if (--_prefix_lengths[prefix.length()] == 0)
+          _prefix_lengths.erase(prefix.length());
+      }
+    }
 };
 
 #endif
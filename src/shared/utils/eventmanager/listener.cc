@@ -4,21 +4,43 @@
 #include "shared/utils/defines.h"
 #include "shared/utils/fuzzy_search/fuzzy.h"
 #include "shared/utils/utils.h"
+#include <algorithm>
 #include <nlohmann/json.hpp>
 #include <memory>
 #include <stdexcept>
 #include <string>
 
+// ## listener
+
+Listener::Match Listener::Test(const std::string& event, const ExpressionParser& parser) const {
+  // Match first (cheapest, rejects most events)
+  Match match = MatchEvent(event);
+  if (match && !Check(match, parser))
+    match._matched = false;
+  return match;
+}
+
 // ## l-handler
 
+static uint8_t kinds_of(const util::Regex& regex) {
+  auto first = regex.first_bytes();
+  uint8_t kinds = (first['#']) ? EVENT_SYSTEM : 0;
+  first.reset('#');
+  if (first.any() || regex.Match(""))
+    kinds |= EVENT_USER | EVENT_GENERATED;
+  return kinds;
+}
+
 LHandler::LHandler(std::string id, std::string re_event, Fn fn, bool permeable) : _id(id), _event(re_event),
-    _arguments(""), _fn(fn), _permeable(permeable) {}
+    _arguments(""), _fn(fn), _permeable(permeable), _kinds(kinds_of(_event)) {}
 
 // getter 
 std::string LHandler::id() const { return _id; }
 std::string LHandler::event() const { return _event.str(); }
 bool LHandler::permeable() const { return _permeable; } 
 std::string LHandler::arguments() const { return _arguments; }
+std::string LHandler::prefix() const { return _event.prefix(); }
+uint8_t LHandler::kinds() const { return _kinds; }
 
 // setter 
 void LHandler::set_fn(Fn fn) {
@@ -26,53 +48,49 @@ void LHandler::set_fn(Fn fn) {
 }
 
 // methods 
-bool LHandler::Test(const std::string& event, const ExpressionParser& parser) const {
-  util::Logger()->info(fmt::format("LHandler::Test: {}, {}, {}", _id, _event.str(), event));
-  std::smatch base_match;
-  return (std::regex_match(event, base_match, static_cast<const std::regex&>(_event)));
+Listener::Match LHandler::MatchEvent(const std::string& event) const {
+  util::Logger()->debug("LHandler::MatchEvent: {}, {}, {}", _id, _event.str(), event);
+  Match match;
+  match._matched = _event.Match(event, &match._captures);
+  return match;
 }
 
-void LHandler::Execute(std::string event) const {
+void LHandler::Execute(const std::string& event, const Match& match, User* user) const {
   if (!_fn) {
     util::Logger()->error("LHandler::Execute. Function from handler: {} not initialized!", _id);
   } else {
     util::Logger()->debug("LHandler::Execute. Executing {}, {}", event, _arguments);
-    _fn(event, ReplacedArguments(event, _arguments));
+    _fn(user, event, ReplacedArguments(match, _arguments));
   }
 }
 
-std::string LHandler::ReplacedArguments(const std::string& event, const std::string& args) const {
+std::string LHandler::ReplacedArguments(const Match& match, const std::string& args) const {
+  if (!match)
+    return "";
   auto pos = args.find(txtad::EVENT_REPLACEMENT);
-
-  std::smatch base_match;
-  if (std::regex_match(event, base_match, static_cast<const std::regex&>(_event))) {
-    std::string match = base_match[1].str();
-    // If no arguments, ALWAYS return the match
-    if (args == "") {
-      return match;
-    } 
-    // If arguments ask for event1..n, replace "#event1..n" with match[1..n]
-    else if (pos != std::string::npos) {
-      std::string cpy_args = args;
-      for (size_t i = base_match.size() - 1; i >= 1; i--) {
-        const std::string event_n = txtad::EVENT_REPLACEMENT + std::to_string(i);
-        const std::string match_n = base_match[i].str();
-        if (cpy_args.find(event_n) != std::string::npos) {
-          cpy_args = util::ReplaceAll(cpy_args, event_n, match_n);
-        } 
-      }
-      // If only '#event' (legacy) is still found, replace that with the base match:
-      if (cpy_args.find(txtad::EVENT_REPLACEMENT) != std::string::npos) {
-        cpy_args = util::ReplaceAll(cpy_args, txtad::EVENT_REPLACEMENT, match);
-      }
-      return cpy_args;
+  const auto& captures = match._captures;
+  std::string base_match = (captures.size() > 1) ? captures[1] : "";
+  // If no arguments, ALWAYS return the match
+  if (args == "") {
+    return base_match;
+  } 
+  // If arguments ask for event1..n, replace "#event1..n" with match[1..n]
+  else if (pos != std::string::npos) {
+    std::string cpy_args = args;
+    for (size_t i = captures.size() - 1; i >= 1; i--) {
+      const std::string event_n = txtad::EVENT_REPLACEMENT + std::to_string(i);
+      if (cpy_args.find(event_n) != std::string::npos) {
+        cpy_args = util::ReplaceAll(cpy_args, event_n, captures[i]);
+      } 
     }
-    // Otherwise, return arguments
-    else {
-      return args;
+    // If only '#event' (legacy) is still found, replace that with the base match:
+    if (cpy_args.find(txtad::EVENT_REPLACEMENT) != std::string::npos) {
+      cpy_args = util::ReplaceAll(cpy_args, txtad::EVENT_REPLACEMENT, base_match);
     }
+    return cpy_args;
   }
-  return "";
+  // Otherwise, return arguments
+  return args;
 }
 
 nlohmann::json LHandler::json() const {
@@ -80,8 +98,69 @@ nlohmann::json LHandler::json() const {
   return j;
 }
 
+// ## l-command-dispatcher
+
+LCommandDispatcher::LCommandDispatcher(std::string id, bool permeable) : _id(id), _permeable(permeable), 
+    _max_words(0) {}
+
+// getter 
+std::string LCommandDispatcher::id() const { return _id; }
+std::string LCommandDispatcher::event() const { return _prefix + "<command>"; }
+bool LCommandDispatcher::permeable() const { return _permeable; }
+std::string LCommandDispatcher::arguments() const { return ""; }
+std::string LCommandDispatcher::prefix() const { return _prefix; }
+uint8_t LCommandDispatcher::kinds() const { return (_prefix.starts_with('#')) ? EVENT_SYSTEM : EVENT_ANY; }
+
+// methods 
+void LCommandDispatcher::AddCommand(const std::string& keyword, Fn fn, bool arguments) {
+  if (_commands.empty()) {
+    _prefix = keyword;
+  } else {
+    size_t len = 0;
+    while (len < _prefix.length() && len < keyword.length() && _prefix[len] == keyword[len])
+      len++;
+    _prefix.resize(len);
+  }
+  _commands[keyword] = {fn, arguments};
+  _max_words = std::max(_max_words, static_cast<size_t>(std::count(keyword.begin(), keyword.end(), ' ') + 1));
+}
+
+Listener::Match LCommandDispatcher::MatchEvent(const std::string& event) const {
+  // Keywords are the first n words of the event
+  size_t words = 0;
+  for (size_t pos = event.find(' '); words < _max_words; pos = event.find(' ', pos + 1)) {
+    words++;
+    size_t end = (pos == std::string::npos) ? event.length() : pos;
+    auto it = _commands.find(event.substr(0, end));
+    if (it != _commands.end()) {
+      if (!it->second._arguments && end == event.length())
+        return {true, {event}};
+      // "(.*)" matches anything but line breaks
+      if (it->second._arguments && end < event.length() 
+          && event.find_first_of("\n\r", end + 1) == std::string::npos)
+        return {true, {event, event.substr(end + 1)}};
+    }
+    if (pos == std::string::npos)
+      break;
+  }
+  return {};
+}
+
+void LCommandDispatcher::Execute(const std::string& event, const Match& match, User* user) const {
+  const std::string args = (match._captures.size() > 1) ? match._captures[1] : "";
+  const std::string keyword = (match._captures.size() > 1) 
+    ? event.substr(0, event.length() - args.length() - 1) : event;
+  auto it = _commands.find(keyword);
+  if (it == _commands.end() || !it->second._fn) {
+    util::Logger()->error("LCommandDispatcher::Execute. No command for: {}", event);
+  } else {
+    util::Logger()->debug("LCommandDispatcher::Execute. Executing {}: {}", keyword, args);
+    it->second._fn(user, event, args);
+  }
+}
+
 // ## l-forwarder
-Listener::Fn LForwarder::_overwride_fn = nullptr;
+thread_local Listener::Fn LForwarder::_overwride_fn = nullptr;
 
 LForwarder::LForwarder(std::string id, std::string re_event, std::string arguments, bool permeable, 
     std::string logic) : LHandler(id, re_event, _overwride_fn, permeable), _logic(logic) { 
@@ -110,11 +189,10 @@ int LForwarder::use_ctx_regex() const {
 }
 
 // methods 
-bool LForwarder::Test(const std::string& event, const ExpressionParser& parser) const {
-  util::Logger()->info(fmt::format("LForwarder::Test: {}, {}, {}", _id, _event.str(), _logic));
-  if (_logic != "" && parser.Evaluate(LHandler::ReplacedArguments(event, _logic)) != "1")
-    return false;
-  return LHandler::Test(event, parser);
+bool LForwarder::Check(const Match& match, const ExpressionParser& parser) const {
+  util::Logger()->debug("LForwarder::Check: {}, {}, {}", _id, _event.str(), _logic);
+  // (the logic may use the event's captures)
+  return _logic == "" || parser.Evaluate(ReplacedArguments(match, _logic)) == "1";
 }
 
 void LForwarder::set_overwite_fn(Fn fn) { 
@@ -146,48 +224,52 @@ std::string LContextForwarder::ctx_id () const { return GetCtxId(_ctx); }
 std::weak_ptr<Context> LContextForwarder::ctx() const { return _ctx; }
 int LContextForwarder::use_ctx_regex() const { return _use_ctx_regex; }
 
-bool LContextForwarder::Test(const std::string& event, const ExpressionParser& parser) const { 
-  // Test logic
-  util::Logger()->debug("- LContextForwarder::Test. Test logic");
-  if (_logic != "" && parser.Evaluate(_logic) != "1")
-    return false;
-  // Test regex
-  util::Logger()->debug("- LContextForwarder::Test. Test Regex");
-  std::smatch base_match;
-  if (std::regex_match(event, base_match, static_cast<const std::regex&>(_event))) {
-    // Potentially check context name or regex too
-    util::Logger()->debug("- LContextForwarder::Test. Test CTX-Regex");
-    if (base_match.size() == 2) {
-      const std::string ctx_name = GetCtxName(_ctx);
-      std::string arg = base_match[1].str();
-      int res = fuzzy::fuzzy(ctx_name, arg);
-      util::Logger()->debug("- LContextForwarder::Test: {} =={}, {} => ", arg, std::to_string(_use_ctx_regex), ctx_name, res);
-      switch(_use_ctx_regex) {
-        case UseCtx::NO: 
-          return true;
-        case UseCtx::NAME: 
-          return res == fuzzy::FuzzyMatch::DIRECT;
-        case UseCtx::NAME_FUZZY:
-          return res != 0 && (res == fuzzy::FuzzyMatch::DIRECT 
-              || res == fuzzy::FuzzyMatch::FUZZY);
-        case UseCtx::NAME_STARTS_WITH:
-          return res != 0 && (res == fuzzy::FuzzyMatch::DIRECT 
-              || res == fuzzy::FuzzyMatch::STARTS_WITH);
-        case UseCtx::NAME_FUZZY_OR_STARTS_WITH:
-          return res != 0 && (res == fuzzy::FuzzyMatch::DIRECT 
-              || res == fuzzy::FuzzyMatch::STARTS_WITH || fuzzy::FuzzyMatch::FUZZY);
-        case UseCtx::REGEX: 
-          if (auto ctx = _ctx.lock()) {
-            return ctx->CheckEntry(arg);
-          } else {
-            util::Logger()->error("Context for ContextForwarder {} not availible!", _id);
-            return false;
-          }
-      }
+bool LContextForwarder::Check(const Match& match, const ExpressionParser& parser) const { 
+  bool matched = true;
+  // Potentially check context name or regex too
+  if (match._captures.size() == 2) {
+    util::Logger()->debug("- LContextForwarder::Check. Test CTX-Regex");
+    const std::string& arg = match._captures[1];
+    // Match name only if needed (through the index of names on the stack, if given)
+    const bool by_name = _use_ctx_regex != UseCtx::NO && _use_ctx_regex != UseCtx::REGEX;
+    const std::string ctx_name = (by_name) ? GetCtxName(_ctx) : "";
+    int res = (!by_name) ? fuzzy::FuzzyMatch::NO_MATCH 
+      : (match._names) ? match._names->Match(ctx_name, arg) : fuzzy::fuzzy(ctx_name, arg);
+    util::Logger()->debug("- LContextForwarder::Check: {} =={}, {} => ", arg, std::to_string(_use_ctx_regex), ctx_name, res);
+    switch(_use_ctx_regex) {
+      case UseCtx::NO: 
+        break;
+      case UseCtx::NAME: 
+        matched = res == fuzzy::FuzzyMatch::DIRECT;
+        break;
+      case UseCtx::NAME_FUZZY:
+        matched = res != 0 && (res == fuzzy::FuzzyMatch::DIRECT 
+            || res == fuzzy::FuzzyMatch::FUZZY);
+        break;
+      case UseCtx::NAME_STARTS_WITH:
+        matched = res != 0 && (res == fuzzy::FuzzyMatch::DIRECT 
+            || res == fuzzy::FuzzyMatch::STARTS_WITH);
+        break;
+      case UseCtx::NAME_FUZZY_OR_STARTS_WITH:
+        matched = res != 0 && (res == fuzzy::FuzzyMatch::DIRECT 
+            || res == fuzzy::FuzzyMatch::STARTS_WITH || fuzzy::FuzzyMatch::FUZZY);
+        break;
+      case UseCtx::REGEX: 
+        if (auto ctx = _ctx.lock()) {
+          matched = ctx->CheckEntry(arg);
+        } else {
+          util::Logger()->error("Context for ContextForwarder {} not availible!", _id);
+          matched = false;
+        }
+        break;
     }
-    return true;
   }
-  return false;
+  // Test logic
+  if (matched && _logic != "") {
+    util::Logger()->debug("- LContextForwarder::Check. Test logic");
+    matched = parser.Evaluate(_logic) == "1";
+  }
+  return matched;
 }    
 
 std::string LContextForwarder::GetCtxId(std::weak_ptr<Context> _ctx) {
@@ -2,24 +2,46 @@
 #define SRC_UTILS_EVENTMANAGER_LISTNER_H
 
 #include "shared/utils/defines.h"
+#include "shared/utils/fuzzy_search/name_index.h"
 #include "shared/utils/parser/expression_parser.h"
 #include "shared/utils/utils.h"
 #include <functional>
 #include <memory>
 #include <nlohmann/json.hpp>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 class Context;
+class User;
 
 class Listener {
   public:
-    using Fn = std::function<void(std::string, std::string)>;
+    /**
+     * Handler function: fn(acting-user, event, arguments). The acting user is
+     * nullptr, when an event is thrown without user (f.e. direct calls in tests).
+     */
+    using Fn = std::function<void(User*, std::string, std::string)>;
+
+    /**
+     * Result of testing an event: whether the listener accepts the event and
+     * the captures of its regex (matched once in `Test`, reused by `Execute`).
+     */
+    struct Match {
+      bool _matched = false;
+      std::vector<std::string> _captures;  ///< [0] whole event, [1..n] groups
+      const fuzzy::NameIndex* _names = nullptr;  ///< names of contexts on stack (nullptr: match names directly)
+
+      explicit operator bool() const { return _matched; }
+    };
     
     // getter 
     virtual std::string id() const = 0;
     virtual std::string event() const = 0;
     virtual bool permeable() const = 0;
     virtual std::string arguments() const = 0;
+    virtual std::string prefix() const = 0;  ///< literal every accepted event starts with (may be "")
+    virtual uint8_t kinds() const { return EVENT_ANY; }  ///< kinds of events (EventKind) it might accept
     virtual std::string logic() const { 
       throw util::invalid_base_class_call("invalid_base_class_call: Listener::logic");
     }
@@ -42,8 +64,23 @@ class Listener {
     }
 
     // methods
-    virtual bool Test(const std::string& event, const ExpressionParser& parser) const = 0;
-    virtual void Execute(std::string event) const = 0;
+    /** Tests whether the listener accepts event (`MatchEvent`, then `Check`). */
+    Match Test(const std::string& event, const ExpressionParser& parser) const;
+
+    /**
+     * Part of the test depending only on the event (f.e. the regex): the
+     * result may be reused for the same event, while the listener is unchanged.
+     */
+    virtual Match MatchEvent(const std::string& event) const = 0;
+
+    /** Part of the test depending on state (f.e. logic) of an event matched by `MatchEvent`. */
+    virtual bool Check(const Match& match, const ExpressionParser& parser) const { return true; }
+
+    /**
+     * Executes listener for an event accepted by `Test` (arguments are
+     * replaced from the match, so the regex is not evaluated again).
+     */
+    virtual void Execute(const std::string& event, const Match& match, User* user=nullptr) const = 0;
     virtual nlohmann::json json() const { 
       throw util::invalid_base_class_call("invalid_base_class_call: Listener::json");
     }
@@ -58,14 +95,18 @@ class LHandler : public Listener {
     std::string event() const override;
     bool permeable() const override;
     std::string arguments() const override;
+    std::string prefix() const override;
+    uint8_t kinds() const override;  ///< derived from the bytes the regex may start with
 
     // setter 
     void set_fn(Fn fn) override;
     
     // methods 
-    bool Test(const std::string& event, const ExpressionParser& parser) const override;
 
-    void Execute(std::string event) const override;
+    /** Matches event against the listener's regex. */
+    Match MatchEvent(const std::string& event) const override;
+
+    void Execute(const std::string& event, const Match& match, User* user=nullptr) const override;
     virtual nlohmann::json json() const override;
 
   protected: 
@@ -74,16 +115,54 @@ class LHandler : public Listener {
     std::string _arguments;
     Fn _fn; 
     const bool _permeable;
+    const uint8_t _kinds;
 
     // methods 
 
     /** 
      * Returns either the handlers arguments, the arguments with "#event"
      * replaced by the event, or only the event. 
-     * @parem[in] event 
+     * @parem[in] match (of the event)
      * @return agrument, partyly replaced by event or only event
      */
-    std::string ReplacedArguments(const std::string& event, const std::string& base) const;
+    std::string ReplacedArguments(const Match& match, const std::string& base) const;
+};
+
+/**
+ * Built-in commands dispatched by keyword through a hash table (no regex). A
+ * command with arguments accepts events "<keyword> <args>" (like a handler
+ * with re_event "<keyword> (.*)"), one without only "<keyword>".
+ */
+class LCommandDispatcher : public Listener {
+  public: 
+    LCommandDispatcher(std::string id, bool permeable=true);
+
+    // getter 
+    std::string id() const override;
+    std::string event() const override;
+    bool permeable() const override;
+    std::string arguments() const override;
+    std::string prefix() const override;
+    uint8_t kinds() const override;
+
+    // methods 
+    void AddCommand(const std::string& keyword, Fn fn, bool arguments=true);
+    Match MatchEvent(const std::string& event) const override;
+
+    /** Calls command's function with the arguments (captures[1]). */
+    void Execute(const std::string& event, const Match& match, User* user=nullptr) const override;
+
+  private: 
+    struct Command {
+      Fn _fn;
+      bool _arguments;
+    };
+
+    const std::string _id;
+    const bool _permeable;
+    std::unordered_map<std::string, Command> _commands;
+    std::string _prefix;  ///< common prefix of all keywords
+    size_t _max_words;  ///< words of longest keyword
 };
 
 class LForwarder : public LHandler {
@@ -109,13 +188,17 @@ class LForwarder : public LHandler {
     virtual int use_ctx_regex() const override;
 
     // methods 
-    bool Test(const std::string& event, const ExpressionParser& parser) const override;
+    bool Check(const Match& match, const ExpressionParser& parser) const override;
     nlohmann::json json() const override;
 
+    /**
+     * Sets the default function of forwarders created on this thread without
+     * explicit function (games pass their own function to the parser).
+     */
     static void set_overwite_fn(Fn fn);
 
   protected: 
-    static Fn _overwride_fn;
+    static thread_local Fn _overwride_fn;
     const std::string _logic;
     nlohmann::json _original_json;
 };
@@ -143,7 +226,8 @@ class LContextForwarder : public LForwarder {
     int use_ctx_regex() const override;
 
     // methods 
-    bool Test(const std::string& event, const ExpressionParser& parser) const override;
+    /** Matches the context's name through the match's index of names, if set. */
+    bool Check(const Match& match, const ExpressionParser& parser) const override;
     nlohmann::json json() const override;
 
   private: 
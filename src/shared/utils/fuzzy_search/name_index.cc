@@ -0,0 +1,128 @@
+#include "name_index.h"
+#include <algorithm>
+
+fuzzy::NameIndex::NameIndex() {}
+
+// getter
+size_t fuzzy::NameIndex::size() const {
+  return _names.size();
+}
+
+bool fuzzy::NameIndex::contains(const std::string& name) const {
+  return _names.count(name) > 0;
+}
+
+// methods
+void fuzzy::NameIndex::Add(const std::string& name) {
+  if (_names[name]++ > 0)
+    return;
+  std::string lower = name;
+  convertToLower(lower);
+  _by_lower[lower].push_back(name);
+  if (_nodes.count(lower) == 0)
+    Insert(lower);
+  _last_arg.reset();
+}
+
+void fuzzy::NameIndex::Remove(const std::string& name) {
+  auto it = _names.find(name);
+  if (it == _names.end() || --it->second > 0)
+    return;
+  _names.erase(it);
+  std::string lower = name;
+  convertToLower(lower);
+  auto& names = _by_lower[lower];
+  names.erase(std::remove(names.begin(), names.end(), name), names.end());
+  _last_arg.reset();
+}
+
+const std::map<std::string, fuzzy::FuzzyMatch>& fuzzy::NameIndex::Query(const std::string& arg) const {
+  if (_last_arg && *_last_arg == arg)
+    return _last_matches;
+  _last_matches.clear();
+  std::string lower_arg = arg;
+  convertToLower(lower_arg);
+  for (const auto& lower : Candidates(lower_arg)) {
+    auto it = _by_lower.find(lower);
+    if (it == _by_lower.end())
+      continue;
+    for (const auto& name : it->second) {
+      FuzzyMatch res = fuzzy(name, arg);
+      if (res != FuzzyMatch::NO_MATCH)
+        _last_matches[name] = res;
+    }
+  }
+  _last_arg = arg;
+  return _last_matches;
+}
+
+fuzzy::FuzzyMatch fuzzy::NameIndex::Match(const std::string& name, const std::string& arg) const {
+  if (!contains(name))
+    return fuzzy(name, arg);
+  const auto& matches = Query(arg);
+  auto it = matches.find(name);
+  return (it != matches.end()) ? it->second : FuzzyMatch::NO_MATCH;
+}
+
+void fuzzy::NameIndex::Insert(const std::string& lower) {
+  const size_t id = _tree.size();
+  _tree.push_back({lower, {}});
+  _nodes[lower] = id;
+  for (size_t i = 0; i + 3 <= lower.length(); i++) {
+    auto& names = _trigrams[lower.substr(i, 3)];
+    if (names.empty() || names.back() != lower)
+      names.push_back(lower);
+  }
+  // Walk down the BK-tree to the child at the new name's distance
+  for (size_t cur = 0; cur != id; ) {
+    size_t distance = levenshteinDistance(_tree[cur]._lower.c_str(), lower.c_str());
+    auto [it, inserted] = _tree[cur]._children.emplace(distance, id);
+    cur = (inserted) ? id : it->second;
+  }
+}
+
+std::vector<std::string> fuzzy::NameIndex::Candidates(const std::string& lower_arg) const {
+  std::vector<std::string> candidates;
+  // Short arguments: test all names
+  if (lower_arg.length() < 3) {
+    for (const auto& node : _tree)
+      candidates.push_back(node._lower);
+    return candidates;
+  }
+  // Names containing arg (direct, starts-with and contains match) contain all
+  // of its trigrams: test the names of the rarest one
+  const std::vector<std::string>* rarest = nullptr;
+  for (size_t i = 0; i + 3 <= lower_arg.length(); i++) {
+    auto it = _trigrams.find(lower_arg.substr(i, 3));
+    if (it == _trigrams.end()) {
+      rarest = nullptr;
+      break;
+    }
+    if (!rarest || it->second.size() < rarest->size())
+      rarest = &it->second;
+  }
+  if (rarest) {
+    for (const auto& lower : *rarest) {
+      if (lower.find(lower_arg) != std::string::npos)
+        candidates.push_back(lower);
+    }
+  }
+  // Fuzzy match requires distance <= 0.3 * length of arg
+  const size_t radius = static_cast<size_t>(0.3 * lower_arg.length() + 1e-9);
+  std::vector<size_t> stack;
+  if (!_tree.empty())
+    stack.push_back(0);
+  while (!stack.empty()) {
+    const Node& node = _tree[stack.back()];
+    stack.pop_back();
+    size_t distance = levenshteinDistance(node._lower.c_str(), lower_arg.c_str());
+    if (distance <= radius)
+      candidates.push_back(node._lower);
+    auto it = node._children.lower_bound((distance > radius) ? distance - radius : 0);
+    for (; it != node._children.end() && it->first <= distance + radius; ++it)
+      stack.push_back(it->second);
+  }
+  std::sort(candidates.begin(), candidates.end());
+  candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+  return candidates;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "fuzzy.h"
+#include <map>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace fuzzy
+{
+    /**
+    * Index over names (f.e. of contexts), answering which names match an
+    * argument (like `fuzzy(name, arg)`) in one query: names containing the
+    * argument are found through trigrams, fuzzy matches through a BK-tree of
+    * levenshtein distances (both of lowercased names). The last query is
+    * kept, so all listeners testing the same argument share one query.
+    */
+    class NameIndex {
+      public:
+        NameIndex();
+
+        // getter
+        size_t size() const;  ///< number of different names
+        bool contains(const std::string& name) const;
+
+        // methods
+        void Add(const std::string& name);  ///< (names may be added multiple times)
+        void Remove(const std::string& name);
+
+        /** Names matching arg with their match (all others do not match). */
+        const std::map<std::string, FuzzyMatch>& Query(const std::string& arg) const;
+
+        /** Match of name for arg (equal to fuzzy(name, arg)). */
+        FuzzyMatch Match(const std::string& name, const std::string& arg) const;
+
+      private:
+        struct Node {
+          std::string _lower;
+          std::map<size_t, size_t> _children;  ///< by distance
+        };
+
+        std::unordered_map<std::string, size_t> _names;  ///< number of times added
+        std::unordered_map<std::string, std::vector<std::string>> _by_lower;
+        std::unordered_map<std::string, std::vector<std::string>> _trigrams;  ///< lowercased names by trigram
+        std::vector<Node> _tree;  ///< BK-tree ([0]: root), nodes are never removed
+        std::unordered_map<std::string, size_t> _nodes;  ///< node by lowercased name
+
+        mutable std::optional<std::string> _last_arg;
+        mutable std::map<std::string, FuzzyMatch> _last_matches;
+
+        void Insert(const std::string& lower);
+        std::vector<std::string> Candidates(const std::string& lower_arg) const;
+    };
+}
@@ -0,0 +1,65 @@
+#ifndef SRC_SHARED_UTILS_MPSC_QUEUE_H
+#define SRC_SHARED_UTILS_MPSC_QUEUE_H
+
+#include <atomic>
+#include <optional>
+#include <utility>
+
+namespace util {
+
+  /**
+   * Lock-free multi-producer single-consumer queue (intrusive node queue after
+   * D. Vyukov). Any thread may `Push`, only one thread at a time may `Pop`.
+   */
+  template<typename T>
+  class MPSCQueue {
+    public:
+      MPSCQueue() : _head(new Node()), _tail(_head.load()) {}
+      MPSCQueue(const MPSCQueue&) = delete;
+      MPSCQueue& operator=(const MPSCQueue&) = delete;
+      ~MPSCQueue() {
+        while (Pop()) {}
+        delete _tail;
+      }
+
+      // methods
+
+      /**
+       * Adds value to queue (wait-free, callable from any thread).
+       */
+      void Push(T value) {
+        Node* node = new Node(std::move(value));
+        Node* prev = _head.exchange(node, std::memory_order_acq_rel);
+        prev->_next.store(node, std::memory_order_release);
+      }
+
+      /**
+       * Takes oldest value from queue (consumer thread only). Returns nullopt
+       * if queue is empty or a producer has not finished linking its node yet.
+       */
+      std::optional<T> Pop() {
+        Node* tail = _tail;
+        Node* next = tail->_next.load(std::memory_order_acquire);
+        if (!next)
+          return std::nullopt;
+        std::optional<T> value = std::move(next->_value);
+        next->_value.reset();
+        _tail = next;
+        delete tail;
+        return value;
+      }
+
+    private:
+      struct Node {
+        Node() : _next(nullptr) {}
+        Node(T value) : _value(std::move(value)), _next(nullptr) {}
+        std::optional<T> _value;
+        std::atomic<Node*> _next;
+      };
+
+      std::atomic<Node*> _head;  ///< last pushed node (producers)
+      Node* _tail;  ///< stub node before oldest value (consumer)
+  };
+}
+
+#endif
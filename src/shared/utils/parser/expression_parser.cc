@@ -4,14 +4,63 @@
 #include "shared/utils/fuzzy_search/fuzzy.h"
 #include "shared/utils/utils.h"
 #include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <climits>
+#include <cstdlib>
 #include <exception>
+#include <mutex>
 #include <optional>
+#include <shared_mutex>
 #include <spdlog/spdlog.h>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <tuple>
 
 const std::map<std::string, std::string> ExpressionParser::_default_subsitutes = {{"no_match", "0"}, 
   {"direct", "1"}, {"starts_with", "2"}, {"contains", "3"}, {"fuzzy", "4"}};
 
+/** Whether list b contains a, f.e. "[tabako|lighter]:[bottle; lighter; book]". */
+static bool In(const std::string& a, const std::string& b) {
+  const std::string vec = (a.front() != '[') ? a : a.substr(1, a.length()-2);
+  const std::string vec_b = (b[1] == '\'' && b[b.length()-2] == '\'') 
+    ? b.substr(2, b.length()-4) : b.substr(1, b.length()-2);
+  std::string sep = (vec_b.find(";") != std::string::npos) ? ";" : ",";
+  for (const auto& it : util::Split(vec, "|")) {
+    const std::string e = util::Strip(it);
+    for (const auto& elem : util::Split(vec_b, sep)) {
+      if (util::Strip(elem) == e) return true;
+    }
+  }
+  return false;
+}
+
+/** Fuzzy-matches of a in list b (f.e. "[bottle; Tabako]"). */
+static std::vector<int> FuzzyIn(const std::string& a, const std::string& b) {
+  try {
+    std::vector<int> res_vec;
+    for (const auto& elem : util::Split(b.substr(1, b.length()-1), ";")) {
+      auto res = fuzzy::fuzzy(util::Strip(elem), a);
+      util::Logger()->debug("ExpressionParser: {} ~= {} => {}", util::Strip(elem), a, static_cast<int>(res));
+      if (res != fuzzy::FuzzyMatch::NO_MATCH) {
+        if (res == fuzzy::FuzzyMatch::CONTAINS || res == fuzzy::FuzzyMatch::STARTS_WITH) {
+          if (a.length() > (elem.length())/3) {
+            res_vec.push_back(res);
+          }
+        } else {
+          res_vec.push_back(res);
+        }
+      }
+    }
+    return res_vec;
+  } catch (std::exception& e) {
+    util::Logger()->warn("ExpressionParser: '{} ~: {}' failed: {}", a, b, e.what());
+    return {};
+  }
+}
+
 std::map<std::string, std::string(*)(const std::string&, const std::string&)> ExpressionParser::_opts = {
   {">", [](const std::string& a, const std::string& b) { return std::to_string(std::stoi(a) > std::stoi(b)); } },
   {"<", [](const std::string& a, const std::string& b) { return std::to_string(std::stoi(a) < std::stoi(b)); } },
@@ -28,42 +77,12 @@ std::map<std::string, std::string(*)(const std::string&, const std::string&)> Ex
             return std::to_string(fuzzy::fuzzy(b, a) == fuzzy::FuzzyMatch::CONTAINS); } },
   {"~4", [](const std::string& a, const std::string& b) { 
             return std::to_string(fuzzy::fuzzy(b, a) == fuzzy::FuzzyMatch::FUZZY); } },
-  {":", [](const std::string& a, const std::string& b) -> std::string { 
-          const std::string vec = (a.front() != '[') ? a : a.substr(1, a.length()-2);
-          const std::string vec_b = (b[1] == '\'' && b[b.length()-2] == '\'') 
-            ? b.substr(2, b.length()-4) : b.substr(1, b.length()-2);
-          std::string sep = (vec_b.find(";") != std::string::npos) ? ";" : ",";
-          for (const auto& it : util::Split(vec, "|")) {
-            const std::string e = util::Strip(it);
-            for (const auto& elem : util::Split(vec_b, sep)) {
-              if (util::Strip(elem) == e) return "1";
-            }
-          }
-          return "0";
-        } },
+  {":", [](const std::string& a, const std::string& b) -> std::string { return In(a, b) ? "1" : "0"; } },
   {"~:", [](const std::string& a, const std::string& b) -> std::string { 
-          try {
-            std::string res_vec = "";
-            for (const auto& elem : util::Split(b.substr(1, b.length()-1), ";")) {
-              auto res = fuzzy::fuzzy(util::Strip(elem), a);
-              std::cout << util::Strip(elem) << " ~= " << a << " => " << res << std::endl;
-              if (res != fuzzy::FuzzyMatch::NO_MATCH) {
-                if (res == fuzzy::FuzzyMatch::CONTAINS || res == fuzzy::FuzzyMatch::STARTS_WITH) {
-                  if (a.length() > (elem.length())/3) {
-                    res_vec += std::to_string(res) + ";";
-                  }
-                } else {
-                  res_vec += std::to_string(res) + ";";
-                }
-              }
-            }
-            if (res_vec.back() == ';') 
-              res_vec.pop_back();
-            return "[" + res_vec + "]";
-          } catch (std::exception& e) {
-            util::Logger()->warn("ExpressionParser: '{} ~: {}' failed: {}", a, b, e.what());
-            return "[]";
-          }
+          std::string res_vec = "";
+          for (int res : FuzzyIn(a, b)) 
+            res_vec += ((res_vec == "") ? "" : ";") + std::to_string(res);
+          return "[" + res_vec + "]";
         } },
   {"+", [](const std::string& a, const std::string& b) { return std::to_string(std::stoi(a) + std::stoi(b)); } },
   {"-", [](const std::string& a, const std::string& b) { return std::to_string(std::stoi(a) - std::stoi(b)); } },
@@ -75,20 +94,492 @@ std::map<std::string, std::string(*)(const std::string&, const std::string&)> Ex
  // TODO (fux): try removing ' ' for integer operations
 };
 
+
+/** 
+ * Removes the least recently used quarter of entries of cache (used: tick
+ * of last use of an entry).
+ */
+template <typename Cache, typename Used>
+static void EvictLeastRecentlyUsed(Cache& cache, Used used) {
+  std::vector<uint64_t> ticks;
+  ticks.reserve(cache.size());
+  for (const auto& it : cache) 
+    ticks.push_back(used(it.second));
+  auto nth = ticks.begin() + ticks.size()/4;
+  std::nth_element(ticks.begin(), nth, ticks.end());
+  const uint64_t oldest = *nth;
+  std::erase_if(cache, [&used, oldest](const auto& it) { return used(it.second) < oldest; });
+}
+static constexpr char SLOT_START = '\x01';
+static constexpr char SLOT_END = '\x02';
+
+/** Operators of compiled expressions (same as _opts). */
+enum Operator : uint8_t { GREATER, LESS, GREATER_EQUAL, LESS_EQUAL, EQUAL, NOT_EQUAL, FUZZY, FUZZY_DIRECT, 
+  FUZZY_STARTS_WITH, FUZZY_CONTAINS, FUZZY_FUZZY, IN, FUZZY_IN, PLUS, MINUS, TIMES, DIVIDE, OR, AND };
+
+static const std::map<std::string, Operator> OPERATORS = {{">", GREATER}, {"<", LESS}, 
+  {">=", GREATER_EQUAL}, {"<=", LESS_EQUAL}, {"=", EQUAL}, {"!=", NOT_EQUAL}, {"~", FUZZY}, 
+  {"~1", FUZZY_DIRECT}, {"~2", FUZZY_STARTS_WITH}, {"~3", FUZZY_CONTAINS}, {"~4", FUZZY_FUZZY}, {":", IN}, 
+  {"~:", FUZZY_IN}, {"+", PLUS}, {"-", MINUS}, {"*", TIMES}, {"/", DIVIDE}, {"||", OR}, {"&&", AND}};
+
+/** Placeholder of k-th slot in compiled expression (contains no operators or brackets). */
+static std::string Slot(size_t k) {
+  return std::string(1, SLOT_START) + std::to_string(k) + SLOT_END;
+}
+
+/**
+ * Whether value can fill a slot without changing how the expression is
+ * parsed: no quotes or brackets and, unless inside quotes, no operators.
+ */
+static bool Inert(const std::string& value, bool in_quotes) {
+  for (char c : value) {
+    if (c == '\'' || c == '(' || c == ')')
+      return false;
+    if (!in_quotes && std::string_view("<>=!~:+-*/|&").find(c) != std::string_view::npos)
+      return false;
+  }
+  return true;
+}
+
+/** Number as parsed by std::stoi, without throwing. */
+static std::optional<int> ToInt(const std::string& str) {
+  const char* begin = str.c_str();
+  char* end = nullptr;
+  errno = 0;
+  const long res = std::strtol(begin, &end, 10);
+  if (end == begin || errno == ERANGE || res < INT_MIN || res > INT_MAX)
+    return std::nullopt;
+  return static_cast<int>(res);
+}
+
+static std::optional<int> Number(const ExpressionParser::Value& value) {
+  if (value._type == ExpressionParser::Value::INT || value._type == ExpressionParser::Value::BOOL 
+      || (value._type == ExpressionParser::Value::STRING && value._numeric))
+    return value._int;
+  return std::nullopt;
+}
+
+/** String form of value (numbers written to buf, not allocating). */
+static std::string_view View(const ExpressionParser::Value& value, std::array<char, 16>& buf) {
+  if (value._type != ExpressionParser::Value::INT && value._type != ExpressionParser::Value::BOOL)
+    return value._str;
+  auto [end, ec] = std::to_chars(buf.data(), buf.data() + buf.size(), value._int);
+  return std::string_view(buf.data(), end - buf.data());
+}
+
+static bool Equal(const ExpressionParser::Value& a, const ExpressionParser::Value& b) {
+  std::array<char, 16> buf_a;
+  std::array<char, 16> buf_b;
+  return View(a, buf_a) == View(b, buf_b);
+}
+
+static bool Truthy(const ExpressionParser::Value& value) {
+  std::array<char, 16> buf;
+  return View(value, buf) == "1";
+}
+
+/** In() for list of numbers b (not empty). */
+static bool InList(const ExpressionParser::Value& a, const std::vector<int>& b) {
+  std::string vec = a.str();
+  if (vec.front() == '[') 
+    vec = vec.substr(1, vec.length()-2);
+  std::array<char, 16> buf;
+  for (const auto& it : util::Split(vec, "|")) {
+    const std::string e = util::Strip(it);
+    for (int elem : b) {
+      if (View(ExpressionParser::Value::Int(elem), buf) == e) 
+        return true;
+    }
+  }
+  return false;
+}
+
+/** Applies operator like _opts, but without converting typed values to strings. */
+static ExpressionParser::Value Apply(Operator opt, const ExpressionParser::Value& a, 
+    const ExpressionParser::Value& b) {
+  using Value = ExpressionParser::Value;
+  switch (opt) {
+    case EQUAL: 
+      return Value::Int(Equal(a, b), Value::BOOL);
+    case NOT_EQUAL: 
+      return Value::Int(!Equal(a, b), Value::BOOL);
+    case OR: 
+      return Value::Int(Truthy(a) || Truthy(b), Value::BOOL);
+    case AND: 
+      return Value::Int(Truthy(a) && Truthy(b), Value::BOOL);
+    case FUZZY: 
+      return Value::Int(fuzzy::fuzzy(b.str(), a.str()));
+    case FUZZY_DIRECT: 
+      return Value::Int(fuzzy::fuzzy(b.str(), a.str()) == fuzzy::FuzzyMatch::DIRECT, Value::BOOL);
+    case FUZZY_STARTS_WITH: 
+      return Value::Int(fuzzy::fuzzy(b.str(), a.str()) == fuzzy::FuzzyMatch::STARTS_WITH, Value::BOOL);
+    case FUZZY_CONTAINS: 
+      return Value::Int(fuzzy::fuzzy(b.str(), a.str()) == fuzzy::FuzzyMatch::CONTAINS, Value::BOOL);
+    case FUZZY_FUZZY: 
+      return Value::Int(fuzzy::fuzzy(b.str(), a.str()) == fuzzy::FuzzyMatch::FUZZY, Value::BOOL);
+    case IN: 
+      if (b._type == Value::LIST && !b._list.empty() && a._type != Value::LIST)
+        return Value::Int(InList(a, b._list), Value::BOOL);
+      if (b._type != Value::INT && b._type != Value::BOOL && b._str.empty())
+        return Value::Error("':' without list");
+      return Value::Int(In(a.str(), b.str()), Value::BOOL);
+    case FUZZY_IN: 
+      return Value::List(FuzzyIn(a.str(), b.str()));
+    default: 
+      break;
+  }
+
+  // Numerical operators
+  auto x = Number(a);
+  auto y = Number(b);
+  if (!x || !y)
+    return Value::Error("not a number: '" + a.str() + "' or '" + b.str() + "'");
+  switch (opt) {
+    case GREATER: return Value::Int(*x > *y, Value::BOOL);
+    case LESS: return Value::Int(*x < *y, Value::BOOL);
+    case GREATER_EQUAL: return Value::Int(*x >= *y, Value::BOOL);
+    case LESS_EQUAL: return Value::Int(*x <= *y, Value::BOOL);
+    case PLUS: return Value::Int(*x + *y);
+    case MINUS: return Value::Int(*x - *y);
+    case TIMES: return Value::Int(*x * *y);
+    case DIVIDE: 
+      if (*y == 0)
+        return Value::Error("division by zero");
+      return Value::Int(*x / *y);
+    default: 
+      return Value::Error("unknown operator");
+  }
+}
+
+ExpressionParser::Value ExpressionParser::Value::String(std::string str) {
+  Value value;
+  value._str = std::move(str);
+  if (auto num = ToInt(value._str)) {
+    value._numeric = true;
+    value._int = *num;
+  }
+  return value;
+}
+
+ExpressionParser::Value ExpressionParser::Value::Int(int i, Type type) {
+  Value value;
+  value._type = type;
+  value._int = i;
+  return value;
+}
+
+ExpressionParser::Value ExpressionParser::Value::List(std::vector<int> list) {
+  Value value;
+  value._type = LIST;
+  value._str = "[";
+  for (size_t i=0; i<list.size(); i++) 
+    value._str += ((i > 0) ? ";" : "") + std::to_string(list[i]);
+  value._str += "]";
+  value._list = std::move(list);
+  return value;
+}
+
+ExpressionParser::Value ExpressionParser::Value::Error(std::string msg) {
+  Value value;
+  value._type = ERROR;
+  value._str = std::move(msg);
+  return value;
+}
+
+std::string ExpressionParser::Value::str() const {
+  if (_type == INT || _type == BOOL)
+    return std::to_string(_int);
+  return _str;
+}
+
+/** Operand of compiled expression: text and slots (value computed once, if no slots). */
+struct ExpressionParser::Operand {
+  std::vector<std::pair<std::string, int>> _pieces;  ///< text or slot (text: -1)
+  bool _strip_spaces = false;  ///< right operand: strip spaces first
+  std::optional<Value> _value;
+  int _slot = -1;  ///< operand is result of brackets only (value used as is)
+
+  Operand(const std::string& str, bool strip_spaces) : _strip_spaces(strip_spaces) {
+    size_t pos = 0;
+    while (pos < str.length()) {
+      size_t start = str.find(SLOT_START, pos);
+      if (start == std::string::npos) 
+        start = str.length();
+      if (start > pos)
+        _pieces.push_back({str.substr(pos, start-pos), -1});
+      if (start == str.length())
+        break;
+      size_t end = str.find(SLOT_END, start);
+      _pieces.push_back({"", std::stoi(str.substr(start+1, end-start-1))});
+      pos = end+1;
+    }
+    if (std::none_of(_pieces.begin(), _pieces.end(), [](const auto& it) { return it.second != -1; }))
+      _value = Value::String(Strip(str));
+    else if (_pieces.size() == 1)
+      _slot = _pieces.front().second;
+  }
+
+  Value Get(const std::vector<Value>& slots) const {
+    if (_value)
+      return *_value;
+    if (_slot != -1)
+      return slots[_slot];
+    std::string str = "";
+    for (const auto& [text, slot] : _pieces) 
+      str += (slot == -1) ? text : slots[slot].str();
+    return Value::String(Strip(str));
+  }
+
+  std::string Strip(const std::string& str) const {
+    return StripAndSubstitute(_strip_spaces ? util::Strip(str) : str);
+  }
+};
+
+struct ExpressionParser::Instruction {
+  /** 
+   * AND_THEN/ OR_ELSE: if top of stack decides '&&'/'||', replace it with
+   * result and skip right operand.
+   */
+  enum Op : uint8_t { PUSH, OPERATE, STORE, AND_THEN, OR_ELSE };
+  Op _op;
+  uint32_t _arg;  ///< PUSH: operand, OPERATE: operator, STORE: slot, AND_THEN/ OR_ELSE: instructions to skip
+};
+
+struct ExpressionParser::Program {
+  std::vector<Instruction> _code;
+  std::vector<Operand> _operands;
+  std::map<size_t, std::vector<Instruction>> _brackets;  ///< (compiling) code of brackets not used yet
+  size_t _substitutes = 0;
+  size_t _slots = 0;  ///< substitutes and brackets
+  size_t _stack = 0;  ///< maximum stack size
+};
+
+struct ExpressionParser::Pool {
+  struct Entry {
+    std::shared_ptr<const Compiled> _compiled;
+    std::atomic<uint64_t> _used;  ///< tick of last use (updated under shared lock)
+
+    Entry(std::shared_ptr<const Compiled> compiled, uint64_t used) 
+      : _compiled(std::move(compiled)), _used(used) {}
+  };
+
+  std::shared_mutex _mutex;
+  std::unordered_map<std::string, Entry> _compiled;
+  std::atomic<uint64_t> _tick = 0;
+
+  /** Removes the least recently used quarter of compiled expressions (caller holds unique lock). */
+  void Evict() {
+    EvictLeastRecentlyUsed(_compiled, [](const Entry& entry) { 
+        return entry._used.load(std::memory_order_relaxed); });
+  }
+};
+
+ExpressionParser::Pool& ExpressionParser::GetPool() {
+  static Pool pool;
+  return pool;
+}
+
+ExpressionParser::SubstitutionStats ExpressionParser::substitution_stats() {
+  return {_substitutions_resolved.load(), _substitutions_skipped.load()};
+}
+
+size_t ExpressionParser::compiled() {
+  auto& pool = GetPool();
+  std::shared_lock lock(pool._mutex);
+  return pool._compiled.size();
+}
+
 ExpressionParser::ExpressionParser() { 
   _substitute_fn = [](const auto& str) -> std::string { 
     util::Logger()->debug("CALLED default substitute-fn with {}", str);
     return ""; 
   };
 }
-ExpressionParser::ExpressionParser(const SubstituteFN& fn) {
+ExpressionParser::ExpressionParser(const SubstituteFN& fn, bool cache_conditions) 
+    : _cache_conditions(cache_conditions) {
   _substitute_fn = [fn](const std::string& str) {
     util::Logger()->debug("CALLED custom substitute-fn with {}", str);
     return fn(str);
   };
 }
 
+ExpressionParser::ExpressionParser(const ExpressionParser& other) 
+    : _substitute_fn(other._substitute_fn), _cache_conditions(other._cache_conditions) {}
+
+ExpressionParser& ExpressionParser::operator=(const ExpressionParser& other) {
+  _substitute_fn = other._substitute_fn;
+  _cache_conditions = other._cache_conditions;
+  _memo = MemoState();
+  _tracking = Tracking();
+  _conditions.clear();
+  return *this;
+}
+
+ExpressionParser::Memo::Memo(const ExpressionParser& parser, std::function<uint64_t()> version) 
+    : _parser(parser), _owner(!parser._memo._active) {
+  if (_owner) {
+    _parser._memo._active = true;
+    _parser._memo._version = std::move(version);
+    _parser._memo._at = _parser._memo._version();
+  }
+}
+
+ExpressionParser::Memo::~Memo() {
+  if (_owner) {
+    _parser._memo = MemoState();
+  }
+}
+
+void ExpressionParser::Memo::Clear() {
+  _parser._memo._results.clear();
+}
+
+bool ExpressionParser::Unchanged(const std::vector<Dependency>& dependencies) {
+  return std::all_of(dependencies.begin(), dependencies.end(), [](const auto& dep) { 
+      return dep._version->load(std::memory_order_acquire) == dep._at; });
+}
+
 std::string ExpressionParser::Evaluate(std::string input, bool only_substitute) const {
+  if (!_cache_conditions)
+    return EvaluateMemoized(input)._result;
+
+  // Cached condition, if none of its dependencies changed
+  auto it = _conditions.find(input);
+  if (it != _conditions.end() && Unchanged(it->second._condition._dependencies)) {
+    _condition_hits.fetch_add(1, std::memory_order_relaxed);
+    util::Logger()->debug("EP:Evaluate. unchanged: {} =>: {}", input, it->second._condition._result);
+    it->second._used = _conditions_tick++;
+    Track(it->second._condition);
+    return it->second._condition._result;
+  }
+
+  Condition res = EvaluateMemoized(input);
+  if (!res._untracked) {
+    _condition_misses.fetch_add(1, std::memory_order_relaxed);
+    if (_conditions.size() >= MAX_CONDITIONS && !_conditions.contains(input)) 
+      EvictLeastRecentlyUsed(_conditions, [](const CachedCondition& cached) { return cached._used; });
+    _conditions[input] = {res, _conditions_tick++};
+  } else {
+    _conditions.erase(input);
+  }
+  return res._result;
+}
+
+ExpressionParser::Condition ExpressionParser::EvaluateMemoized(const std::string& input) const {
+  uint64_t version = 0;
+  if (_memo._active) {
+    _memo_evaluations.fetch_add(1, std::memory_order_relaxed);
+    version = _memo._version();
+    if (version != _memo._at) {
+      _memo._results.clear();
+      _memo._at = version;
+    }
+    // (results with declared dependencies: only if none of them changed, f.e. by a handler)
+    auto it = _memo._results.find(input);
+    if (it != _memo._results.end() && (it->second._untracked || Unchanged(it->second._dependencies))) {
+      _memo_saved.fetch_add(1, std::memory_order_relaxed);
+      util::Logger()->debug("EP:Evaluate. memoized: {} =>: {}", input, it->second._result);
+      Track(it->second);
+      return it->second;
+    }
+  }
+  // (substitutes might evaluate nested expressions)
+  const bool outer_not_memoizable = _memo._not_memoizable;
+  _memo._not_memoizable = false;
+  Condition res = EvaluateTracked(input);
+  if (_memo._active && !_memo._not_memoizable && _memo._version() == version)
+    _memo._results[input] = res;
+  _memo._not_memoizable = _memo._not_memoizable || outer_not_memoizable;
+  return res;
+}
+
+ExpressionParser::Condition ExpressionParser::EvaluateTracked(const std::string& input) const {
+  Tracking outer = std::exchange(_tracking, Tracking());
+  _tracking._active = true;
+  Condition res;
+  try {
+    res._result = EvaluateUncached(input);
+  } catch (...) {
+    _tracking = std::move(outer);
+    _tracking._untracked = true;
+    throw;
+  }
+  res._untracked = _tracking._untracked;
+  res._dependencies = std::move(_tracking._dependencies);
+  auto& deps = res._dependencies;
+  std::sort(deps.begin(), deps.end(), [](const auto& a, const auto& b) { 
+      return std::tie(a._version, a._at) < std::tie(b._version, b._at); });
+  deps.erase(std::unique(deps.begin(), deps.end(), [](const auto& a, const auto& b) { 
+        return a._version == b._version && a._at == b._at; }), deps.end());
+  _tracking = std::move(outer);
+  Track(res);
+  return res;
+}
+
+void ExpressionParser::Track(const Condition& res) const {
+  if (!_tracking._active)
+    return;
+  _tracking._dependencies.insert(_tracking._dependencies.end(), res._dependencies.begin(), 
+      res._dependencies.end());
+  _tracking._declared = true;
+  _tracking._untracked = _tracking._untracked || res._untracked;
+}
+
+void ExpressionParser::NotMemoizable() const {
+  _memo._not_memoizable = true;
+  _tracking._untracked = true;
+}
+
+void ExpressionParser::DependsOn(std::shared_ptr<const Version> version) const {
+  if (!_tracking._active)
+    return;
+  const uint64_t at = version->load(std::memory_order_acquire);
+  _tracking._dependencies.push_back({std::move(version), at});
+  _tracking._declared = true;
+}
+
+ExpressionParser::ConditionStats ExpressionParser::condition_stats() {
+  return {_condition_hits.load(), _condition_misses.load()};
+}
+
+ExpressionParser::MemoStats ExpressionParser::memo_stats() {
+  return {_memo_evaluations.load(), _memo_saved.load()};
+}
+
+std::string ExpressionParser::EvaluateUncached(const std::string& input) const {
+  auto compiled = Compile(input);
+  if (!compiled->_program)
+    return EvaluateInterpreted(input);
+  util::Logger()->info("EP:Evaluate. START: {}", input);
+
+  // Substitutes are resolved when needed
+  std::vector<std::optional<std::string>> replacements(compiled->_substitutes.size());
+  auto res = Run(*compiled, replacements);
+  auto replaced = [&]() {
+    std::string replaced = compiled->_texts[0];
+    for (size_t i=0; i<replacements.size(); i++) {
+      if (!replacements[i]) {
+        util::Logger()->info("FOUND SUBSTITUE: {}", compiled->_substitutes[i]);
+        replacements[i] = Replacement(compiled->_substitutes[i]);
+      }
+      replaced += *replacements[i] + compiled->_texts[i+1];
+    }
+    return replaced;
+  };
+  if (!res) 
+    return EvaluateSubstituted(replaced());
+  if (res->_type == Value::ERROR) {
+    util::Logger()->warn("ExpressionParser::evaluate failed: {}. Returning replaces string", res->_str);
+    return replaced();
+  }
+  const size_t skipped = std::count(replacements.begin(), replacements.end(), std::nullopt);
+  if (skipped > 0)
+    _substitutions_skipped.fetch_add(skipped, std::memory_order_relaxed);
+  util::Logger()->info("EP:Evaluate. =>: {}", res->str());
+  return res->str();
+}
+
+std::string ExpressionParser::EvaluateInterpreted(const std::string& input) const {
   util::Logger()->info("EP:Evaluate. START: {}", input);
 
   // Check for substitutes
@@ -100,19 +591,7 @@ std::string ExpressionParser::Evaluate(std::string input, bool only_substitute)
       // Get substitute-name (string inbetween brackets) and check if it exists
       std::string subsitute = input.substr(i+1, closing-(i+1));
       util::Logger()->info("FOUND SUBSTITUE: {}", subsitute);
-      std::string replacement = "";
-      if (_default_subsitutes.count(subsitute) > 0) {
-        replacement = _default_subsitutes.at(subsitute);
-      } else {
-        replacement = _substitute_fn(subsitute);
-        if (replacement == "") {
-          replacement = "''";
-        } else if (replacement == txtad::NO_REPLACEMENT) {
-          util::Logger()->error("No subsitute found for: {}", subsitute);
-        } else {
-          replacement = "\'" + replacement + "\'";
-        }
-      } 
+      std::string replacement = Replacement(subsitute);
       if (replacement != "") {
         // Add substituted string to replaced string and increase index
         replaced += replacement;
@@ -122,7 +601,10 @@ std::string ExpressionParser::Evaluate(std::string input, bool only_substitute)
       replaced += input[i]; // add current char
     }
   }
+  return EvaluateSubstituted(replaced);
+}
 
+std::string ExpressionParser::EvaluateSubstituted(const std::string& replaced) const {
   std::string res = "";
   try {
     res = evaluate(EnsureExecutionOrder(replaced));
@@ -136,6 +618,212 @@ std::string ExpressionParser::Evaluate(std::string input, bool only_substitute)
   return res;
 }
 
+std::string ExpressionParser::Replacement(const std::string& subsitute) const {
+  if (_default_subsitutes.count(subsitute) > 0) 
+    return _default_subsitutes.at(subsitute);
+  _substitutions_resolved.fetch_add(1, std::memory_order_relaxed);
+  // Substitutes not declaring what they read make the result untracked
+  const bool declared = std::exchange(_tracking._declared, false);
+  std::string replacement = _substitute_fn(subsitute);
+  if (!_tracking._declared)
+    _tracking._untracked = true;
+  _tracking._declared = declared;
+  if (replacement == "") {
+    return "''";
+  } else if (replacement == txtad::NO_REPLACEMENT) {
+    util::Logger()->error("No subsitute found for: {}", subsitute);
+    return replacement;
+  } 
+  return "\'" + replacement + "\'";
+}
+
+std::optional<ExpressionParser::Value> ExpressionParser::Run(const Compiled& compiled, 
+    std::vector<std::optional<std::string>>& replacements) const {
+  const Program& program = *compiled._program;
+  std::vector<Value> slots(program._slots);
+  std::vector<Value> stack;
+  stack.reserve(program._stack);
+  for (size_t pc=0; pc<program._code.size(); pc++) {
+    const auto& [op, arg] = program._code[pc];
+    switch (op) {
+      case Instruction::PUSH: {
+        const Operand& operand = program._operands[arg];
+        for (const auto& [text, slot] : operand._pieces) {
+          if (slot == -1 || static_cast<size_t>(slot) >= program._substitutes || replacements[slot])
+            continue;
+          util::Logger()->info("FOUND SUBSTITUE: {}", compiled._substitutes[slot]);
+          replacements[slot] = Replacement(compiled._substitutes[slot]);
+          const std::string& replacement = *replacements[slot];
+          if (replacement == txtad::NO_REPLACEMENT 
+              || !Inert(replacement.substr(1, replacement.length()-2), compiled._in_quotes[slot]))
+            return std::nullopt;
+          slots[slot] = Value::String(replacement.substr(1, replacement.length()-2));
+        }
+        stack.push_back(operand.Get(slots));
+        break;
+      }
+      case Instruction::STORE: {
+        // Result of brackets replaces brackets: must not add operators, etc.
+        Value& value = stack.back();
+        if ((value._type == Value::INT && value._int < 0) || ((value._type == Value::STRING 
+                || value._type == Value::LIST) && (value._str.empty() || !Inert(value._str, false)))) 
+          return std::nullopt;
+        slots[arg] = std::move(value);
+        stack.pop_back();
+        break;
+      }
+      case Instruction::OPERATE: {
+        Value b = std::move(stack.back());
+        stack.pop_back();
+        Value& a = stack.back();
+        a = Apply(static_cast<Operator>(arg), a, b);
+        if (a._type == Value::ERROR)
+          return std::move(a);
+        break;
+      }
+      case Instruction::AND_THEN: 
+      case Instruction::OR_ELSE: {
+        Value& a = stack.back();
+        if (Truthy(a) == (op == Instruction::OR_ELSE)) {
+          a = Value::Int(op == Instruction::OR_ELSE, Value::BOOL);
+          pc += arg;
+        }
+        break;
+      }
+    }
+  }
+  return std::move(stack.back());
+}
+
+std::shared_ptr<const ExpressionParser::Compiled> ExpressionParser::Compile(const std::string& input) {
+  auto& pool = GetPool();
+  {
+    std::shared_lock lock(pool._mutex);
+    auto it = pool._compiled.find(input);
+    if (it != pool._compiled.end()) {
+      it->second._used.store(pool._tick.fetch_add(1, std::memory_order_relaxed), std::memory_order_relaxed);
+      return it->second._compiled;
+    }
+  }
+  
+  auto compiled = std::make_shared<Compiled>();
+  compiled->_texts.push_back("");
+  // Build expression with substitutes replaced by (quoted) slots
+  std::string templ = "";
+  bool compilable = input.find_first_of(std::string{SLOT_START, SLOT_END}) == std::string::npos;
+  for (int i=0; i<input.length() && compilable; i++) {
+    if (input[i] != '{') {
+      templ += input[i];
+      compiled->_texts.back() += input[i];
+      continue;
+    }
+    int closing = util::ClosingBracket(input, i+1, '{', '}');
+    if (closing == -1) {
+      compilable = false;
+      break;
+    }
+    std::string subsitute = input.substr(i+1, closing-(i+1));
+    if (_default_subsitutes.count(subsitute) > 0) {
+      templ += _default_subsitutes.at(subsitute);
+      compiled->_texts.back() += _default_subsitutes.at(subsitute);
+    } else {
+      templ += "'" + Slot(compiled->_substitutes.size()) + "'";
+      compiled->_substitutes.push_back(subsitute);
+      compiled->_texts.push_back("");
+    }
+    i = closing;
+  }
+
+  // Substitutes inside quotes may contain operators (skipped when parsing),
+  // if quotes are balanced and there are no brackets inside quotes.
+  bool escaped = false;
+  bool brackets_in_quotes = false;
+  for (char c : templ) {
+    if (c == '\'') 
+      escaped = !escaped;
+    else if (escaped && (c == '(' || c == ')'))
+      brackets_in_quotes = true;
+    else if (c == SLOT_START)
+      compiled->_in_quotes.push_back(escaped);
+  }
+  if (escaped || brackets_in_quotes) 
+    compiled->_in_quotes.assign(compiled->_in_quotes.size(), false);
+
+  if (compilable) {
+    try {
+      auto program = std::make_unique<Program>();
+      program->_substitutes = program->_slots = compiled->_substitutes.size();
+      Emit(EnsureExecutionOrder(templ), *program, program->_code);
+      if (!program->_brackets.empty())
+        throw std::logic_error("result of brackets not used");
+      size_t stack = 0;
+      for (const auto& [op, arg] : program->_code) {
+        if (op == Instruction::PUSH)
+          stack++;
+        else if (op == Instruction::OPERATE || op == Instruction::STORE) 
+          stack--;
+        program->_stack = std::max(program->_stack, stack);
+      }
+      compiled->_program = std::move(program);
+    } catch (std::exception& e) {
+      util::Logger()->debug("ExpressionParser::Compile: \"{}\" interpreted: {}", input, e.what());
+    }
+  }
+
+  std::unique_lock lock(pool._mutex);
+  if (pool._compiled.size() >= MAX_COMPILED) 
+    pool.Evict();
+  const uint64_t tick = pool._tick.fetch_add(1, std::memory_order_relaxed);
+  return pool._compiled.try_emplace(input, compiled, tick).first->second._compiled;
+}
+
+void ExpressionParser::Emit(const std::string& input, Program& program, std::vector<Instruction>& code) {
+  // Adds operand, preceded by code of brackets it contains
+  auto push = [&program, &code](const std::string& str, bool strip_spaces) {
+    Operand operand(str, strip_spaces);
+    for (const auto& [text, slot] : operand._pieces) {
+      if (slot == -1)
+        continue;
+      auto it = program._brackets.find(slot);
+      if (it != program._brackets.end()) {
+        code.insert(code.end(), it->second.begin(), it->second.end());
+        program._brackets.erase(it);
+      }
+    }
+    code.push_back({Instruction::PUSH, static_cast<uint32_t>(program._operands.size())});
+    program._operands.push_back(std::move(operand));
+  };
+
+  auto [pos, opt] = LastOpt(input); 
+  if (pos == -1) 
+    return push(input, false);
+
+  // Brackets: result replaces brackets in expression
+  auto [start, end] = util::InBrackets(input, pos);
+  if (start != -1 && end != -1) {
+    if (start > 0 && input[start-1] == '~') 
+      throw std::invalid_argument("result of brackets might be part of operator");
+    const size_t slot = program._slots++;
+    std::vector<Instruction> bracket;
+    Emit(input.substr(start+1, end-start-1), program, bracket);
+    bracket.push_back({Instruction::STORE, static_cast<uint32_t>(slot)});
+    program._brackets[slot] = std::move(bracket);
+    Emit(input.substr(0, start) + Slot(slot) + input.substr(end+1), program, code);
+    return;
+  }
+
+  Emit(input.substr(0, pos), program, code);
+  // '&&' and '||': skip right operand if left operand decides result
+  const bool short_circuit = opt == "&&" || opt == "||";
+  const size_t skip = code.size();
+  if (short_circuit) 
+    code.push_back({(opt == "&&") ? Instruction::AND_THEN : Instruction::OR_ELSE, 0});
+  push(input.substr(pos+opt.length(), input.length()-(pos + opt.length()-1)), true);
+  code.push_back({Instruction::OPERATE, OPERATORS.at(opt)});
+  if (short_circuit)
+    code[skip]._arg = code.size() - skip - 1;
+}
+
 std::string ExpressionParser::evaluate(std::string input) const {
   util::Logger()->debug("EP:Evaluate. {}", input);
   auto [pos, opt] = LastOpt(input); 
@@ -160,7 +848,7 @@ std::string ExpressionParser::evaluate(std::string input) const {
   return (*_opts[opt])(StripAndSubstitute(a), StripAndSubstitute(b)); 
 }
 
-std::string ExpressionParser::StripAndSubstitute(std::string str) const {
+std::string ExpressionParser::StripAndSubstitute(std::string str) {
   // strip string from whitespaces and brackets
   return util::Strip(str, {')', '(', '\'', ' '});
 }
@@ -5,13 +5,77 @@
 #define SHARED_UTILS_PARSER_EXPRESSIONPARSER_H_
 
 #include "game/utils/defines.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
 #include <map>
+#include <memory>
 #include <optional>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 class ExpressionParser{
   public:
     using SubstituteFN = std::function<std::string(std::string)>;
+    using Version = std::atomic<uint64_t>;  ///< version of state read by substitutes (see DependsOn)
+    static constexpr size_t MAX_COMPILED = 4096;  ///< compiled expressions kept (least recently used evicted)
+    static constexpr size_t MAX_CONDITIONS = 1024;  ///< cached conditions per parser (least recently used evicted)
+
+    /**
+     * Typed value of compiled expressions: results of operators stay numbers,
+     * booleans or lists and strings are parsed as numbers once. Errors (f.e.
+     * non-numeric operands of '+') are values, too.
+     */
+    struct Value {
+      enum Type : uint8_t { INT, BOOL, STRING, LIST, ERROR };
+      Type _type = STRING;
+      int _int = 0;  ///< INT, BOOL (0|1), STRING: parsed number (if _numeric)
+      bool _numeric = false;  ///< STRING: whether string is a number
+      std::string _str;  ///< STRING: string, LIST: string form, ERROR: message
+      std::vector<int> _list;  ///< LIST: elements
+
+      static Value String(std::string str);
+      static Value Int(int i, Type type=INT);
+      static Value List(std::vector<int> list);
+      static Value Error(std::string msg);
+      std::string str() const;  ///< as returned by Evaluate
+    };
+
+    struct MemoStats {
+      size_t _evaluations;  ///< expressions evaluated while memo was active
+      size_t _saved;  ///< evaluations answered from memo
+    };
+
+    struct SubstitutionStats {
+      size_t _resolved;  ///< substitutes resolved
+      size_t _skipped;  ///< substitutes of compiled expressions not needed (f.e. after "0 &&")
+    };
+
+    struct ConditionStats {
+      size_t _hits;  ///< evaluations answered by cached condition (no dependency changed)
+      size_t _misses;  ///< evaluations of conditions cached afterwards
+    };
+
+    /**
+     * While a memo exists, results of evaluated expressions are cached (f.e.
+     * the same logic of many listeners, evaluated for one event) until
+     * version() changes or the memo is cleared. Results, whose substitutes
+     * declared what they read (see DependsOn), are also recomputed when one
+     * of these versions changed. Results depending on non-deterministic
+     * substitutes (see NotMemoizable) are not cached.
+     * Nested memos of the same parser use the outer memo.
+     */
+    class Memo {
+      public:
+        Memo(const ExpressionParser& parser, std::function<uint64_t()> version);
+        ~Memo();
+        void Clear();
+
+      private:
+        const ExpressionParser& _parser;
+        bool _owner;
+    };
     
     /**
      * Constructor including the possibility to substitute certain strings
@@ -19,9 +83,12 @@ class ExpressionParser{
      * room by including {"room", [current_room]} to the map. Then room will 
      * be substituted by the value of [current_room]).
      * @param[in] substitute (map with possible substitutes)
+     * @param[in] cache_conditions (cache results until a dependency changes, see DependsOn)
      */
     ExpressionParser();
-    ExpressionParser(const SubstituteFN& fn);
+    ExpressionParser(const SubstituteFN& fn, bool cache_conditions=false);
+    ExpressionParser(const ExpressionParser& other);  ///< (caches are not copied)
+    ExpressionParser& operator=(const ExpressionParser& other);
 
     /**
      * return value of logical or mathematical expression
@@ -46,16 +113,123 @@ class ExpressionParser{
      */
     std::string Evaluate(std::string input, bool only_substitute=false) const;
 
+    /**
+     * Evaluates input by interpreting the (substituted) string directly. Same
+     * result as Evaluate, which compiles every input once and falls back to
+     * this, where substitutes would change the structure of the expression
+     * (except, that Evaluate skips right operands of '&&' and '||', if the
+     * left operand decides the result, so their substitutes are not resolved
+     * and errors there are ignored).
+     */
+    std::string EvaluateInterpreted(const std::string& input) const;
+
+    /** Marks expression currently evaluated as not cachable (f.e. random numbers). */
+    void NotMemoizable() const;
+
+    /**
+     * Declares that the substitute currently resolved read state of the given
+     * version (f.e. attributes of a context). If all substitutes of an
+     * expression declared their dependencies, its result is cached until the
+     * version of one of them changes (only if caching conditions).
+     */
+    void DependsOn(std::shared_ptr<const Version> version) const;
+    static MemoStats memo_stats();
+    static size_t compiled();  ///< number of cached compiled expressions
+    static SubstitutionStats substitution_stats();
+    static ConditionStats condition_stats();
+
   private:
+    struct Operand;
+    struct Instruction;
+    struct Program;
+    struct Pool;
+
+    /** 
+     * Input compiled to bytecode. Substitutes and results of brackets are
+     * slots in the operands, filled when evaluated.
+     */
+    struct Compiled {
+      std::vector<std::string> _substitutes;  ///< names of substitutes in order of appearance
+      std::vector<bool> _in_quotes;  ///< per substitute: inside quotes (operators not parsed)
+      std::vector<std::string> _texts;  ///< text around substitutes (to build substituted string)
+      std::unique_ptr<const Program> _program;  ///< nullptr if not compilable (input is interpreted)
+    };
+
+    struct Dependency {
+      std::shared_ptr<const Version> _version;
+      uint64_t _at;  ///< version when read
+    };
+
+    struct Condition {
+      std::string _result;
+      std::vector<Dependency> _dependencies;
+      bool _untracked = false;  ///< result depends on state without declared version
+    };
+
+    struct CachedCondition {
+      Condition _condition;
+      uint64_t _used;  ///< tick of last use
+    };
+
+    /** Dependencies of expression currently evaluated. */
+    struct Tracking {
+      bool _active = false;
+      std::vector<Dependency> _dependencies;
+      bool _declared = false;  ///< substitute currently resolved declared dependencies
+      bool _untracked = false;  ///< result depends on state without declared version
+    };
+
+    struct MemoState {
+      bool _active = false;
+      std::function<uint64_t()> _version;
+      uint64_t _at = 0;  ///< version results were cached at
+      bool _not_memoizable = false;
+      std::unordered_map<std::string, Condition> _results;
+    };
 
     // members 
     SubstituteFN _substitute_fn;  ///< map with substitutes.
+    bool _cache_conditions = false;
+    mutable MemoState _memo;
+    mutable Tracking _tracking;
+    mutable std::unordered_map<std::string, CachedCondition> _conditions;
+    mutable uint64_t _conditions_tick = 0;
+    static inline std::atomic<size_t> _memo_evaluations = 0;
+    static inline std::atomic<size_t> _memo_saved = 0;
+    static inline std::atomic<size_t> _substitutions_resolved = 0;
+    static inline std::atomic<size_t> _substitutions_skipped = 0;
+    static inline std::atomic<size_t> _condition_hits = 0;
+    static inline std::atomic<size_t> _condition_misses = 0;
     static const std::map<std::string, std::string> _default_subsitutes;
     static std::map<std::string, std::string(*)(const std::string&, const std::string&)> _opts;
 
     // methods 
+    Condition EvaluateMemoized(const std::string& input) const;
+    /** Evaluates input collecting the dependencies of the result (also added to those of outer expression). */
+    Condition EvaluateTracked(const std::string& input) const;
+    void Track(const Condition& res) const;  ///< adds dependencies of res to expression currently evaluated
+    static bool Unchanged(const std::vector<Dependency>& dependencies);  ///< none changed since read
+    std::string EvaluateUncached(const std::string& input) const;
+    std::string EvaluateSubstituted(const std::string& replaced) const;
+    std::string Replacement(const std::string& substitute) const;
+
+    /** 
+     * Runs compiled program on a stack of values, resolving substitutes
+     * (replacements) when an operand needs them. Returns nullopt if a
+     * substitute or result of brackets would change the structure of the
+     * expression.
+     */
+    std::optional<Value> Run(const Compiled& compiled, 
+        std::vector<std::optional<std::string>>& replacements) const;
+    static std::shared_ptr<const Compiled> Compile(const std::string& input);
+
+    /** 
+     * Adds code for input to code. Code of brackets is added, where their
+     * result is used first (so operands are evaluated left to right).
+     */
+    static void Emit(const std::string& input, Program& program, std::vector<Instruction>& code);
     std::string evaluate(std::string input) const;
-    std::string StripAndSubstitute(std::string str) const;
+    static std::string StripAndSubstitute(std::string str);
 
     // static methods 
 
@@ -76,6 +250,8 @@ class ExpressionParser{
 
     static std::optional<short> PartOfOpt(int pos, const std::string& inp);
     static std::optional<short> RPartOfOpt(int pos, const std::string& inp);
+
+    static Pool& GetPool();
 };
 
 #endif
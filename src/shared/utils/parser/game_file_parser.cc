@@ -66,12 +66,12 @@ std::map<std::string, builder::FileType> parser::GetPaths(const std::string& gam
 
 parser::ExecListeners parser::LoadGameFiles(const std::string& path, 
     std::map<std::string, std::shared_ptr<Context>>& contexts, 
-    std::map<std::string, std::shared_ptr<Text>>& texts) {
+    std::map<std::string, std::shared_ptr<Text>>& texts, const Listener::Fn& forward_fn) {
   std::map<std::string, nlohmann::json> listeners;
   util::Logger()->debug("Loading game objects: " + path);
   LoadObjects(path, contexts, texts, listeners);
   util::Logger()->debug("Loading game listeners: " + path);
-  return LoadListeners(contexts, std::move(listeners));
+  return LoadListeners(contexts, std::move(listeners), forward_fn);
 }
 
 void parser::LoadObjects(const std::string& path, std::map<std::string, std::shared_ptr<Context>>& contexts, 
@@ -124,13 +124,13 @@ void parser::LoadObjects(const std::string& path, std::map<std::string, std::sha
 }
 
 parser::ExecListeners parser::LoadListeners(std::map<std::string, std::shared_ptr<Context>>& contexts,
-    const std::map<std::string, nlohmann::json>& listeners) {
+    const std::map<std::string, nlohmann::json>& listeners, const Listener::Fn& forward_fn) {
   ExecListeners exec_forwarders;
   for (const auto& [ctx_id, json_listeners] : listeners) {
     try {
       for (const auto& json_listener : json_listeners.get<std::vector<nlohmann::json>>()) {
         try {
-          auto new_listener = CreateListenerFromJson(json_listener, ctx_id, contexts);
+          auto new_listener = CreateListenerFromJson(json_listener, ctx_id, contexts, forward_fn);
           // Add new listener
           if (new_listener) {
             contexts.at(ctx_id)->AddListener(new_listener);
@@ -151,7 +151,8 @@ parser::ExecListeners parser::LoadListeners(std::map<std::string, std::shared_pt
 }
 
 std::shared_ptr<Listener> parser::CreateListenerFromJson(const nlohmann::json& og_json_listener, 
-    const std::string& ctx_id, const std::map<std::string, std::shared_ptr<Context>>& contexts) {
+    const std::string& ctx_id, const std::map<std::string, std::shared_ptr<Context>>& contexts, 
+    const Listener::Fn& forward_fn) {
   nlohmann::json json_listener = og_json_listener;
   util::Logger()->debug("creating listener: {}", json_listener.dump());
 
@@ -162,13 +163,14 @@ std::shared_ptr<Listener> parser::CreateListenerFromJson(const nlohmann::json& o
     }
   }
 
+  std::shared_ptr<Listener> listener;
   // Create context-listener
   if (json_listener.contains("ctx") && !json_listener.at("ctx").get<std::string>().empty()) {
     util::Logger()->debug("CREATING CTX-FORWARDER");
     std::string target_ctx_id = json_listener["ctx"];
     auto it_ctx = contexts.find((target_ctx_id == "<_>") ? ctx_id : target_ctx_id);
     if (it_ctx != contexts.end()) {
-      return std::make_shared<LContextForwarder>(json_listener, it_ctx->second, og_json_listener);
+      listener = std::make_shared<LContextForwarder>(json_listener, it_ctx->second, og_json_listener);
     } else {
       util::Logger()->warn("parser::LoadListeners. For listener \"{}\", context \"{}\" not found.", 
           json_listener["id"].get<std::string>(), ctx_id);
@@ -176,8 +178,13 @@ std::shared_ptr<Listener> parser::CreateListenerFromJson(const nlohmann::json& o
     }
   } 
   // Create "normal" listener
-  util::Logger()->debug("CREATING FORWARDER");
-  return std::make_shared<LForwarder>(json_listener, og_json_listener);
+  else {
+    util::Logger()->debug("CREATING FORWARDER");
+    listener = std::make_shared<LForwarder>(json_listener, og_json_listener);
+  }
+  if (forward_fn)
+    listener->set_fn(forward_fn);
+  return listener;
 }
 
 void parser::LoadMediaFileInformation(const std::string& path, std::set<std::string>& media_files) {
@@ -17,28 +17,36 @@ namespace parser {
   std::map<std::string, builder::FileType> GetPaths(const std::string& game_path);
   std::map<std::string, builder::FileType> GetPaths(const std::string& game_path, const std::string path);
 
-  template <class G>
-  std::map<std::string, std::shared_ptr<G>> InitGames(const std::string& path) {
+  /**
+   * Creates a game for every directory in path. Additional arguments are
+   * passed to the game's constructor.
+   */
+  template <class G, class... Args>
+  std::map<std::string, std::shared_ptr<G>> InitGames(const std::string& path, const Args&... args) {
     std::map<std::string, std::shared_ptr<G>> games;
     for (const auto& dir : std::filesystem::directory_iterator(path)) {
       const std::string filename = dir.path().filename();
       if (filename.front() == '.')
         continue;
-      games[filename] = std::make_shared<G>(dir.path(), filename);
+      games[filename] = std::make_shared<G>(dir.path(), filename, args...);
       util::Logger()->info("MAIN:InitGames: Created game *{}* @{}", filename, dir.path().string());
     }
     return games;
   }
 
+  /**
+   * Loads contexts, texts and listeners of game. Forwarders are created with
+   * given forward-fn (f.e. the game's event-queue handler).
+   */
   ExecListeners LoadGameFiles(const std::string& path, 
       std::map<std::string, std::shared_ptr<Context>>& contexts, 
-      std::map<std::string, std::shared_ptr<Text>>& texts);
+      std::map<std::string, std::shared_ptr<Text>>& texts, const Listener::Fn& forward_fn=nullptr);
   void LoadObjects(const std::string& path, std::map<std::string, std::shared_ptr<Context>>& contexts, 
       std::map<std::string, std::shared_ptr<Text>>& texts, std::map<std::string, nlohmann::json>& listeners);
   ExecListeners LoadListeners(std::map<std::string, std::shared_ptr<Context>>& contexts,
-      const std::map<std::string, nlohmann::json>& listeners);
+      const std::map<std::string, nlohmann::json>& listeners, const Listener::Fn& forward_fn=nullptr);
   std::shared_ptr<Listener> CreateListenerFromJson(const nlohmann::json& j_listener, const std::string& ctx_id,
-      const std::map<std::string, std::shared_ptr<Context>>& contexts);
+      const std::map<std::string, std::shared_ptr<Context>>& contexts, const Listener::Fn& forward_fn=nullptr);
   void LoadMediaFileInformation(const std::string& path, std::set<std::string>& media_files);
 
   std::shared_ptr<Context> CreateContextFromPath(std::filesystem::path path, size_t id_path_offset);
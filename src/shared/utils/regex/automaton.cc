@@ -0,0 +1,746 @@
+#include "shared/utils/regex/automaton.h"
+#include <algorithm>
+#include <map>
+#include <utility>
+
+namespace util {
+
+  namespace {
+    const size_t MAX_PROG_SIZE = 4096;
+    const int MAX_REPEAT = 1000;
+
+    struct Unsupported {};
+
+    struct Node {
+      enum Type { SET, CONCAT, ALT, REPEAT, GROUP, BEGIN, END, LOOK, NOT_LOOK };
+      Type _type;
+      int _set = 0;  ///< SET/LOOK/NOT_LOOK
+      int _group = 0;  ///< GROUP
+      int _min = 0;  ///< REPEAT
+      int _max = -1;  ///< REPEAT (-1: unbounded)
+      bool _greedy = true;  ///< REPEAT
+      bool _has_group = false;  ///< contains a capture group
+      std::vector<std::unique_ptr<Node>> _children;
+
+      Node(Type type) : _type(type) {}
+    };
+
+    std::bitset<256> CharRange(int from, int to) {
+      std::bitset<256> set;
+      for (int c = from; c <= to; c++)
+        set.set(c);
+      return set;
+    }
+
+    /** Sets as matched by std::regex in the "C" locale. */
+    std::bitset<256> ClassSet(char c) {
+      std::bitset<256> set;
+      switch (c) {
+        case 'd': case 'D':
+          set = CharRange('0', '9');
+          break;
+        case 'w': case 'W':
+          set = CharRange('0', '9') | CharRange('a', 'z') | CharRange('A', 'Z');
+          set.set('_');
+          break;
+        case 's': case 'S':
+          for (char space : {' ', '\t', '\n', '\v', '\f', '\r'})
+            set.set(static_cast<unsigned char>(space));
+          break;
+      }
+      return (c >= 'A' && c <= 'Z') ? ~set : set;
+    }
+
+    bool IsClassEscape(char c) {
+      return c == 'd' || c == 'D' || c == 'w' || c == 'W' || c == 's' || c == 'S';
+    }
+
+    int ControlEscape(char c) {
+      switch (c) {
+        case 'n': return '\n';
+        case 'r': return '\r';
+        case 't': return '\t';
+        case 'f': return '\f';
+        case 'v': return '\v';
+      }
+      return -1;
+    }
+
+    bool IsAlnum(char c) {
+      return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+    }
+  }
+
+  /**
+   * Parses a pattern (recursive descent) and emits the NFA program. Throws
+   * `Unsupported` for any syntax not handled.
+   */
+  class RegexCompiler {
+    public:
+      RegexCompiler(const std::string& pattern, RegexAutomaton& automaton) : _pattern(pattern), _pos(0),
+          _automaton(automaton) {}
+
+      void Compile() {
+        auto root = Alternation();
+        if (_pos != _pattern.length())
+          throw Unsupported();  // unbalanced ')'
+        Emit(*root);
+        Add(RegexAutomaton::MATCH);
+      }
+
+    private:
+      const std::string& _pattern;
+      size_t _pos;
+      RegexAutomaton& _automaton;
+
+      bool AtEnd() const { return _pos >= _pattern.length(); }
+      char Peek(size_t offset=0) const {
+        return (_pos + offset < _pattern.length()) ? _pattern[_pos + offset] : '\0';
+      }
+
+      int AddSet(const std::bitset<256>& set) {
+        auto& sets = _automaton._sets;
+        auto it = std::find(sets.begin(), sets.end(), set);
+        if (it != sets.end())
+          return it - sets.begin();
+        sets.push_back(set);
+        return sets.size() - 1;
+      }
+
+      std::unique_ptr<Node> SetNode(const std::bitset<256>& set, Node::Type type=Node::SET) {
+        auto node = std::make_unique<Node>(type);
+        node->_set = AddSet(set);
+        return node;
+      }
+
+      // parsing
+
+      std::unique_ptr<Node> Alternation() {
+        auto first = Concat();
+        if (Peek() != '|' || AtEnd())
+          return first;
+        auto alt = std::make_unique<Node>(Node::ALT);
+        alt->_has_group = first->_has_group;
+        alt->_children.push_back(std::move(first));
+        while (!AtEnd() && Peek() == '|') {
+          _pos++;
+          alt->_children.push_back(Concat());
+          alt->_has_group |= alt->_children.back()->_has_group;
+        }
+        return alt;
+      }
+
+      std::unique_ptr<Node> Concat() {
+        auto concat = std::make_unique<Node>(Node::CONCAT);
+        while (!AtEnd() && Peek() != '|' && Peek() != ')') {
+          concat->_children.push_back(Term());
+          concat->_has_group |= concat->_children.back()->_has_group;
+        }
+        return concat;
+      }
+
+      std::unique_ptr<Node> Term() {
+        char c = Peek();
+        if (c == '^' || c == '$') {
+          _pos++;
+          return Assertion(std::make_unique<Node>((c == '^') ? Node::BEGIN : Node::END));
+        }
+        if (c == '(' && Peek(1) == '?') {
+          if (Peek(2) == '=' || Peek(2) == '!') {
+            // Look-ahead of a single character (f.e. "(?!#)")
+            Node::Type type = (Peek(2) == '=') ? Node::LOOK : Node::NOT_LOOK;
+            _pos += 3;
+            auto set = SingleCharSet();
+            if (Peek() != ')' || AtEnd())
+              throw Unsupported();
+            _pos++;
+            return Assertion(SetNode(set, type));
+          }
+          if (Peek(2) != ':')
+            throw Unsupported();
+          _pos += 3;
+          return Quantified(Group(-1));
+        }
+        if (c == '(') {
+          _pos++;
+          return Quantified(Group(++_automaton._groups));
+        }
+        return Quantified(SetNode(SingleCharSet()));
+      }
+
+      std::unique_ptr<Node> Group(int group) {
+        auto inner = Alternation();
+        if (Peek() != ')' || AtEnd())
+          throw Unsupported();
+        _pos++;
+        if (group < 0)
+          return inner;
+        auto node = std::make_unique<Node>(Node::GROUP);
+        node->_group = group;
+        node->_has_group = true;
+        node->_children.push_back(std::move(inner));
+        return node;
+      }
+
+      std::unique_ptr<Node> Assertion(std::unique_ptr<Node> node) {
+        if (IsQuantifier())
+          throw Unsupported();
+        return node;
+      }
+
+      bool IsQuantifier() const {
+        return !AtEnd() && (Peek() == '*' || Peek() == '+' || Peek() == '?' || Peek() == '{');
+      }
+
+      /** Atom matching one character: '.', class, escape or literal. */
+      std::bitset<256> SingleCharSet() {
+        if (AtEnd())
+          throw Unsupported();
+        char c = _pattern[_pos++];
+        switch (c) {
+          case '.':
+            return ~(CharRange('\n', '\n') | CharRange('\r', '\r'));
+          case '[':
+            return CharClass();
+          case '\\': {
+            if (AtEnd())
+              throw Unsupported();
+            char escaped = _pattern[_pos++];
+            if (IsClassEscape(escaped))
+              return ClassSet(escaped);
+            return CharRange(EscapedChar(escaped), EscapedChar(escaped));
+          }
+          case '*': case '+': case '?': case '{': case '}': case ']': case '(': case ')': case '|':
+            throw Unsupported();
+        }
+        unsigned char uc = static_cast<unsigned char>(c);
+        return CharRange(uc, uc);
+      }
+
+      /** Character of a (non-class) escape. Throws for back-references, '\b', '\x', ... */
+      int EscapedChar(char c) {
+        int control = ControlEscape(c);
+        if (control != -1)
+          return control;
+        if (IsAlnum(c) || c == '_')
+          throw Unsupported();
+        return static_cast<unsigned char>(c);
+      }
+
+      std::bitset<256> CharClass() {
+        std::bitset<256> set;
+        bool negate = (Peek() == '^' && !AtEnd());
+        if (negate)
+          _pos++;
+        if (Peek() == ']')
+          throw Unsupported();  // empty class
+        while (true) {
+          if (AtEnd())
+            throw Unsupported();
+          if (Peek() == ']') {
+            _pos++;
+            break;
+          }
+          std::bitset<256> atom_set;
+          int from = ClassAtom(atom_set);
+          if (Peek() == '-' && Peek(1) != ']' && _pos + 1 < _pattern.length()) {
+            _pos++;
+            std::bitset<256> to_set;
+            int to = ClassAtom(to_set);
+            if (from < 0 || to < 0 || from > to)
+              throw Unsupported();
+            set |= CharRange(from, to);
+          } else if (from < 0) {
+            set |= atom_set;
+          } else {
+            set.set(from);
+          }
+        }
+        return negate ? ~set : set;
+      }
+
+      /** Returns character of class atom, or -1 if atom is a set (written to set). */
+      int ClassAtom(std::bitset<256>& set) {
+        if (AtEnd())
+          throw Unsupported();
+        char c = _pattern[_pos++];
+        if (c == '[' && (Peek() == ':' || Peek() == '.' || Peek() == '='))
+          throw Unsupported();  // posix classes
+        if (c != '\\')
+          return static_cast<unsigned char>(c);
+        if (AtEnd())
+          throw Unsupported();
+        char escaped = _pattern[_pos++];
+        if (IsClassEscape(escaped)) {
+          set = ClassSet(escaped);
+          return -1;
+        }
+        return EscapedChar(escaped);
+      }
+
+      std::unique_ptr<Node> Quantified(std::unique_ptr<Node> atom) {
+        if (!IsQuantifier())
+          return atom;
+        int min = 0, max = -1;
+        char c = _pattern[_pos++];
+        if (c == '+') {
+          min = 1;
+        } else if (c == '?') {
+          max = 1;
+        } else if (c == '{') {
+          min = Number();
+          max = min;
+          if (Peek() == ',') {
+            _pos++;
+            max = (Peek() == '}') ? -1 : Number();
+          }
+          if (Peek() != '}' || AtEnd() || (max != -1 && max < min))
+            throw Unsupported();
+          _pos++;
+        }
+        auto repeat = std::make_unique<Node>(Node::REPEAT);
+        repeat->_min = min;
+        repeat->_max = max;
+        if (!AtEnd() && Peek() == '?') {
+          repeat->_greedy = false;
+          _pos++;
+        }
+        // Captures inside repetitions are reset per iteration and empty iterations fail in
+        // ECMAScript (not simulated), only a single optional iteration is equivalent.
+        if (atom->_has_group && (max != 1 || Nullable(*atom)))
+          throw Unsupported();
+        repeat->_children.push_back(std::move(atom));
+        return repeat;
+      }
+
+      /** Whether node can match the empty string. */
+      static bool Nullable(const Node& node) {
+        switch (node._type) {
+          case Node::SET:
+            return false;
+          case Node::CONCAT:
+            return std::all_of(node._children.begin(), node._children.end(), 
+                [](const auto& child) { return Nullable(*child); });
+          case Node::ALT:
+            return std::any_of(node._children.begin(), node._children.end(), 
+                [](const auto& child) { return Nullable(*child); });
+          case Node::REPEAT:
+            return node._min == 0 || Nullable(*node._children.front());
+          case Node::GROUP:
+            return Nullable(*node._children.front());
+          default:
+            return true;  // assertions
+        }
+      }
+
+      int Number() {
+        size_t start = _pos;
+        int num = 0;
+        while (!AtEnd() && Peek() >= '0' && Peek() <= '9' && num <= MAX_REPEAT)
+          num = num * 10 + (_pattern[_pos++] - '0');
+        if (_pos == start || num > MAX_REPEAT)
+          throw Unsupported();
+        return num;
+      }
+
+      // emitting
+
+      size_t Add(RegexAutomaton::Op op, int x=0, int y=0) {
+        if (_automaton._prog.size() >= MAX_PROG_SIZE)
+          throw Unsupported();
+        _automaton._prog.push_back({op, x, y});
+        return _automaton._prog.size() - 1;
+      }
+
+      int Next() const { return _automaton._prog.size(); }
+
+      void Emit(const Node& node) {
+        auto& prog = _automaton._prog;
+        switch (node._type) {
+          case Node::SET:
+            Add(RegexAutomaton::CHAR, node._set);
+            break;
+          case Node::LOOK:
+            Add(RegexAutomaton::LOOK, node._set);
+            break;
+          case Node::NOT_LOOK:
+            Add(RegexAutomaton::NOT_LOOK, node._set);
+            break;
+          case Node::BEGIN:
+            Add(RegexAutomaton::BEGIN);
+            break;
+          case Node::END:
+            Add(RegexAutomaton::END);
+            break;
+          case Node::CONCAT:
+            for (const auto& child : node._children)
+              Emit(*child);
+            break;
+          case Node::GROUP:
+            Add(RegexAutomaton::SAVE, 2 * node._group);
+            Emit(*node._children.front());
+            Add(RegexAutomaton::SAVE, 2 * node._group + 1);
+            break;
+          case Node::ALT: {
+            std::vector<size_t> jumps;
+            for (size_t i = 0; i < node._children.size(); i++) {
+              if (i + 1 == node._children.size()) {
+                Emit(*node._children[i]);
+                break;
+              }
+              size_t split = Add(RegexAutomaton::SPLIT, Next() + 1);
+              Emit(*node._children[i]);
+              jumps.push_back(Add(RegexAutomaton::JMP));
+              prog[split]._y = Next();
+            }
+            for (size_t jump : jumps)
+              prog[jump]._x = Next();
+            break;
+          }
+          case Node::REPEAT: {
+            const Node& child = *node._children.front();
+            for (int i = 0; i < node._min; i++)
+              Emit(child);
+            if (node._max == -1) {
+              size_t split = Add(RegexAutomaton::SPLIT);
+              Emit(child);
+              Add(RegexAutomaton::JMP, split);
+              SetSplit(split, split + 1, Next(), node._greedy);
+            } else {
+              // Nested optionals: x(x(x)?)?, all exits jump to the end
+              std::vector<size_t> splits;
+              for (int i = node._min; i < node._max; i++) {
+                splits.push_back(Add(RegexAutomaton::SPLIT));
+                Emit(child);
+              }
+              for (size_t split : splits)
+                SetSplit(split, split + 1, Next(), node._greedy);
+            }
+            break;
+          }
+        }
+      }
+
+      void SetSplit(size_t split, int body, int exit, bool greedy) {
+        auto& inst = _automaton._prog[split];
+        inst._x = greedy ? body : exit;
+        inst._y = greedy ? exit : body;
+      }
+  };
+
+  std::shared_ptr<const RegexAutomaton> RegexAutomaton::Compile(const std::string& pattern) {
+    std::shared_ptr<RegexAutomaton> automaton(new RegexAutomaton());
+    try {
+      RegexCompiler(pattern, *automaton).Compile();
+    } catch (Unsupported&) {
+      return nullptr;
+    }
+    automaton->BuildPrefix();
+    automaton->BuildDfa();
+    return automaton;
+  }
+
+  void RegexAutomaton::BuildPrefix() {
+    // Follow the program from the start as long as there is only one path matching one character
+    for (size_t pc = 0; pc < _prog.size(); ) {
+      const Inst& inst = _prog[pc];
+      if (inst._op == JMP) {
+        pc = inst._x;
+      } else if (inst._op == SAVE || inst._op == BEGIN) {
+        pc++;
+      } else if (inst._op == CHAR && _sets[inst._x].count() == 1) {
+        for (int c = 0; c < 256; c++) {
+          if (_sets[inst._x][c])
+            _prefix += static_cast<char>(c);
+        }
+        pc++;
+      } else {
+        break;
+      }
+    }
+  }
+
+  void RegexAutomaton::BuildDfa() {
+    // Bytes not distinguished by any set share one class (column of the table)
+    std::map<std::vector<bool>, uint8_t> signatures;
+    std::vector<unsigned char> representative;
+    for (int c = 0; c < 256; c++) {
+      std::vector<bool> signature(_sets.size());
+      for (size_t i = 0; i < _sets.size(); i++)
+        signature[i] = _sets[i][c];
+      auto it = signatures.find(signature);
+      if (it == signatures.end()) {
+        it = signatures.emplace(signature, representative.size()).first;
+        representative.push_back(c);
+      }
+      _byte_class[c] = it->second;
+    }
+    _num_classes = representative.size();
+
+    // Follows epsilon transitions (given the next byte-class or -1 at the end). Returns reached
+    // CHAR instructions and whether MATCH was reached.
+    std::vector<int> visited(_prog.size(), -1);
+    int generation = 0;
+    auto closure = [&](const std::vector<int>& pcs, bool at_start, int next, std::vector<int>& chars) {
+      generation++;
+      bool match = false;
+      std::vector<int> stack(pcs.rbegin(), pcs.rend());
+      while (!stack.empty()) {
+        int pc = stack.back();
+        stack.pop_back();
+        if (visited[pc] == generation)
+          continue;
+        visited[pc] = generation;
+        const Inst& inst = _prog[pc];
+        switch (inst._op) {
+          case CHAR: chars.push_back(pc); break;
+          case MATCH: match = true; break;
+          case JMP: stack.push_back(inst._x); break;
+          case SPLIT: stack.push_back(inst._y); stack.push_back(inst._x); break;
+          case SAVE: stack.push_back(pc + 1); break;
+          case BEGIN: if (at_start) stack.push_back(pc + 1); break;
+          case END: if (next == -1) stack.push_back(pc + 1); break;
+          case LOOK:
+            if (next != -1 && _sets[inst._x][representative[next]])
+              stack.push_back(pc + 1);
+            break;
+          case NOT_LOOK:
+            if (next == -1 || !_sets[inst._x][representative[next]])
+              stack.push_back(pc + 1);
+            break;
+        }
+      }
+      return match;
+    };
+
+    // States: NFA instructions to continue at (sorted), prefixed by -1 for the start state.
+    std::map<std::vector<int>, int> ids;
+    std::vector<std::vector<int>> states;
+    auto state_id = [&](std::vector<int> pcs) {
+      auto it = ids.find(pcs);
+      if (it != ids.end())
+        return it->second;
+      ids.emplace(pcs, states.size());
+      states.push_back(std::move(pcs));
+      return static_cast<int>(states.size() - 1);
+    };
+    state_id({});  // DEAD
+    _start = state_id({-1, 0});
+
+    std::vector<int> table;
+    std::vector<bool> accepting;
+    for (size_t s = 0; s < states.size(); s++) {
+      if (states.size() > MAX_DFA_STATES)
+        return;  // too large: simulate NFA instead
+      bool at_start = !states[s].empty() && states[s].front() == -1;
+      std::vector<int> pcs(states[s].begin() + (at_start ? 1 : 0), states[s].end());
+      std::vector<int> chars;
+      accepting.push_back(closure(pcs, at_start, -1, chars));
+      for (size_t cls = 0; cls < _num_classes; cls++) {
+        chars.clear();
+        closure(pcs, at_start, cls, chars);
+        std::vector<int> next;
+        for (int pc : chars) {
+          if (_sets[_prog[pc]._x][representative[cls]])
+            next.push_back(pc + 1);
+        }
+        std::sort(next.begin(), next.end());
+        next.erase(std::unique(next.begin(), next.end()), next.end());
+        table.push_back(state_id(std::move(next)));
+      }
+    }
+    _table = std::move(table);
+    _accepting = std::move(accepting);
+  }
+
+  std::bitset<256> RegexAutomaton::FirstBytes() const {
+    std::bitset<256> first;
+    if (!dfa())
+      return first.set();
+    for (int c = 0; c < 256; c++)
+      first[c] = _table[_start * _num_classes + _byte_class[c]] != DEAD;
+    return first;
+  }
+
+  bool RegexAutomaton::Match(const std::string& str, std::vector<std::string>* captures) const {
+    if (dfa()) {
+      int state = _start;
+      for (unsigned char c : str) {
+        state = _table[state * _num_classes + _byte_class[c]];
+        if (state == DEAD)
+          return false;
+      }
+      if (!_accepting[state])
+        return false;
+      if (!captures)
+        return true;
+      if (_groups == 0) {
+        *captures = {str};
+        return true;
+      }
+    }
+    std::vector<int> slots(2 * (_groups + 1), -1);
+    bool match = (_prog.size() * (str.length() + 1) <= MAX_BACKTRACK_STATES) ? Backtrack(str, slots) 
+      : Simulate(str, slots);
+    if (match && captures)
+      SetCaptures(str, slots, *captures);
+    return match;
+  }
+
+  bool RegexAutomaton::Backtrack(const std::string& str, std::vector<int>& slots) const {
+    struct Job {
+      int _pc;
+      size_t _pos;
+      int _slot = -1;  ///< restores slot (to _pc) instead of continuing
+    };
+    const size_t n = str.length();
+    std::vector<bool> visited(_prog.size() * (n + 1));
+    std::vector<Job> stack = {{0, 0}};
+    while (!stack.empty()) {
+      Job job = stack.back();
+      stack.pop_back();
+      if (job._slot != -1) {
+        slots[job._slot] = job._pc;
+        continue;
+      }
+      int pc = job._pc;
+      size_t pos = job._pos;
+      // Follow thread until it fails (states visited before failed already)
+      for (bool alive = true; alive; ) {
+        size_t state = pc * (n + 1) + pos;
+        if (visited[state])
+          break;
+        visited[state] = true;
+        const Inst& inst = _prog[pc];
+        switch (inst._op) {
+          case CHAR:
+            alive = pos < n && _sets[inst._x][static_cast<unsigned char>(str[pos])];
+            pc++;
+            pos++;
+            break;
+          case MATCH:
+            if (pos == n)
+              return true;
+            alive = false;
+            break;
+          case JMP:
+            pc = inst._x;
+            break;
+          case SPLIT:
+            stack.push_back({inst._y, pos});
+            pc = inst._x;
+            break;
+          case SAVE:
+            stack.push_back({slots[inst._x], 0, inst._x});
+            slots[inst._x] = pos;
+            pc++;
+            break;
+          case BEGIN:
+            alive = pos == 0;
+            pc++;
+            break;
+          case END:
+            alive = pos == n;
+            pc++;
+            break;
+          case LOOK:
+            alive = pos < n && _sets[inst._x][static_cast<unsigned char>(str[pos])];
+            pc++;
+            break;
+          case NOT_LOOK:
+            alive = pos == n || !_sets[inst._x][static_cast<unsigned char>(str[pos])];
+            pc++;
+            break;
+        }
+      }
+    }
+    return false;
+  }
+
+  bool RegexAutomaton::Simulate(const std::string& str, std::vector<int>& slots) const {
+    struct Thread {
+      int _pc;
+      std::vector<int> _slots;
+    };
+    const size_t n = str.length();
+    std::vector<Thread> current, next;
+    std::vector<size_t> visited(_prog.size(), 0);
+    size_t generation = 0;
+
+    // Adds thread (following epsilon transitions) in priority order, like backtracking would try.
+    auto add = [&](auto& self, std::vector<Thread>& list, int pc, std::vector<int>& slots, size_t pos) -> void {
+      if (visited[pc] == generation)
+        return;
+      visited[pc] = generation;
+      const Inst& inst = _prog[pc];
+      switch (inst._op) {
+        case JMP:
+          self(self, list, inst._x, slots, pos);
+          break;
+        case SPLIT:
+          self(self, list, inst._x, slots, pos);
+          self(self, list, inst._y, slots, pos);
+          break;
+        case SAVE: {
+          int prev = slots[inst._x];
+          slots[inst._x] = pos;
+          self(self, list, pc + 1, slots, pos);
+          slots[inst._x] = prev;
+          break;
+        }
+        case BEGIN:
+          if (pos == 0)
+            self(self, list, pc + 1, slots, pos);
+          break;
+        case END:
+          if (pos == n)
+            self(self, list, pc + 1, slots, pos);
+          break;
+        case LOOK:
+          if (pos < n && _sets[inst._x][static_cast<unsigned char>(str[pos])])
+            self(self, list, pc + 1, slots, pos);
+          break;
+        case NOT_LOOK:
+          if (pos == n || !_sets[inst._x][static_cast<unsigned char>(str[pos])])
+            self(self, list, pc + 1, slots, pos);
+          break;
+        case CHAR: case MATCH:
+          list.push_back({pc, slots});
+          break;
+      }
+    };
+
+    generation++;
+    add(add, current, 0, slots, 0);
+    for (size_t pos = 0; pos < n && !current.empty(); pos++) {
+      generation++;
+      unsigned char c = str[pos];
+      for (auto& thread : current) {
+        const Inst& inst = _prog[thread._pc];
+        if (inst._op == CHAR && _sets[inst._x][c])
+          add(add, next, thread._pc + 1, thread._slots, pos + 1);
+      }
+      current.swap(next);
+      next.clear();
+    }
+    // Full match: highest priority thread at the end of input
+    for (const auto& thread : current) {
+      if (_prog[thread._pc]._op == MATCH) {
+        slots = thread._slots;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void RegexAutomaton::SetCaptures(const std::string& str, const std::vector<int>& slots, 
+      std::vector<std::string>& captures) const {
+    captures.assign(_groups + 1, "");
+    captures[0] = str;
+    for (size_t group = 1; group <= _groups; group++) {
+      int start = slots[2 * group], end = slots[2 * group + 1];
+      if (start >= 0 && end >= start)
+        captures[group] = str.substr(start, end - start);
+    }
+  }
+}
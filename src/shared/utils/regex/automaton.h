@@ -0,0 +1,93 @@
+#ifndef SRC_SHARED_UTILS_REGEX_AUTOMATON_H
+#define SRC_SHARED_UTILS_REGEX_AUTOMATON_H
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace util {
+
+  /**
+   * Regex compiled to a linear-time automaton: a Thompson NFA, turned into a
+   * DFA when compiled. Supports the (ECMAScript) subset used in game files:
+   * literals, escapes, '.', classes, groups, alternation, quantifiers, '^',
+   * '$' and look-aheads of a single character (f.e. "(?!#)" of <user-inp>).
+   * Matching is always a full match (like std::regex_match). Captures are
+   * extracted by a memoized backtracker (simulating the NFA for long inputs),
+   * both following the priorities of ECMAScript, so results equal std::regex's.
+   */
+  class RegexAutomaton {
+    public:
+      /**
+       * Compiles pattern. Returns nullptr for syntax, which is not supported
+       * (f.e. back-references, word-boundaries, captures inside quantified
+       * groups) or invalid.
+       */
+      static std::shared_ptr<const RegexAutomaton> Compile(const std::string& pattern);
+
+      // getter
+      size_t groups() const { return _groups; }  ///< number of capture groups
+      bool dfa() const { return !_table.empty(); }  ///< false if DFA got too large (NFA is simulated)
+      const std::string& prefix() const { return _prefix; }  ///< literal every match starts with
+
+      // methods
+
+      /**
+       * Full match of str. If captures are given, they are set to the whole
+       * match ([0]) and all groups ([1..n], "" if not participating).
+       */
+      bool Match(const std::string& str, std::vector<std::string>* captures=nullptr) const;
+
+      /** Bytes a non-empty match may start with (all, if DFA got too large). */
+      std::bitset<256> FirstBytes() const;
+
+    private:
+      enum Op : uint8_t { CHAR, SPLIT, JMP, SAVE, BEGIN, END, LOOK, NOT_LOOK, MATCH };
+
+      struct Inst {
+        Op _op;
+        int _x = 0;  ///< CHAR/LOOK: set, SPLIT/JMP: (preferred) target, SAVE: slot
+        int _y = 0;  ///< SPLIT: alternative target
+      };
+
+      static constexpr size_t MAX_DFA_STATES = 1024;
+      static constexpr size_t MAX_BACKTRACK_STATES = 256 * 1024;
+      static constexpr int DEAD = 0;
+
+      std::vector<Inst> _prog;
+      std::vector<std::bitset<256>> _sets;
+      size_t _groups = 0;
+      std::string _prefix;
+
+      // dfa
+      std::array<uint8_t, 256> _byte_class = {};
+      size_t _num_classes = 0;
+      int _start = 0;
+      std::vector<int> _table;  ///< next state: [state * _num_classes + byte-class]
+      std::vector<bool> _accepting;
+
+      RegexAutomaton() = default;
+
+      void BuildDfa();
+      void BuildPrefix();
+
+      /**
+       * Backtracks like std::regex, but never visits an instruction at the same
+       * position twice (linear time, memory: program size x input length).
+       */
+      bool Backtrack(const std::string& str, std::vector<int>& slots) const;
+
+      /** Simulates the NFA (linear time, for long inputs). */
+      bool Simulate(const std::string& str, std::vector<int>& slots) const;
+
+      void SetCaptures(const std::string& str, const std::vector<int>& slots, 
+          std::vector<std::string>& captures) const;
+
+      friend class RegexCompiler;
+  };
+}
+
+#endif
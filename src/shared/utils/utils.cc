@@ -8,6 +8,7 @@
 #include <fstream>
 #include <iomanip>
 #include <ios>
+#include <mutex>
 #include <nlohmann/json.hpp>
 #include <optional>
 #include <random>
@@ -22,24 +23,34 @@
 #include <stdexcept>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unordered_map>
 
 
-std::string util::LOGGER = "---";
+thread_local std::string util::LOGGER = "---";
 
-void util::SetUpLogger(const std::string& main_path, const std::string& name, spdlog::level::level_enum log_level) {
+std::shared_ptr<spdlog::logger> util::SetUpLogger(const std::string& main_path, const std::string& name, 
+    spdlog::level::level_enum log_level) {
   std::vector<spdlog::sink_ptr> sinks;
-  sinks.push_back(std::make_shared<spdlog::sinks::stderr_color_sink_st>());
+  sinks.push_back(std::make_shared<spdlog::sinks::stderr_color_sink_mt>());
   sinks.push_back(std::make_shared<spdlog::sinks::daily_file_sink_mt>(main_path + name + "_logfile.txt", 21, 15));
   auto logger = std::make_shared<spdlog::logger>(name, begin(sinks), end(sinks));
-  spdlog::register_logger(logger);
+  {
+    static std::mutex register_mutex;
+    std::lock_guard lock(register_mutex);
+    spdlog::drop(name);
+    spdlog::register_logger(logger);
+  }
   spdlog::flush_every(std::chrono::seconds(5));
   spdlog::flush_on(spdlog::level::err);
   // set log-level
   logger->set_level(log_level);
+  return logger;
 }
 
 std::shared_ptr<spdlog::logger> util::Logger() {
-  return spdlog::get(LOGGER);
+  if (auto logger = spdlog::get(LOGGER))
+    return logger;
+  return spdlog::default_logger();
 }
 
 std::map<std::string, std::vector<std::string>> util::LoadLatestGameLogs(const std::string& game_name) {
@@ -222,6 +233,85 @@ std::string util::ReplaceAll(std::string str, const std::string& from, const std
   return str;
 }
 
+struct util::Regex::Pool {
+  std::mutex _mutex;
+  std::unordered_map<std::string, std::weak_ptr<const Compiled>> _compiled;
+  size_t _prune_at = 64;
+};
+
+util::Regex::Pool& util::Regex::GetPool() {
+  static Pool pool;
+  return pool;
+}
+
+util::Regex::Regex(const std::string& pattern) : _pattern(pattern) {
+  static const std::string IS_USER_INP = "^(?!#)(.*)";
+  std::string new_pattern = "";
+  for (int i=0; i<pattern.length(); i++) {
+    if (pattern[i] == '*' && (i == 0 || (pattern[i-1] != '.' && pattern[i-1] != '\\')))
+      new_pattern += "\\*";
+    else
+      new_pattern += pattern[i];
+  }
+  new_pattern = ReplaceAll(new_pattern, txtad::IS_USER_REPLACEMENT, IS_USER_INP);
+  _compiled = Intern(new_pattern);
+}
+
+size_t util::Regex::interned() {
+  auto& pool = GetPool();
+  std::lock_guard lock(pool._mutex);
+  return std::count_if(pool._compiled.begin(), pool._compiled.end(), [](const auto& it) { 
+      return !it.second.expired(); });
+}
+
+std::shared_ptr<const util::Regex::Compiled> util::Regex::Intern(const std::string& pattern) {
+  auto& pool = GetPool();
+  {
+    std::lock_guard lock(pool._mutex);
+    auto it = pool._compiled.find(pattern);
+    if (it != pool._compiled.end()) {
+      if (auto compiled = it->second.lock())
+        return compiled;
+    }
+  }
+  // Compile without holding the lock (games are loaded in parallel)
+  auto compiled = std::make_shared<Compiled>();
+  compiled->_automaton = RegexAutomaton::Compile(pattern);
+  if (compiled->_automaton) {
+    compiled->_prefix = compiled->_automaton->prefix();
+    compiled->_first_bytes = compiled->_automaton->FirstBytes();
+  } else {
+    compiled->_first_bytes.set();
+    Logger()->debug("Regex::Regex: \"{}\" not supported by automaton, using std::regex", pattern);
+    compiled->_regex = std::make_unique<const std::regex>(pattern);
+  }
+  std::lock_guard lock(pool._mutex);
+  auto& entry = pool._compiled[pattern];
+  if (auto existing = entry.lock())
+    return existing;
+  entry = compiled;
+  // Remove patterns no longer in use, whenever pool doubled
+  if (pool._compiled.size() >= pool._prune_at) {
+    std::erase_if(pool._compiled, [](const auto& it) { return it.second.expired(); });
+    pool._prune_at = std::max<size_t>(64, 2 * pool._compiled.size());
+  }
+  return compiled;
+}
+
+bool util::Regex::Match(const std::string& str, std::vector<std::string>* captures) const {
+  if (_compiled->_automaton)
+    return _compiled->_automaton->Match(str, captures);
+  std::smatch match;
+  if (!std::regex_match(str, match, *_compiled->_regex))
+    return false;
+  if (captures) {
+    captures->clear();
+    for (const auto& sub_match : match)
+      captures->push_back(sub_match.str());
+  }
+  return true;
+}
+
 std::pair<int, int> util::InBrackets(const std::string& inp, int pos) {
   return {OpeningBracket(inp, pos), ClosingBracket(inp, pos)};
 }
@@ -5,8 +5,11 @@
 #define SHARED_UTILS_UTIL_H
 
 #include "game/utils/defines.h"
+#include "shared/utils/regex/automaton.h"
+#include <bitset>
 #include <exception>
 #include <filesystem>
+#include <memory>
 #include <nlohmann/json_fwd.hpp>
 #include <optional>
 #include <regex>
@@ -31,10 +34,16 @@ namespace util
       }
   };
 
-  void SetUpLogger(const std::string& main_path, const std::string& name, spdlog::level::level_enum log_level);
+  /**
+   * Creates and registers logger. An existing logger with the same name is
+   * replaced (f.e. when a game is reloaded while the old one is still running).
+   */
+  std::shared_ptr<spdlog::logger> SetUpLogger(const std::string& main_path, const std::string& name, 
+      spdlog::level::level_enum log_level);
   std::shared_ptr<spdlog::logger> Logger();
 
-  extern std::string LOGGER;
+  /** Name of the logger used by the current thread (falls back to spdlog's default logger). */
+  extern thread_local std::string LOGGER;
 
   class LoggerContext {
     public: 
@@ -172,31 +181,45 @@ namespace util
 
   /**
    * Custom regex class applying basic escaping and stores string
-   * representation.
+   * representation. Patterns are compiled to a linear-time automaton
+   * (std::regex is only used for syntax the automaton does not support).
+   * Compiled patterns are immutable and interned process-wide: regexes of the
+   * same (escaped) pattern share one compiled pattern.
    * Escaping: 
    * - '*' -> '\*'
+   * - <user-inp> -> '^(?!#)(.*)'
    */
   class Regex {
     public: 
-      Regex(const std::string& pattern) : _pattern(pattern), _regex(std::regex(pattern)) {
-        static const std::string IS_USER_INP = "^(?!#)(.*)";
-        std::string new_pattern = "";
-        for (int i=0; i<pattern.length(); i++) {
-          if (pattern[i] == '*' && (i == 0 || (pattern[i-1] != '.' && pattern[i-1] != '\\')))
-            new_pattern += "\\*";
-          else 
-            new_pattern += pattern[i];
-        }
-        new_pattern = ReplaceAll(new_pattern, txtad::IS_USER_REPLACEMENT, IS_USER_INP);
-        _regex = std::regex(new_pattern);
-        _pattern = pattern;
-      }
+      Regex(const std::string& pattern);
 
       const std::string& str() const { return _pattern; } 
-      operator const std::regex&() const { return _regex; } 
+      const std::string& prefix() const { return _compiled->_prefix; }  ///< literal every match starts with
+      const std::bitset<256>& first_bytes() const { return _compiled->_first_bytes; }  ///< bytes a match may start with
+      static size_t interned();  ///< number of compiled patterns in use
+
+      /**
+       * Full match (like std::regex_match). If captures are given, they are
+       * set to the whole match ([0]) and all groups ([1..n]).
+       */
+      bool Match(const std::string& str, std::vector<std::string>* captures=nullptr) const;
+
     private: 
+      struct Compiled {
+        std::string _prefix;
+        std::bitset<256> _first_bytes;
+        std::shared_ptr<const RegexAutomaton> _automaton;
+        std::unique_ptr<const std::regex> _regex;  ///< fallback if pattern not supported by automaton
+      };
+
+      struct Pool;
+
       std::string _pattern;
-      std::regex _regex;
+      std::shared_ptr<const Compiled> _compiled;
+
+      static Pool& GetPool();
+      /** Returns compiled pattern from pool, compiling it if not in use. */
+      static std::shared_ptr<const Compiled> Intern(const std::string& pattern);
   };
 
   template< typename tPair >